@@ -0,0 +1,59 @@
+#ifndef NTBM_ARRAY_VIEW_HH
+#define NTBM_ARRAY_VIEW_HH
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * Non-owning read-only view of a contiguous range (pointer + length).
+ * Used by NTBMSummary to expose a row of its flat lists without copying.
+ * The view is invalidated by any setter changing the size of the owner.
+ */
+template < typename T >
+class NTBMArrayView {
+
+public :
+
+  typedef const T *const_iterator;
+
+  NTBMArrayView() : data_(nullptr), size_(0) {}
+
+  NTBMArrayView(const T *data, std::size_t size) : data_(data), size_(size) {}
+
+  const T *data() const { return data_; }
+
+  std::size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  const_iterator begin() const { return data_; }
+
+  const_iterator end() const { return data_ + size_; }
+
+  const T &operator[](std::size_t i) const { return data_[i]; }
+
+  const T &at(std::size_t i) const {
+    if ( i >= size_ )
+      throw std::out_of_range("Array view index out of range");
+    return data_[i];
+  }
+
+  const T &front() const { return at(0); }
+
+  const T &back() const { return at(size_ - 1); }
+
+  /**
+   * Copy the viewed range (the only accessor allocating memory)
+   * @return copy of the range
+   */
+  std::vector<T> ToVector() const { return std::vector<T>(begin(), end()); }
+
+private :
+
+  const T *data_;
+  std::size_t size_;
+
+};
+
+#endif
@@ -38,6 +38,8 @@ static const double BM_SECOND_LAYER_POS = -2000. + 183. + 50. + 15.; // mm
 // plane more than 2nd should be much corrected.
 static const double BM_SCI_CORRECTION = -31.5; // mm
 static const double TEMPORAL_ALLOWANCE[2] = {200., 300.}; // mm
+///> Number of bunch differences covered by the NINJA tracker multi hit TDC
+static const int NUMBER_OF_BUNCH_DIFFERENCES = 7;
 
 ///> Photoelectron threshold for the NINJA tracker
 static const double PE_THRESHOLD = 2.5;
@@ -0,0 +1,209 @@
+#ifndef NTBM_FLAT_FILE_HH
+#define NTBM_FLAT_FILE_HH
+
+/*
+ * Memory-mappable flat binary export of the NTBM results (NTBMFlatExport) and its reader.
+ * This header only depends on the C++ standard library and POSIX, so emulsion matching code
+ * can read the NTBM results without ROOT and libNTBM.
+ *
+ * layout : header (80 bytes), spill records, track records, cluster records
+ *          each record array starts at the offset given in the header (8 byte aligned)
+ * spill  : timestamp, BSD spill number, entry in daily file and the range of its tracks/clusters
+ * track  : Baby MIND position/tangent, momentum and track information
+ * cluster: NINJA tracker position/tangent, matched Baby MIND track (index in the track records)
+ *
+ * All values are in the byte order of the writer, the reader rejects the other byte order.
+ * Positions are in mm, floats have the same precision as the NTBM files (Double32_t).
+ */
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "NTBMArrayView.hh"
+
+///> Flat file format version (increased when a record layout changes)
+static const std::uint32_t NTBM_FLAT_FILE_VERSION = 1;
+
+///> Byte order mark written in the header
+static const std::uint32_t NTBM_FLAT_FILE_BYTE_ORDER = 0x01020304;
+
+struct NTBMFlatHeader {
+  char magic[8];                       // "NTBMFLAT"
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint32_t spill_record_size;
+  std::uint32_t track_record_size;
+  std::uint32_t cluster_record_size;
+  std::uint32_t reserved;
+  std::uint64_t number_of_spills;
+  std::uint64_t number_of_tracks;
+  std::uint64_t number_of_clusters;
+  std::uint64_t spill_offset;          // byte offsets from the beginning of the file
+  std::uint64_t track_offset;
+  std::uint64_t cluster_offset;
+};
+
+struct NTBMFlatSpill {
+  double timestamp;
+  std::int32_t bsd_spill_number;
+  std::int32_t entry_in_daily_file;
+  std::uint64_t first_track;           // index of the first track record of the spill
+  std::uint64_t first_cluster;         // index of the first cluster record of the spill
+  std::uint32_t number_of_tracks;
+  std::uint32_t number_of_clusters;
+};
+
+struct NTBMFlatTrack {
+  float baby_mind_position[2];         // sideview (y), topview (x)
+  float baby_mind_tangent[2];
+  float momentum;
+  std::uint32_t spill;                 // index of the spill record
+  std::int8_t ninja_track_type;
+  std::int8_t momentum_type;
+  std::int8_t charge;
+  std::int8_t bunch;
+  std::uint32_t reserved;
+};
+
+///> NTBMFlatCluster flags
+enum NTBMFlatClusterFlag : std::uint8_t {
+  kNTBMFlatPositionFallback = 1,       // bar average position (spill over the reconstruction budget)
+  kNTBMFlatMatched2d = 2               // hits in both views
+};
+
+struct NTBMFlatCluster {
+  float ninja_position[2];             // sideview (y), topview (x)
+  float ninja_tangent[2];
+  std::uint32_t spill;                 // index of the spill record
+  std::int32_t track;                  // index of the matched track record (-1 : not matched)
+  std::uint8_t number_of_hits[2];
+  std::int8_t bunch_difference;
+  std::uint8_t flags;
+  std::uint32_t reserved;
+};
+
+static_assert(sizeof(NTBMFlatHeader) == 80, "NTBMFlatHeader layout changed");
+static_assert(sizeof(NTBMFlatSpill) == 40, "NTBMFlatSpill layout changed");
+static_assert(sizeof(NTBMFlatTrack) == 32, "NTBMFlatTrack layout changed");
+static_assert(sizeof(NTBMFlatCluster) == 32, "NTBMFlatCluster layout changed");
+
+/**
+ * Read-only memory mapped flat NTBM file. Records are accessed in place without copying.
+ */
+class NTBMFlatFile {
+
+public :
+
+  /**
+   * Map the file and check the header
+   * @param path flat file path
+   */
+  explicit NTBMFlatFile(const std::string &path) : data_(nullptr), size_(0), header_(nullptr) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if ( fd < 0 )
+      throw std::runtime_error("Cannot open NTBM flat file : " + path);
+    struct stat status;
+    if ( ::fstat(fd, &status) != 0 || (std::size_t)status.st_size < sizeof(NTBMFlatHeader) ) {
+      ::close(fd);
+      throw std::runtime_error("NTBM flat file too short : " + path);
+    }
+    size_ = status.st_size;
+    void *data = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if ( data == MAP_FAILED )
+      throw std::runtime_error("Cannot map NTBM flat file : " + path);
+    data_ = static_cast<const char*>(data);
+    header_ = reinterpret_cast<const NTBMFlatHeader*>(data_);
+    try {
+      CheckHeader(path);
+    } catch (...) {
+      ::munmap(const_cast<char*>(data_), size_);
+      throw;
+    }
+  }
+
+  ~NTBMFlatFile() {
+    ::munmap(const_cast<char*>(data_), size_);
+  }
+
+  NTBMFlatFile(const NTBMFlatFile&) = delete;
+  NTBMFlatFile &operator=(const NTBMFlatFile&) = delete;
+
+  const NTBMFlatHeader &GetHeader() const { return *header_; }
+
+  NTBMArrayView<NTBMFlatSpill> GetSpills() const {
+    return GetRecords<NTBMFlatSpill>(header_->spill_offset, header_->number_of_spills);
+  }
+
+  NTBMArrayView<NTBMFlatTrack> GetTracks() const {
+    return GetRecords<NTBMFlatTrack>(header_->track_offset, header_->number_of_tracks);
+  }
+
+  NTBMArrayView<NTBMFlatCluster> GetClusters() const {
+    return GetRecords<NTBMFlatCluster>(header_->cluster_offset, header_->number_of_clusters);
+  }
+
+  /**
+   * @param spill spill record
+   * @return track records of the spill
+   */
+  NTBMArrayView<NTBMFlatTrack> GetTracks(const NTBMFlatSpill &spill) const {
+    return NTBMArrayView<NTBMFlatTrack>(GetTracks().data() + spill.first_track, spill.number_of_tracks);
+  }
+
+  /**
+   * @param spill spill record
+   * @return cluster records of the spill
+   */
+  NTBMArrayView<NTBMFlatCluster> GetClusters(const NTBMFlatSpill &spill) const {
+    return NTBMArrayView<NTBMFlatCluster>(GetClusters().data() + spill.first_cluster, spill.number_of_clusters);
+  }
+
+private :
+
+  template < typename Record >
+  NTBMArrayView<Record> GetRecords(std::uint64_t offset, std::uint64_t number_of_records) const {
+    return NTBMArrayView<Record>(reinterpret_cast<const Record*>(data_ + offset), number_of_records);
+  }
+
+  void CheckRange(std::uint64_t offset, std::uint64_t number_of_records, std::size_t record_size,
+		  const std::string &path) const {
+    if ( offset % 8 != 0 || offset > size_ || number_of_records > ( size_ - offset ) / record_size )
+      throw std::runtime_error("NTBM flat file truncated or corrupted : " + path);
+  }
+
+  void CheckHeader(const std::string &path) const {
+    if ( std::memcmp(header_->magic, "NTBMFLAT", sizeof(header_->magic)) != 0 )
+      throw std::runtime_error("Not an NTBM flat file : " + path);
+    if ( header_->byte_order != NTBM_FLAT_FILE_BYTE_ORDER )
+      throw std::runtime_error("NTBM flat file written in the other byte order : " + path);
+    if ( header_->version != NTBM_FLAT_FILE_VERSION ||
+	 header_->spill_record_size != sizeof(NTBMFlatSpill) ||
+	 header_->track_record_size != sizeof(NTBMFlatTrack) ||
+	 header_->cluster_record_size != sizeof(NTBMFlatCluster) )
+      throw std::runtime_error("NTBM flat file version not supported : "
+			       + std::to_string(header_->version) + " : " + path);
+    CheckRange(header_->spill_offset, header_->number_of_spills, sizeof(NTBMFlatSpill), path);
+    CheckRange(header_->track_offset, header_->number_of_tracks, sizeof(NTBMFlatTrack), path);
+    CheckRange(header_->cluster_offset, header_->number_of_clusters, sizeof(NTBMFlatCluster), path);
+    for ( const auto &spill : GetSpills() )
+      if ( spill.first_track + spill.number_of_tracks > header_->number_of_tracks ||
+	   spill.first_cluster + spill.number_of_clusters > header_->number_of_clusters )
+	throw std::runtime_error("NTBM flat file spill record corrupted : " + path);
+  }
+
+  const char *data_;
+  std::size_t size_;
+  const NTBMFlatHeader *header_;
+
+};
+
+#endif
@@ -7,4 +7,62 @@
 
 #pragma link C++ class NTBMSummary+;
 
+// Files before version 13 (original schema) are converted to the compact schema :
+// - no position fallback flag (all positions fully reconstructed) and no shared hits
+#pragma read sourceClass="NTBMSummary" version="[-12]" targetClass="NTBMSummary" \
+  source="int number_of_ninja_clusters_" target="ninja_position_fallback_, hit_source_cluster_" \
+  code="{ ninja_position_fallback_.assign(onfile.number_of_ninja_clusters_, 0); \
+          hit_source_cluster_.assign(NUMBER_OF_VIEWS, std::vector<int>(onfile.number_of_ninja_clusters_, -1)); }"
+
+// - the NINJA tracker hits (cluster -> view -> hit) and the true particles
+//   (cluster -> particle -> view) are nested vectors, flatten them per view
+#pragma read sourceClass="NTBMSummary" version="[-12]" targetClass="NTBMSummary" \
+  source="std::vector<std::vector<std::vector<int>>> plane_; std::vector<std::vector<std::vector<int>>> slot_; std::vector<std::vector<std::vector<double>>> pe_" \
+  target="hit_offset_, hit_plane_, hit_slot_, hit_pe_" \
+  code="{ NTBMSummary::FlattenHitList(onfile.plane_, hit_offset_, hit_plane_); \
+          NTBMSummary::FlattenHitList(onfile.slot_, hit_offset_, hit_slot_); \
+          NTBMSummary::FlattenHitList(onfile.pe_, hit_offset_, hit_pe_); }"
+
+#pragma read sourceClass="NTBMSummary" version="[-12]" targetClass="NTBMSummary" \
+  source="std::vector<std::vector<std::vector<double>>> true_position_; std::vector<std::vector<std::vector<double>>> true_tangent_" \
+  target="true_particle_offset_, true_particle_position_, true_particle_tangent_" \
+  code="{ NTBMSummary::FlattenTrueParticleList(onfile.true_position_, true_particle_offset_, true_particle_position_); \
+          NTBMSummary::FlattenTrueParticleList(onfile.true_tangent_, true_particle_offset_, true_particle_tangent_); }"
+
+// - the small integers are int and the kinematics are double, convert them to the
+//   compact storage types (8 bit integers, Double32_t)
+#pragma read sourceClass="NTBMSummary" version="[-12]" targetClass="NTBMSummary" \
+  source="std::vector<int> ninja_track_type_; std::vector<int> momentum_type_; std::vector<int> baby_mind_maximum_plane_; std::vector<int> charge_; std::vector<int> direction_; std::vector<int> bunch_; std::vector<int> bunch_difference_" \
+  target="ninja_track_type_, momentum_type_, baby_mind_maximum_plane_, charge_, direction_, bunch_, bunch_difference_" \
+  code="{ NTBMSummary::ConvertList(onfile.ninja_track_type_, ninja_track_type_); \
+          NTBMSummary::ConvertList(onfile.momentum_type_, momentum_type_); \
+          NTBMSummary::ConvertList(onfile.baby_mind_maximum_plane_, baby_mind_maximum_plane_); \
+          NTBMSummary::ConvertList(onfile.charge_, charge_); \
+          NTBMSummary::ConvertList(onfile.direction_, direction_); \
+          NTBMSummary::ConvertList(onfile.bunch_, bunch_); \
+          NTBMSummary::ConvertList(onfile.bunch_difference_, bunch_difference_); }"
+
+#pragma read sourceClass="NTBMSummary" version="[-12]" targetClass="NTBMSummary" \
+  source="std::vector<double> momentum_; std::vector<double> momentum_error_; std::vector<double> track_length_total_" \
+  target="momentum_, momentum_error_, track_length_total_" \
+  code="{ NTBMSummary::ConvertList(onfile.momentum_, momentum_); \
+          NTBMSummary::ConvertList(onfile.momentum_error_, momentum_error_); \
+          NTBMSummary::ConvertList(onfile.track_length_total_, track_length_total_); }"
+
+#pragma read sourceClass="NTBMSummary" version="[-12]" targetClass="NTBMSummary" \
+  source="std::vector<std::vector<double>> baby_mind_position_; std::vector<std::vector<double>> baby_mind_position_error_; std::vector<std::vector<double>> baby_mind_tangent_; std::vector<std::vector<double>> baby_mind_tangent_error_" \
+  target="baby_mind_position_, baby_mind_position_error_, baby_mind_tangent_, baby_mind_tangent_error_" \
+  code="{ NTBMSummary::ConvertList(onfile.baby_mind_position_, baby_mind_position_); \
+          NTBMSummary::ConvertList(onfile.baby_mind_position_error_, baby_mind_position_error_); \
+          NTBMSummary::ConvertList(onfile.baby_mind_tangent_, baby_mind_tangent_); \
+          NTBMSummary::ConvertList(onfile.baby_mind_tangent_error_, baby_mind_tangent_error_); }"
+
+#pragma read sourceClass="NTBMSummary" version="[-12]" targetClass="NTBMSummary" \
+  source="std::vector<std::vector<double>> ninja_position_; std::vector<std::vector<double>> ninja_position_error_; std::vector<std::vector<double>> ninja_tangent_; std::vector<std::vector<double>> ninja_tangent_error_" \
+  target="ninja_position_, ninja_position_error_, ninja_tangent_, ninja_tangent_error_" \
+  code="{ NTBMSummary::ConvertList(onfile.ninja_position_, ninja_position_); \
+          NTBMSummary::ConvertList(onfile.ninja_position_error_, ninja_position_error_); \
+          NTBMSummary::ConvertList(onfile.ninja_tangent_, ninja_tangent_); \
+          NTBMSummary::ConvertList(onfile.ninja_tangent_error_, ninja_tangent_error_); }"
+
 #endif
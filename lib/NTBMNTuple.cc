@@ -0,0 +1,276 @@
+#include "NTBMNTuple.hh"
+#include "NTBMSummary.hh"
+
+#include <stdexcept>
+
+#ifdef NTBM_WITH_RNTUPLE
+
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+#include <TFile.h>
+#include <RVersion.h>
+#include <ROOT/RNTuple.hxx>
+#include <ROOT/RNTupleModel.hxx>
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6, 32, 0)
+#include <ROOT/RNTupleReader.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+#endif
+
+// The RNTuple classes (RNTupleModel, RNTupleReader, RNTupleWriter) moved out of
+// ROOT::Experimental into ROOT with the stable format. ROOT 6.34 still keeps the
+// Experimental names, later versions remove them.
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6, 35, 0)
+namespace rntuple = ROOT;
+#else
+namespace rntuple = ROOT::Experimental;
+#endif
+
+namespace {
+
+// Conversion between the NTBMSummary members and the RNTuple fields
+
+template < typename T, typename U >
+void Convert(const T &from, U &to) {
+  to = from;
+}
+
+template < typename T, typename U, std::size_t N >
+void Convert(const T (&from)[N], std::array<U, N> &to) {
+  std::copy(from, from + N, to.begin());
+}
+
+template < typename T, typename U, std::size_t N >
+void Convert(const std::array<T, N> &from, U (&to)[N]) {
+  std::copy(from.begin(), from.end(), to);
+}
+
+template < typename T, typename U, std::size_t N >
+void Convert(const std::vector<T> &from, std::array<U, N> &to) {
+  if ( from.size() != N )
+    throw std::runtime_error("NTBMSummary per view list has " + std::to_string(from.size())
+			     + " elements instead of " + std::to_string(N));
+  std::copy(from.begin(), from.end(), to.begin());
+}
+
+template < typename T, typename U, std::size_t N >
+void Convert(const std::array<T, N> &from, std::vector<U> &to) {
+  to.assign(from.begin(), from.end());
+}
+
+template < typename T, typename U >
+void Convert(const std::vector<T> &from, std::vector<U> &to) {
+  to.resize(from.size());
+  for ( std::size_t i = 0; i < from.size(); i++ )
+    Convert(from[i], to[i]);
+}
+
+// One RNTuple field bound to one NTBMSummary member
+class NTupleField {
+public :
+  virtual ~NTupleField() {}
+  virtual void Write(const NTBMSummary &ntbm) = 0;
+  virtual void Read(NTBMSummary &ntbm) const = 0;
+};
+
+template < typename Member, typename Column >
+class NTupleMemberField : public NTupleField {
+public :
+  NTupleMemberField(Member NTBMSummary::*member, std::shared_ptr<Column> column) :
+    member_(member), column_(column) {}
+  void Write(const NTBMSummary &ntbm) override { Convert(ntbm.*member_, *column_); }
+  void Read(NTBMSummary &ntbm) const override { Convert(*column_, ntbm.*member_); }
+private :
+  Member NTBMSummary::*member_;
+  std::shared_ptr<Column> column_;
+};
+
+// Create the fields of the listed members (all the members if empty)
+class NTupleModelBuilder {
+public :
+  NTupleModelBuilder(const std::vector<std::string> &members) :
+    model_(rntuple::RNTupleModel::Create()), members_(members) {}
+
+  template < typename Column, typename Member >
+  void Visit(const char *name, Member NTBMSummary::*member) {
+    if ( !members_.empty() &&
+	 std::find(members_.begin(), members_.end(), name) == members_.end() )
+      return;
+    fields_.emplace_back(new NTupleMemberField<Member, Column>(member, model_->MakeField<Column>(name)));
+  }
+
+  std::unique_ptr<rntuple::RNTupleModel> model_;
+  std::vector<std::unique_ptr<NTupleField>> fields_;
+  const std::vector<std::string> members_;
+};
+
+} // namespace
+
+/**
+ * Flat data model of NTBMSummary (friend of NTBMSummary to bind the members)
+ */
+struct NTBMNTupleModel {
+
+  template < typename Visitor >
+  static void VisitMembers(Visitor &visitor) {
+    typedef std::array<float, NUMBER_OF_VIEWS> ViewPair;
+    visitor.template Visit<std::int32_t>("entry_in_daily_file_", &NTBMSummary::entry_in_daily_file_);
+    visitor.template Visit<double>("spill_pot_", &NTBMSummary::spill_pot_);
+    visitor.template Visit<std::array<double, NUMBER_OF_BUNCHES>>("bunch_pot_", &NTBMSummary::bunch_pot_);
+    visitor.template Visit<std::int32_t>("bsd_spill_number_", &NTBMSummary::bsd_spill_number_);
+    visitor.template Visit<double>("timestamp_", &NTBMSummary::timestamp_);
+    visitor.template Visit<std::int32_t>("bsd_good_spill_flag_", &NTBMSummary::bsd_good_spill_flag_);
+    visitor.template Visit<std::int32_t>("wagasci_good_spill_flag_", &NTBMSummary::wagasci_good_spill_flag_);
+    visitor.template Visit<std::array<std::int32_t, 8>>("detector_flags_", &NTBMSummary::detector_flags_);
+    // Baby MIND tracks
+    visitor.template Visit<std::int32_t>("number_of_tracks_", &NTBMSummary::number_of_tracks_);
+    visitor.template Visit<std::vector<std::int8_t>>("ninja_track_type_", &NTBMSummary::ninja_track_type_);
+    visitor.template Visit<std::vector<std::int8_t>>("momentum_type_", &NTBMSummary::momentum_type_);
+    visitor.template Visit<std::vector<float>>("momentum_", &NTBMSummary::momentum_);
+    visitor.template Visit<std::vector<float>>("momentum_error_", &NTBMSummary::momentum_error_);
+    visitor.template Visit<std::vector<ViewPair>>("baby_mind_position_", &NTBMSummary::baby_mind_position_);
+    visitor.template Visit<std::vector<ViewPair>>("baby_mind_position_error_",
+						  &NTBMSummary::baby_mind_position_error_);
+    visitor.template Visit<std::vector<ViewPair>>("baby_mind_tangent_", &NTBMSummary::baby_mind_tangent_);
+    visitor.template Visit<std::vector<ViewPair>>("baby_mind_tangent_error_",
+						  &NTBMSummary::baby_mind_tangent_error_);
+    visitor.template Visit<std::vector<std::int8_t>>("baby_mind_maximum_plane_",
+						     &NTBMSummary::baby_mind_maximum_plane_);
+    visitor.template Visit<std::vector<float>>("track_length_total_", &NTBMSummary::track_length_total_);
+    visitor.template Visit<std::vector<std::int8_t>>("charge_", &NTBMSummary::charge_);
+    visitor.template Visit<std::vector<std::int8_t>>("direction_", &NTBMSummary::direction_);
+    visitor.template Visit<std::vector<std::int8_t>>("bunch_", &NTBMSummary::bunch_);
+    // NINJA clusters
+    visitor.template Visit<std::int32_t>("number_of_ninja_clusters_", &NTBMSummary::number_of_ninja_clusters_);
+    visitor.template Visit<std::vector<std::int32_t>>("baby_mind_track_id_", &NTBMSummary::baby_mind_track_id_);
+    visitor.template Visit<std::vector<std::array<std::int32_t, NUMBER_OF_VIEWS>>>
+      ("number_of_hits_", &NTBMSummary::number_of_hits_);
+    visitor.template Visit<std::vector<std::vector<std::int32_t>>>("hit_offset_", &NTBMSummary::hit_offset_);
+    visitor.template Visit<std::vector<std::vector<std::uint8_t>>>("hit_plane_", &NTBMSummary::hit_plane_);
+    visitor.template Visit<std::vector<std::vector<std::uint8_t>>>("hit_slot_", &NTBMSummary::hit_slot_);
+    visitor.template Visit<std::vector<std::vector<float>>>("hit_pe_", &NTBMSummary::hit_pe_);
+    visitor.template Visit<std::vector<std::vector<std::int32_t>>>("hit_source_cluster_",
+								  &NTBMSummary::hit_source_cluster_);
+    visitor.template Visit<std::vector<std::int8_t>>("bunch_difference_", &NTBMSummary::bunch_difference_);
+    visitor.template Visit<std::vector<ViewPair>>("ninja_position_", &NTBMSummary::ninja_position_);
+    visitor.template Visit<std::vector<ViewPair>>("ninja_position_error_", &NTBMSummary::ninja_position_error_);
+    visitor.template Visit<std::vector<ViewPair>>("ninja_tangent_", &NTBMSummary::ninja_tangent_);
+    visitor.template Visit<std::vector<ViewPair>>("ninja_tangent_error_", &NTBMSummary::ninja_tangent_error_);
+    visitor.template Visit<std::vector<std::uint8_t>>("ninja_position_fallback_",
+						      &NTBMSummary::ninja_position_fallback_);
+    // MC information
+    visitor.template Visit<double>("normalization_", &NTBMSummary::normalization_);
+    visitor.template Visit<double>("total_cross_section_", &NTBMSummary::total_cross_section_);
+    visitor.template Visit<std::vector<std::int32_t>>("number_of_true_particles_",
+						      &NTBMSummary::number_of_true_particles_);
+    visitor.template Visit<std::vector<std::vector<std::int32_t>>>("true_particle_id_",
+								  &NTBMSummary::true_particle_id_);
+    visitor.template Visit<std::vector<std::int32_t>>("true_particle_offset_",
+						      &NTBMSummary::true_particle_offset_);
+    visitor.template Visit<std::vector<std::vector<float>>>("true_particle_position_",
+							   &NTBMSummary::true_particle_position_);
+    visitor.template Visit<std::vector<std::vector<float>>>("true_particle_tangent_",
+							   &NTBMSummary::true_particle_tangent_);
+  }
+
+};
+
+struct NTBMNTupleWriter::Impl {
+  std::vector<std::unique_ptr<NTupleField>> fields;
+  std::unique_ptr<rntuple::RNTupleWriter> writer;
+};
+
+NTBMNTupleWriter::NTBMNTupleWriter(TFile &file, const std::string &name) : impl_(new Impl) {
+  const std::vector<std::string> all_members;
+  NTupleModelBuilder builder(all_members);
+  NTBMNTupleModel::VisitMembers(builder);
+  impl_->fields = std::move(builder.fields_);
+  // pages are compressed by the ROOT implicit multithreading when it is enabled
+  impl_->writer = rntuple::RNTupleWriter::Append(std::move(builder.model_), name, file);
+}
+
+NTBMNTupleWriter::~NTBMNTupleWriter() {
+  Close();
+}
+
+void NTBMNTupleWriter::Fill(const NTBMSummary &ntbm) {
+  if ( !impl_->writer )
+    throw std::runtime_error("NTBM RNTuple writer already closed");
+  for ( auto &field : impl_->fields )
+    field->Write(ntbm);
+  impl_->writer->Fill();
+}
+
+void NTBMNTupleWriter::Close() {
+  impl_->writer.reset();
+}
+
+bool NTBMNTupleWriter::IsAvailable() {
+  return true;
+}
+
+struct NTBMNTupleReader::Impl {
+  std::vector<std::unique_ptr<NTupleField>> fields;
+  std::unique_ptr<rntuple::RNTupleReader> reader;
+};
+
+NTBMNTupleReader::NTBMNTupleReader(const std::string &path, const std::string &name,
+				   const std::vector<std::string> &members) : impl_(new Impl) {
+  NTupleModelBuilder builder(members);
+  NTBMNTupleModel::VisitMembers(builder);
+  if ( builder.fields_.size() != members.size() && !members.empty() )
+    throw std::runtime_error("Unknown NTBMSummary member in the RNTuple field list of " + path);
+  impl_->fields = std::move(builder.fields_);
+  // only the columns of the listed fields are read
+  impl_->reader = rntuple::RNTupleReader::Open(std::move(builder.model_), name, path);
+}
+
+NTBMNTupleReader::~NTBMNTupleReader() {}
+
+Long64_t NTBMNTupleReader::GetEntries() const {
+  return impl_->reader->GetNEntries();
+}
+
+void NTBMNTupleReader::GetEntry(Long64_t entry, NTBMSummary &ntbm) {
+  impl_->reader->LoadEntry(entry);
+  for ( const auto &field : impl_->fields )
+    field->Read(ntbm);
+}
+
+#else
+
+// Built without RNTuple support
+
+struct NTBMNTupleWriter::Impl {};
+
+NTBMNTupleWriter::NTBMNTupleWriter(TFile &file, const std::string &name) {
+  throw std::runtime_error("NTBM RNTuple output not available (build with NINJA_RECON_WITH_RNTUPLE=ON)");
+}
+
+NTBMNTupleWriter::~NTBMNTupleWriter() {}
+
+void NTBMNTupleWriter::Fill(const NTBMSummary &ntbm) {}
+
+void NTBMNTupleWriter::Close() {}
+
+bool NTBMNTupleWriter::IsAvailable() {
+  return false;
+}
+
+struct NTBMNTupleReader::Impl {};
+
+NTBMNTupleReader::NTBMNTupleReader(const std::string &path, const std::string &name,
+				   const std::vector<std::string> &members) {
+  throw std::runtime_error("NTBM RNTuple input not available (build with NINJA_RECON_WITH_RNTUPLE=ON) : " + path);
+}
+
+NTBMNTupleReader::~NTBMNTupleReader() {}
+
+Long64_t NTBMNTupleReader::GetEntries() const {
+  return 0;
+}
+
+void NTBMNTupleReader::GetEntry(Long64_t entry, NTBMSummary &ntbm) {}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef NTBM_NTUPLE_HH
+#define NTBM_NTUPLE_HH
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <Rtypes.h>
+
+class TFile;
+class NTBMSummary;
+
+/**
+ * Flat RNTuple data model of NTBMSummary. There is one field for each member, named after the
+ * member (e.g. "ninja_position_") like the member branches of the TTree layout.
+ * Lists of per-view pairs (cluster -> view(2)) are std::array<float, 2> collections,
+ * hit and true particle lists stay flat per view. The precision is the same as the TTree
+ * layout (float for Double32_t members, 8 bit integers for small ids and flags).
+ *
+ * RNTuple is only available when built with NINJA_RECON_WITH_RNTUPLE (ROOT 6.30 or later),
+ * otherwise the constructors throw std::runtime_error.
+ */
+
+/**
+ * Writer of NTBMSummary objects into an RNTuple of a ROOT file
+ */
+class NTBMNTupleWriter {
+
+public :
+
+  /**
+   * @param file output file (must stay open until Close)
+   * @param name RNTuple name
+   */
+  NTBMNTupleWriter(TFile &file, const std::string &name);
+
+  ~NTBMNTupleWriter();
+
+  NTBMNTupleWriter(const NTBMNTupleWriter&) = delete;
+  NTBMNTupleWriter &operator=(const NTBMNTupleWriter&) = delete;
+
+  /**
+   * Append one entry
+   * @param ntbm NTBMSummary object
+   */
+  void Fill(const NTBMSummary &ntbm);
+
+  /**
+   * Write the remaining pages and the RNTuple footer. Called before the file is closed.
+   */
+  void Close();
+
+  /**
+   * @return true if the library is built with RNTuple support
+   */
+  static bool IsAvailable();
+
+private :
+
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+
+};
+
+/**
+ * Reader of NTBMSummary objects from an RNTuple
+ */
+class NTBMNTupleReader {
+
+public :
+
+  /**
+   * @param path input file path
+   * @param name RNTuple name
+   * @param members members to be read (empty : all the members)
+   */
+  NTBMNTupleReader(const std::string &path, const std::string &name,
+		   const std::vector<std::string> &members = std::vector<std::string>());
+
+  ~NTBMNTupleReader();
+
+  NTBMNTupleReader(const NTBMNTupleReader&) = delete;
+  NTBMNTupleReader &operator=(const NTBMNTupleReader&) = delete;
+
+  /**
+   * @return number of entries
+   */
+  Long64_t GetEntries() const;
+
+  /**
+   * Read one entry. The members not read keep their values.
+   * @param entry entry number
+   * @param ntbm NTBMSummary object filled
+   */
+  void GetEntry(Long64_t entry, NTBMSummary &ntbm);
+
+private :
+
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include "NTBMReader.hh"
+#include "NTBMSummary.hh"
+#include "NTBMNTuple.hh"
+
+#include <stdexcept>
+
+#include <TFile.h>
+#include <TKey.h>
+#include <TTree.h>
+
+NTBMReader::NTBMReader(const std::string &path, const std::vector<std::string> &members,
+		       const std::string &name) :
+  file_(nullptr), tree_(nullptr), ntbm_(new NTBMSummary()) {
+  file_ = new TFile(path.c_str(), "read");
+  if ( file_->IsZombie() )
+    throw std::runtime_error("Cannot open NTBM file : " + path);
+  TKey *key = file_->GetKey(name.c_str());
+  if ( key == nullptr )
+    throw std::runtime_error("NTBM tree " + name + " not found in " + path);
+
+  if ( std::string(key->GetClassName()) == "TTree" ) {
+    tree_ = (TTree*)file_->Get(name.c_str());
+    if ( members.empty() )
+      tree_->SetBranchAddress("NTBMSummary", &ntbm_);
+    else
+      NTBMSummary::SetBranchAddress(tree_, &ntbm_, members);
+  } else {
+    ntuple_.reset(new NTBMNTupleReader(path, name, members));
+  }
+}
+
+NTBMReader::~NTBMReader() {
+  ntuple_.reset();
+  if ( tree_ ) tree_->ResetBranchAddresses();
+  file_->Close();
+  delete file_;
+  delete ntbm_;
+}
+
+Long64_t NTBMReader::GetEntries() const {
+  return tree_ ? tree_->GetEntries() : ntuple_->GetEntries();
+}
+
+void NTBMReader::GetEntry(Long64_t entry) {
+  if ( tree_ )
+    tree_->GetEntry(entry);
+  else
+    ntuple_->GetEntry(entry, *ntbm_);
+}
+
+NTBMSummary *NTBMReader::GetNTBMSummary() const {
+  return ntbm_;
+}
+
+bool NTBMReader::IsNTuple() const {
+  return tree_ == nullptr;
+}
@@ -0,0 +1,67 @@
+#ifndef NTBM_READER_HH
+#define NTBM_READER_HH
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <Rtypes.h>
+
+class TFile;
+class TTree;
+class NTBMSummary;
+class NTBMNTupleReader;
+
+/**
+ * Reader of an NTBM file written either as a TTree (default) or as an RNTuple
+ * (TrackMatch --rntuple). The layout is found from the class of the object in the file.
+ */
+class NTBMReader {
+
+public :
+
+  /**
+   * @param path input NTBM file path
+   * @param members members to be read (empty : all the members)
+   * @param name tree/RNTuple name
+   */
+  NTBMReader(const std::string &path,
+	     const std::vector<std::string> &members = std::vector<std::string>(),
+	     const std::string &name = "tree");
+
+  ~NTBMReader();
+
+  NTBMReader(const NTBMReader&) = delete;
+  NTBMReader &operator=(const NTBMReader&) = delete;
+
+  /**
+   * @return number of entries
+   */
+  Long64_t GetEntries() const;
+
+  /**
+   * Read one entry into the NTBMSummary object of the reader
+   * @param entry entry number
+   */
+  void GetEntry(Long64_t entry);
+
+  /**
+   * @return NTBMSummary object filled by GetEntry (owned by the reader)
+   */
+  NTBMSummary *GetNTBMSummary() const;
+
+  /**
+   * @return true if the file is an RNTuple
+   */
+  bool IsNTuple() const;
+
+private :
+
+  TFile *file_;
+  TTree *tree_;
+  NTBMSummary *ntbm_;
+  std::unique_ptr<NTBMNTupleReader> ntuple_;
+
+};
+
+#endif
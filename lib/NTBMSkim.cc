@@ -0,0 +1,124 @@
+#include "NTBMSkim.hh"
+#include "NTBMSummary.hh"
+
+#include <memory>
+#include <stdexcept>
+
+#include <TDirectory.h>
+#include <TEntryList.h>
+#include <TKey.h>
+#include <TList.h>
+#include <TString.h>
+
+const int NTBMSkim::ANY_TRACK_TYPE;
+const int NTBMSkim::NO_SKIM;
+
+NTBMSkim::NTBMSkim(const std::string &tree_name) : tree_name_(tree_name) {
+  entries_[ANY_TRACK_TYPE];
+}
+
+void NTBMSkim::AddEntry(int track_type, Long64_t entry) {
+  std::vector<Long64_t> &entries = entries_[track_type];
+  if ( !entries.empty() && entries.back() > entry )
+    throw std::invalid_argument("Skim entries should be added in increasing order");
+  if ( entries.empty() || entries.back() != entry )
+    entries.push_back(entry);
+}
+
+void NTBMSkim::Fill(const NTBMSummary &ntbm, Long64_t entry) {
+  for ( int icluster = 0; icluster < ntbm.GetNumberOfNinjaClusters(); icluster++ ) {
+    if ( !Is2dCluster(ntbm, icluster) ) continue;
+    AddEntry(ANY_TRACK_TYPE, entry);
+    const int itrack = ntbm.GetBabyMindTrackId(icluster);
+    if ( itrack >= 0 && itrack < ntbm.GetNumberOfTracks() )
+      AddEntry(ntbm.GetNinjaTrackType(itrack), entry);
+  }
+}
+
+void NTBMSkim::Add(const NTBMSkim &other, Long64_t offset) {
+  for ( const auto &list : other.entries_ )
+    for ( Long64_t entry : list.second )
+      AddEntry(list.first, entry + offset);
+}
+
+bool NTBMSkim::Read(TDirectory &directory) {
+  entries_.clear();
+  entries_[ANY_TRACK_TYPE];
+  const std::string any_name = GetListName(tree_name_, ANY_TRACK_TYPE);
+  const TKey *any_key = directory.GetKey(any_name.c_str());
+  if ( any_key == nullptr || std::string(any_key->GetClassName()) != "TEntryList" )
+    return false;
+
+  // the lists are found from their names, the highest key cycle is read
+  const std::string type_prefix = any_name + "_type";
+  TIter next(directory.GetListOfKeys());
+  while ( TKey *key = (TKey*)next() ) {
+    const std::string name = key->GetName();
+    int track_type = ANY_TRACK_TYPE;
+    if ( name.compare(0, type_prefix.size(), type_prefix) == 0 )
+      track_type = std::stoi(name.substr(type_prefix.size()));
+    else if ( name != any_name )
+      continue;
+    std::vector<Long64_t> &entries = entries_[track_type];
+    if ( !entries.empty() ) continue;
+    std::unique_ptr<TEntryList> list(dynamic_cast<TEntryList*>(directory.Get(name.c_str())));
+    if ( list == nullptr ) continue;
+    list->SetDirectory(nullptr);
+    entries.reserve(list->GetN());
+    for ( Long64_t ientry = 0; ientry < list->GetN(); ientry++ )
+      entries.push_back(list->GetEntry(ientry));
+  }
+  return true;
+}
+
+void NTBMSkim::Write() const {
+  // the list of any track type is written even if empty so that the skim is found
+  for ( const auto &list : entries_ ) {
+    if ( list.first != ANY_TRACK_TYPE && list.second.empty() ) continue;
+    const std::string name = GetListName(tree_name_, list.first);
+    TEntryList entry_list(name.c_str(), list.first == ANY_TRACK_TYPE ?
+			  "Spills with matched 2d NINJA clusters" :
+			  Form("Spills with matched 2d NINJA clusters of track type %d", list.first));
+    entry_list.SetDirectory(nullptr);
+    entry_list.SetTreeName(tree_name_.c_str());
+    for ( Long64_t entry : list.second )
+      entry_list.Enter(entry);
+    entry_list.Write();
+  }
+}
+
+const std::vector<Long64_t> &NTBMSkim::GetEntries(int track_type) const {
+  static const std::vector<Long64_t> no_entries;
+  auto it = entries_.find(track_type);
+  return it == entries_.end() ? no_entries : it->second;
+}
+
+std::vector<int> NTBMSkim::GetTrackTypes() const {
+  std::vector<int> track_types;
+  for ( const auto &list : entries_ )
+    if ( list.first != ANY_TRACK_TYPE && !list.second.empty() )
+      track_types.push_back(list.first);
+  return track_types;
+}
+
+const std::string &NTBMSkim::GetTreeName() const {
+  return tree_name_;
+}
+
+std::string NTBMSkim::GetListName(const std::string &tree_name, int track_type) {
+  if ( track_type == ANY_TRACK_TYPE )
+    return tree_name + "_skim2d";
+  return tree_name + "_skim2d_type" + std::to_string(track_type);
+}
+
+bool NTBMSkim::Is2dCluster(const NTBMSummary &ntbm, int icluster) {
+  const std::vector<int> &number_of_hits = ntbm.GetNumberOfHits(icluster);
+  for ( int view = 0; view < NUMBER_OF_VIEWS; view++ )
+    if ( number_of_hits.at(view) == 0 ) return false;
+  return true;
+}
+
+std::vector<std::string> NTBMSkim::GetMembers() {
+  return {"number_of_tracks_", "ninja_track_type_", "number_of_ninja_clusters_",
+	  "baby_mind_track_id_", "number_of_hits_"};
+}
@@ -0,0 +1,108 @@
+#ifndef NTBM_SKIM_HH
+#define NTBM_SKIM_HH
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <Rtypes.h>
+
+class TDirectory;
+class NTBMSummary;
+
+/**
+ * Entry index of the spills with matched 2d NINJA clusters of one NTBM tree (or RNTuple).
+ * TrackMatch writes it alongside the tree as TEntryList objects, one for any track type
+ * ("<tree>_skim2d") and one for each Baby MIND track type of the matched clusters
+ * ("<tree>_skim2d_type<track type>"). Analyses of the matched clusters read only these
+ * entries instead of all the spills. The entries are those of the tree in the same file.
+ */
+class NTBMSkim {
+
+public :
+
+  ///> Track type of the list of the spills with matched 2d clusters of any track type
+  static const int ANY_TRACK_TYPE = -100;
+  ///> No skim, all the spills are used
+  static const int NO_SKIM = -101;
+
+  /**
+   * @param tree_name name of the tree (or RNTuple) the entries refer to
+   */
+  explicit NTBMSkim(const std::string &tree_name = "tree");
+
+  /**
+   * Add the spill if it has matched 2d clusters. Entries are added in increasing order.
+   * @param ntbm NTBMSummary object of the spill
+   * @param entry entry of the spill in the tree
+   */
+  void Fill(const NTBMSummary &ntbm, Long64_t entry);
+
+  /**
+   * Append the entries of another skim (e.g. of the next shard)
+   * @param other skim of the same tree name
+   * @param offset entry of the first spill of the other skim in this one
+   */
+  void Add(const NTBMSkim &other, Long64_t offset);
+
+  /**
+   * Read the entry lists written by Write
+   * @param directory directory of the tree
+   * @return false if the file has no skim of the tree (the skim is then empty)
+   */
+  bool Read(TDirectory &directory);
+
+  /**
+   * Write the entry lists in the current directory
+   */
+  void Write() const;
+
+  /**
+   * @param track_type Baby MIND track type of the matched clusters (ANY_TRACK_TYPE : any type)
+   * @return entries with matched 2d clusters in increasing order
+   */
+  const std::vector<Long64_t> &GetEntries(int track_type = ANY_TRACK_TYPE) const;
+
+  /**
+   * @return track types with at least one entry
+   */
+  std::vector<int> GetTrackTypes() const;
+
+  /**
+   * @return tree name
+   */
+  const std::string &GetTreeName() const;
+
+  /**
+   * @param tree_name tree name
+   * @param track_type Baby MIND track type (ANY_TRACK_TYPE : any type)
+   * @return name of the entry list in the file
+   */
+  static std::string GetListName(const std::string &tree_name, int track_type);
+
+  /**
+   * @param ntbm NTBMSummary object
+   * @param icluster cluster id
+   * @return true if the cluster has hits in both views
+   */
+  static bool Is2dCluster(const NTBMSummary &ntbm, int icluster);
+
+  /**
+   * @return NTBMSummary members used by Fill
+   */
+  static std::vector<std::string> GetMembers();
+
+private :
+
+  /**
+   * @param track_type track type
+   * @param entry entry not smaller than the last one of the list
+   */
+  void AddEntry(int track_type, Long64_t entry);
+
+  std::string tree_name_;
+  std::map<int, std::vector<Long64_t> > entries_;
+
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef NTBM_SMALL_VECTOR_HH
+#define NTBM_SMALL_VECTOR_HH
+
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+/**
+ * List of trivially copyable values stored inline up to N elements and on the
+ * heap beyond. Used for the short lists built for every cluster (hits of one view,
+ * cluster ids of one bunch) so that the typical list needs no heap allocation.
+ * The heap buffer, once allocated, is kept by clear.
+ */
+template < typename T, std::size_t N >
+class NTBMSmallVector {
+
+  static_assert(std::is_trivially_copyable<T>::value, "NTBMSmallVector holds trivially copyable values only");
+
+public :
+
+  typedef T value_type;
+  typedef T *iterator;
+  typedef const T *const_iterator;
+
+  NTBMSmallVector() : data_(inline_data_), size_(0), capacity_(N) {}
+
+  NTBMSmallVector(const NTBMSmallVector &other) : data_(inline_data_), size_(0), capacity_(N) {
+    Assign(other.data_, other.size_);
+  }
+
+  NTBMSmallVector(std::initializer_list<T> values) : data_(inline_data_), size_(0), capacity_(N) {
+    Assign(values.begin(), values.size());
+  }
+
+  NTBMSmallVector &operator=(const NTBMSmallVector &other) {
+    if ( this != &other ) Assign(other.data_, other.size_);
+    return *this;
+  }
+
+  NTBMSmallVector &operator=(std::initializer_list<T> values) {
+    Assign(values.begin(), values.size());
+    return *this;
+  }
+
+  ~NTBMSmallVector() {
+    if ( data_ != inline_data_ ) std::free(data_);
+  }
+
+  std::size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  std::size_t capacity() const { return capacity_; }
+
+  /**
+   * @return true if the values are stored inline (no heap allocation)
+   */
+  bool is_inline() const { return data_ == inline_data_; }
+
+  T *data() { return data_; }
+
+  const T *data() const { return data_; }
+
+  iterator begin() { return data_; }
+
+  iterator end() { return data_ + size_; }
+
+  const_iterator begin() const { return data_; }
+
+  const_iterator end() const { return data_ + size_; }
+
+  T &operator[](std::size_t i) { return data_[i]; }
+
+  const T &operator[](std::size_t i) const { return data_[i]; }
+
+  T &front() { return data_[0]; }
+
+  const T &front() const { return data_[0]; }
+
+  T &back() { return data_[size_ - 1]; }
+
+  const T &back() const { return data_[size_ - 1]; }
+
+  const T &at(std::size_t i) const {
+    if ( i >= size_ )
+      throw std::out_of_range("Small vector index out of range");
+    return data_[i];
+  }
+
+  void push_back(const T &value) {
+    if ( size_ == capacity_ ) {
+      // value may refer to an element moved by the reallocation
+      const T copy = value;
+      reserve(2 * capacity_);
+      data_[size_++] = copy;
+    } else {
+      data_[size_++] = value;
+    }
+  }
+
+  void clear() { size_ = 0; }
+
+  void reserve(std::size_t capacity) {
+    if ( capacity <= capacity_ ) return;
+    T *data = static_cast<T*>(std::malloc(capacity * sizeof(T)));
+    if ( data == nullptr )
+      throw std::bad_alloc();
+    if ( size_ > 0 )
+      std::memcpy(data, data_, size_ * sizeof(T));
+    if ( data_ != inline_data_ ) std::free(data_);
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+private :
+
+  void Assign(const T *data, std::size_t size) {
+    size_ = 0;
+    reserve(size);
+    if ( size > 0 )
+      std::memcpy(data_, data, size * sizeof(T));
+    size_ = size;
+  }
+
+  T *data_;
+  std::size_t size_;
+  std::size_t capacity_;
+  T inline_data_[N];
+
+};
+
+#endif
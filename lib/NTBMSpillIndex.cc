@@ -0,0 +1,398 @@
+#include "NTBMSpillIndex.hh"
+#include "NTBMSummary.hh"
+#include "NTBMReader.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/crc.hpp>
+
+namespace fs = boost::filesystem;
+
+///> Spill index magic string
+static const char SPILL_INDEX_MAGIC[8] = {'N', 'T', 'B', 'M', 'S', 'P', 'I', 'X'};
+///> Spill index format version
+static const std::uint32_t SPILL_INDEX_VERSION = 3;
+///> End marker of a block
+static const char SPILL_INDEX_BLOCK_END[8] = {'S', 'P', 'I', 'X', 'E', 'N', 'D', '\0'};
+///> Size of the block trailer (CRC-32 of the block header and of the records, end marker)
+static const std::int64_t SPILL_INDEX_TRAILER_SIZE = 2 * sizeof(std::uint32_t) + sizeof(SPILL_INDEX_BLOCK_END);
+///> Size of the file header
+static const std::int64_t SPILL_INDEX_HEADER_SIZE = sizeof(SPILL_INDEX_MAGIC) + sizeof(std::uint32_t);
+
+template <typename T>
+static void AppendValue(std::string &data, T value) {
+  data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void AppendString(std::string &data, const std::string &value) {
+  AppendValue<std::uint32_t>(data, value.size());
+  data.append(value);
+}
+
+template <typename T>
+static T ReadValue(std::istream &is) {
+  T value;
+  is.read(reinterpret_cast<char*>(&value), sizeof(T));
+  if ( !is )
+    throw std::runtime_error("Spill index truncated");
+  return value;
+}
+
+static std::string ReadString(std::istream &is, std::uint64_t max_size) {
+  const std::uint32_t size = ReadValue<std::uint32_t>(is);
+  if ( size > max_size )
+    throw std::runtime_error("Spill index corrupted (string longer than its block)");
+  std::string value(size, '\0');
+  is.read(&value[0], value.size());
+  if ( !is )
+    throw std::runtime_error("Spill index truncated");
+  return value;
+}
+
+static std::uint32_t GetChecksum(const std::string &data) {
+  boost::crc_32_type crc;
+  crc.process_bytes(data.data(), data.size());
+  return crc.checksum();
+}
+
+template <typename T>
+static std::uint32_t GetChecksum(const std::vector<T> &first, const std::vector<T> &second) {
+  boost::crc_32_type crc;
+  crc.process_bytes(first.data(), first.size() * sizeof(T));
+  crc.process_bytes(second.data(), second.size() * sizeof(T));
+  return crc.checksum();
+}
+
+/**
+ * Lock of the index file, released when destroyed
+ */
+class SpillIndexLock {
+
+public :
+
+  /**
+   * @param path index file path
+   * @param exclusive exclusive lock to append (the file is created if needed) or shared lock to read
+   */
+  SpillIndexLock(const std::string &path, bool exclusive) {
+    fd_ = exclusive ? ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644) : ::open(path.c_str(), O_RDONLY);
+    if ( fd_ < 0 )
+      throw std::runtime_error("Cannot open spill index : " + path + " (" + std::strerror(errno) + ")");
+    if ( ::flock(fd_, exclusive ? LOCK_EX : LOCK_SH) != 0 ) {
+      ::close(fd_);
+      throw std::runtime_error("Cannot lock spill index : " + path + " (" + std::strerror(errno) + ")");
+    }
+  }
+
+  ~SpillIndexLock() {
+    ::close(fd_);
+  }
+
+  SpillIndexLock(const SpillIndexLock&) = delete;
+  SpillIndexLock &operator=(const SpillIndexLock&) = delete;
+
+  int GetDescriptor() const { return fd_; }
+
+private :
+
+  int fd_;
+
+};
+
+NTBMSpillIndex::NTBMSpillIndex(const std::string &path) : path_(path) {}
+
+Long64_t NTBMSpillIndex::Add(const std::string &ntbm_path, const std::string &tree_name) const {
+
+  std::vector<Record> records;
+  {
+    NTBMReader reader(ntbm_path, {"bsd_spill_number_", "timestamp_"}, tree_name);
+    const NTBMSummary *ntbm = reader.GetNTBMSummary();
+    if ( reader.GetEntries() > std::numeric_limits<std::int32_t>::max() )
+      throw std::runtime_error("Too many entries to be indexed in " + ntbm_path);
+    records.reserve(reader.GetEntries());
+    for ( Long64_t ientry = 0; ientry < reader.GetEntries(); ientry++ ) {
+      reader.GetEntry(ientry);
+      records.push_back({ntbm->GetTimestamp(), ntbm->GetBsdSpillNumber(), (std::int32_t)ientry});
+    }
+  }
+
+  std::vector<Record> spill_number_records(records);
+  std::sort(spill_number_records.begin(), spill_number_records.end(),
+	    [](const Record &lhs, const Record &rhs) {
+	      return lhs.bsd_spill_number < rhs.bsd_spill_number ||
+		( lhs.bsd_spill_number == rhs.bsd_spill_number && lhs.entry < rhs.entry );
+	    });
+  std::vector<Record> &timestamp_records = records;
+  std::sort(timestamp_records.begin(), timestamp_records.end(),
+	    [](const Record &lhs, const Record &rhs) {
+	      return lhs.timestamp < rhs.timestamp ||
+		( lhs.timestamp == rhs.timestamp && lhs.entry < rhs.entry );
+	    });
+
+  // The block is built in memory and appended with one write
+  Block block_header;
+  block_header.path = fs::absolute(ntbm_path).string();
+  block_header.tree_name = tree_name;
+  block_header.number_of_spills = records.size();
+  block_header.min_bsd_spill_number = records.empty() ? 0 : spill_number_records.front().bsd_spill_number;
+  block_header.max_bsd_spill_number = records.empty() ? 0 : spill_number_records.back().bsd_spill_number;
+  block_header.min_timestamp = records.empty() ? 0. : timestamp_records.front().timestamp;
+  block_header.max_timestamp = records.empty() ? 0. : timestamp_records.back().timestamp;
+  const std::string header = EncodeBlockHeader(block_header);
+  std::string block;
+  AppendValue<std::uint64_t>(block, header.size() + 2 * records.size() * sizeof(Record) + SPILL_INDEX_TRAILER_SIZE);
+  block.append(header);
+  for ( const auto &record : spill_number_records )
+    AppendValue<Record>(block, record);
+  for ( const auto &record : timestamp_records )
+    AppendValue<Record>(block, record);
+  AppendValue<std::uint32_t>(block, GetChecksum(header));
+  AppendValue<std::uint32_t>(block, GetChecksum(spill_number_records, timestamp_records));
+  block.append(SPILL_INDEX_BLOCK_END, sizeof(SPILL_INDEX_BLOCK_END));
+
+  SpillIndexLock lock(path_, true);
+  const int fd = lock.GetDescriptor();
+  struct stat status;
+  if ( ::fstat(fd, &status) != 0 )
+    throw std::runtime_error("Cannot stat spill index : " + path_);
+  // not to append to another file given by mistake, nor to a corrupted index
+  std::int64_t complete_size = 0;
+  if ( status.st_size > 0 ) {
+    std::ifstream is(path_, std::ios::binary);
+    for ( const auto &block : ReadBlocks(is, complete_size) )
+      CheckRecords(is, block);
+  }
+  // a block cut by a job stopped while writing it is removed (its file has to be added again)
+  if ( complete_size < status.st_size && ::ftruncate(fd, complete_size) != 0 )
+    throw std::runtime_error("Cannot remove the incomplete block of spill index : " + path_
+			     + " (" + std::strerror(errno) + ")");
+  std::string data;
+  if ( complete_size == 0 ) {
+    data.append(SPILL_INDEX_MAGIC, sizeof(SPILL_INDEX_MAGIC));
+    AppendValue<std::uint32_t>(data, SPILL_INDEX_VERSION);
+  }
+  data.append(block);
+
+  std::size_t written = 0;
+  while ( written < data.size() ) {
+    const ssize_t size = ::write(fd, data.data() + written, data.size() - written);
+    if ( size < 0 && errno == EINTR ) continue;
+    if ( size <= 0 )
+      throw std::runtime_error("Cannot write spill index : " + path_ + " (" + std::strerror(errno) + ")");
+    written += size;
+  }
+
+  return records.size();
+}
+
+std::string NTBMSpillIndex::EncodeBlockHeader(const Block &block) {
+  std::string header;
+  AppendString(header, block.path);
+  AppendString(header, block.tree_name);
+  AppendValue<std::uint64_t>(header, block.number_of_spills);
+  AppendValue<std::int32_t>(header, block.min_bsd_spill_number);
+  AppendValue<std::int32_t>(header, block.max_bsd_spill_number);
+  AppendValue<double>(header, block.min_timestamp);
+  AppendValue<double>(header, block.max_timestamp);
+  return header;
+}
+
+std::vector<NTBMSpillIndex::Block> NTBMSpillIndex::ReadBlocks(std::istream &is, std::int64_t &complete_size) const {
+
+  is.seekg(0, std::ios::end);
+  const std::int64_t file_size = is.tellg();
+  is.seekg(0, std::ios::beg);
+
+  // the header is written with the first block, it may be cut as well
+  complete_size = 0;
+  std::string file_header(std::min(file_size, SPILL_INDEX_HEADER_SIZE), '\0');
+  is.read(&file_header[0], file_header.size());
+  if ( !is || std::memcmp(file_header.data(), SPILL_INDEX_MAGIC,
+			  std::min(file_header.size(), sizeof(SPILL_INDEX_MAGIC))) != 0 )
+    throw std::runtime_error("Not a spill index : " + path_);
+  if ( file_size < SPILL_INDEX_HEADER_SIZE )
+    return std::vector<Block>();
+  std::uint32_t version;
+  std::memcpy(&version, file_header.data() + sizeof(SPILL_INDEX_MAGIC), sizeof(version));
+  if ( version != SPILL_INDEX_VERSION )
+    throw std::runtime_error("Spill index version not supported : " + std::to_string(version)
+			     + " (rebuild the index) : " + path_);
+
+  // Only the headers and the trailers are read, the records are skipped
+  std::vector<Block> blocks;
+  std::map<std::pair<std::string, std::string>, std::size_t> block_ids;
+  std::int64_t block_begin = SPILL_INDEX_HEADER_SIZE;
+  while ( true ) {
+    complete_size = block_begin;
+    // a block cut while it was written can only be the last one
+    if ( file_size - block_begin < (std::int64_t)sizeof(std::uint64_t) ) break;
+    is.seekg(block_begin);
+    const std::uint64_t block_size = ReadValue<std::uint64_t>(is);
+    if ( block_size > (std::uint64_t)( file_size - block_begin - sizeof(std::uint64_t) ) ) break;
+    const std::int64_t block_end = block_begin + sizeof(std::uint64_t) + block_size;
+    if ( block_size < (std::uint64_t)SPILL_INDEX_TRAILER_SIZE )
+      throw std::runtime_error("Spill index corrupted (block too short) : " + path_);
+
+    // the trailer is checked before the header is used
+    is.seekg(block_end - SPILL_INDEX_TRAILER_SIZE);
+    const std::uint32_t checksum = ReadValue<std::uint32_t>(is);
+    const std::uint32_t records_checksum = ReadValue<std::uint32_t>(is);
+    char end[sizeof(SPILL_INDEX_BLOCK_END)];
+    is.read(end, sizeof(end));
+    if ( !is || std::memcmp(end, SPILL_INDEX_BLOCK_END, sizeof(end)) != 0 )
+      throw std::runtime_error("Spill index corrupted (no block end marker) : " + path_);
+
+    is.seekg(block_begin + sizeof(std::uint64_t));
+    Block block;
+    block.path = ReadString(is, block_size);
+    block.tree_name = ReadString(is, block_size);
+    block.number_of_spills = ReadValue<std::uint64_t>(is);
+    block.min_bsd_spill_number = ReadValue<std::int32_t>(is);
+    block.max_bsd_spill_number = ReadValue<std::int32_t>(is);
+    block.min_timestamp = ReadValue<double>(is);
+    block.max_timestamp = ReadValue<double>(is);
+    const std::string header = EncodeBlockHeader(block);
+    if ( GetChecksum(header) != checksum ||
+	 block_size != header.size() + 2 * block.number_of_spills * sizeof(Record) + SPILL_INDEX_TRAILER_SIZE )
+      throw std::runtime_error("Spill index corrupted (block header checksum) : " + path_);
+    block.spill_number_records = block_begin + sizeof(std::uint64_t) + header.size();
+    block.timestamp_records = block.spill_number_records + block.number_of_spills * sizeof(Record);
+    block.records_checksum = records_checksum;
+
+    // a tree of a file indexed again supersedes its earlier block
+    const std::pair<std::string, std::string> key(block.path, block.tree_name);
+    auto it = block_ids.find(key);
+    if ( it == block_ids.end() ) {
+      block_ids[key] = blocks.size();
+      blocks.push_back(block);
+    } else {
+      blocks.at(it->second) = block;
+    }
+    block_begin = block_end;
+  }
+  return blocks;
+}
+
+std::vector<NTBMSpillIndex::Block> NTBMSpillIndex::ReadBlocks(std::istream &is) const {
+  std::int64_t complete_size = 0;
+  return ReadBlocks(is, complete_size);
+}
+
+void NTBMSpillIndex::CheckRecords(std::istream &is, const Block &block) const {
+  // both record lists are contiguous, they are read by chunks
+  boost::crc_32_type crc;
+  std::vector<char> buffer(1 << 16);
+  std::uint64_t remaining = 2 * block.number_of_spills * sizeof(Record);
+  is.seekg(block.spill_number_records);
+  while ( remaining > 0 ) {
+    const std::size_t size = std::min<std::uint64_t>(remaining, buffer.size());
+    is.read(buffer.data(), size);
+    if ( !is )
+      throw std::runtime_error("Spill index truncated : " + path_);
+    crc.process_bytes(buffer.data(), size);
+    remaining -= size;
+  }
+  if ( crc.checksum() != block.records_checksum )
+    throw std::runtime_error("Spill index corrupted (records checksum of " + block.path + " : "
+			     + block.tree_name + ") : " + path_);
+}
+
+NTBMSpillIndex::Record NTBMSpillIndex::ReadRecord(std::istream &is, std::int64_t records, std::uint64_t i) {
+  is.seekg(records + i * sizeof(Record));
+  return ReadValue<Record>(is);
+}
+
+NTBMSpillLocation NTBMSpillIndex::GetLocation(const Block &block, const Record &record) {
+  return {block.path, block.tree_name, record.entry, record.bsd_spill_number, record.timestamp};
+}
+
+/**
+ * @param lhs spill location
+ * @param rhs spill location
+ * @return true if lhs is earlier
+ */
+static bool CompareSpillLocations(const NTBMSpillLocation &lhs, const NTBMSpillLocation &rhs) {
+  if ( lhs.timestamp != rhs.timestamp ) return lhs.timestamp < rhs.timestamp;
+  if ( lhs.path != rhs.path ) return lhs.path < rhs.path;
+  return lhs.entry < rhs.entry;
+}
+
+std::vector<NTBMSpillLocation> NTBMSpillIndex::FindSpillNumber(int bsd_spill_number) const {
+  SpillIndexLock lock(path_, false);
+  std::ifstream is(path_, std::ios::binary);
+  std::vector<NTBMSpillLocation> locations;
+  for ( const auto &block : ReadBlocks(is) ) {
+    if ( block.number_of_spills == 0 ||
+	 bsd_spill_number < block.min_bsd_spill_number ||
+	 bsd_spill_number > block.max_bsd_spill_number )
+      continue;
+    CheckRecords(is, block);
+    // first record with the spill number
+    std::uint64_t first = 0;
+    std::uint64_t last = block.number_of_spills;
+    while ( first < last ) {
+      const std::uint64_t middle = first + ( last - first ) / 2;
+      if ( ReadRecord(is, block.spill_number_records, middle).bsd_spill_number < bsd_spill_number )
+	first = middle + 1;
+      else
+	last = middle;
+    }
+    for ( std::uint64_t i = first; i < block.number_of_spills; i++ ) {
+      const Record record = ReadRecord(is, block.spill_number_records, i);
+      if ( record.bsd_spill_number != bsd_spill_number ) break;
+      locations.push_back(GetLocation(block, record));
+    }
+  }
+  std::sort(locations.begin(), locations.end(), CompareSpillLocations);
+  return locations;
+}
+
+std::vector<NTBMSpillLocation> NTBMSpillIndex::FindTimestamp(double timestamp, double tolerance) const {
+  SpillIndexLock lock(path_, false);
+  std::ifstream is(path_, std::ios::binary);
+  std::vector<NTBMSpillLocation> locations;
+  for ( const auto &block : ReadBlocks(is) ) {
+    if ( block.number_of_spills == 0 ||
+	 timestamp + tolerance < block.min_timestamp ||
+	 timestamp - tolerance > block.max_timestamp )
+      continue;
+    CheckRecords(is, block);
+    // first record in the time window
+    std::uint64_t first = 0;
+    std::uint64_t last = block.number_of_spills;
+    while ( first < last ) {
+      const std::uint64_t middle = first + ( last - first ) / 2;
+      if ( ReadRecord(is, block.timestamp_records, middle).timestamp < timestamp - tolerance )
+	first = middle + 1;
+      else
+	last = middle;
+    }
+    for ( std::uint64_t i = first; i < block.number_of_spills; i++ ) {
+      const Record record = ReadRecord(is, block.timestamp_records, i);
+      if ( record.timestamp > timestamp + tolerance ) break;
+      locations.push_back(GetLocation(block, record));
+    }
+  }
+  std::sort(locations.begin(), locations.end(), CompareSpillLocations);
+  return locations;
+}
+
+std::map<std::pair<std::string, std::string>, Long64_t> NTBMSpillIndex::GetFiles() const {
+  SpillIndexLock lock(path_, false);
+  std::ifstream is(path_, std::ios::binary);
+  std::map<std::pair<std::string, std::string>, Long64_t> files;
+  for ( const auto &block : ReadBlocks(is) )
+    files[std::make_pair(block.path, block.tree_name)] = block.number_of_spills;
+  return files;
+}
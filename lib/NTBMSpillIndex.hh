@@ -0,0 +1,167 @@
+#ifndef NTBM_SPILL_INDEX_HH
+#define NTBM_SPILL_INDEX_HH
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstdint>
+#include <iosfwd>
+
+#include <Rtypes.h>
+
+/**
+ * Location of a spill in the NTBM files
+ */
+struct NTBMSpillLocation {
+  ///> NTBM file path
+  std::string path;
+  ///> tree (or RNTuple) name
+  std::string tree_name;
+  ///> entry in the tree
+  Long64_t entry;
+  ///> BSD spill number
+  int bsd_spill_number;
+  ///> BSD timestamp [s]
+  double timestamp;
+};
+
+/**
+ * Index of the spills of many NTBM files (e.g. all the daily files of a run period) by
+ * BSD spill number and by timestamp. The index file is built incrementally, one NTBM
+ * file is appended as a block after it is processed. A tree of a file indexed again
+ * supersedes its earlier block. A lookup reads the block headers and only the blocks whose
+ * range contains the key (checked, then binary searched), so that it does not depend on the
+ * number of spills of the other files.
+ *
+ * header  : magic "NTBMSPIX" (8 bytes), version (uint32)
+ * block   : block length (uint64, from the block header to the trailer included),
+ *           block header, then the spill records sorted by BSD spill number and the same
+ *           records sorted by timestamp, then the trailer
+ * block header : path length (uint32), absolute NTBM file path, tree name length (uint32),
+ *           tree name, number of spills (uint64), minimum/maximum BSD spill number (int32 x 2),
+ *           minimum/maximum timestamp (double x 2)
+ * record  : timestamp (double), BSD spill number (int32), entry (int32)
+ * trailer : CRC-32 of the block header (uint32), CRC-32 of both record lists (uint32),
+ *           end marker "SPIXEND" (8 bytes with the null)
+ *
+ * All values are in the native byte order. Blocks are appended with one write under an
+ * exclusive file lock, so that several jobs can add their files to the same index at the
+ * same time. A block cut by a job stopped while writing is the last one of the file : it is
+ * skipped by the lookups and removed by the next Add. A complete block with a wrong trailer
+ * (corrupted file) is an error : the header checksum is checked for all the blocks, the
+ * records checksum for the blocks searched by a lookup and for all the blocks by Add.
+ */
+class NTBMSpillIndex {
+
+public :
+
+  /**
+   * @param path index file path (created by the first Add)
+   */
+  explicit NTBMSpillIndex(const std::string &path);
+
+  /**
+   * Index the spills of one NTBM file and append them to the index file
+   * @param ntbm_path NTBM file path (TTree or RNTuple)
+   * @param tree_name tree (or RNTuple) name
+   * @return number of spills indexed
+   */
+  Long64_t Add(const std::string &ntbm_path, const std::string &tree_name = "tree") const;
+
+  /**
+   * @param bsd_spill_number BSD spill number
+   * @return spills with the BSD spill number sorted by timestamp
+   */
+  std::vector<NTBMSpillLocation> FindSpillNumber(int bsd_spill_number) const;
+
+  /**
+   * @param timestamp BSD timestamp [s]
+   * @param tolerance largest difference from the timestamp [s]
+   * @return spills within the tolerance sorted by timestamp
+   */
+  std::vector<NTBMSpillLocation> FindTimestamp(double timestamp, double tolerance) const;
+
+  /**
+   * @return indexed NTBM files and trees (path, tree name) and their number of spills
+   */
+  std::map<std::pair<std::string, std::string>, Long64_t> GetFiles() const;
+
+private :
+
+  /**
+   * Spill record stored in the index file
+   */
+  struct Record {
+    double timestamp;
+    std::int32_t bsd_spill_number;
+    std::int32_t entry;
+  };
+
+  /**
+   * Block of one NTBM file in the index file
+   */
+  struct Block {
+    std::string path;
+    std::string tree_name;
+    std::uint64_t number_of_spills;
+    std::int32_t min_bsd_spill_number;
+    std::int32_t max_bsd_spill_number;
+    double min_timestamp;
+    double max_timestamp;
+    ///> position of the records sorted by BSD spill number in the index file
+    std::int64_t spill_number_records;
+    ///> position of the records sorted by timestamp in the index file
+    std::int64_t timestamp_records;
+    ///> CRC-32 of both record lists
+    std::uint32_t records_checksum;
+  };
+
+  /**
+   * Read the block headers
+   * @param is index file stream
+   * @param complete_size size of the file up to the end of the last complete block (filled)
+   * @return latest block of each NTBM file and tree
+   */
+  std::vector<Block> ReadBlocks(std::istream &is, std::int64_t &complete_size) const;
+
+  /**
+   * Read the block headers of the complete blocks
+   * @param is index file stream
+   * @return latest block of each NTBM file and tree
+   */
+  std::vector<Block> ReadBlocks(std::istream &is) const;
+
+  /**
+   * Check the records of a block against their checksum
+   * @param is index file stream
+   * @param block block
+   */
+  void CheckRecords(std::istream &is, const Block &block) const;
+
+  /**
+   * @param block block
+   * @return block header as stored in the index file
+   */
+  static std::string EncodeBlockHeader(const Block &block);
+
+  /**
+   * @param is index file stream
+   * @param records position of the records
+   * @param i record id
+   * @return record
+   */
+  static Record ReadRecord(std::istream &is, std::int64_t records, std::uint64_t i);
+
+  /**
+   * @param block block
+   * @param record record of the block
+   * @return spill location
+   */
+  static NTBMSpillLocation GetLocation(const Block &block, const Record &record);
+
+  std::string path_;
+
+};
+
+#endif
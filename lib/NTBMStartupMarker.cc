@@ -0,0 +1,17 @@
+#include "NTBMStartupMarker.hh"
+
+#include <mutex>
+
+#include <boost/log/trivial.hpp>
+
+namespace {
+
+std::once_flag first_spill_flag;
+
+}
+
+void MarkFirstSpill() {
+  std::call_once(first_spill_flag, []() {
+      BOOST_LOG_TRIVIAL(info) << "First spill processed";
+    });
+}
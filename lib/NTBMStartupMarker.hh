@@ -0,0 +1,11 @@
+#ifndef NTBM_STARTUP_MARKER_HH
+#define NTBM_STARTUP_MARKER_HH
+
+/**
+ * Log the marker of the start up benchmark (submit/script/benchmark_startup.py)
+ * when the first output spill is produced. Only the first call of the process
+ * logs it, so it can be called for every spill and from several threads.
+ */
+void MarkFirstSpill();
+
+#endif
@@ -2,12 +2,153 @@
 #include "NTBMConst.hh"
 
 #include <ostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#include <TTree.h>
+
+namespace {
+
+// Extend the offsets of a flat (CSR) list to number_of_rows rows,
+// new rows are empty and removed rows drop their elements
+void ResizeOffset(std::vector<int> &offset, int number_of_rows) {
+  if ( offset.empty() ) offset.push_back(0);
+  offset.resize(number_of_rows + 1, offset.back());
+}
+
+// Grow/shrink the row ending at end by difference elements
+template < typename T >
+void ResizeRow(std::vector<T> &flat, int end, int difference) {
+  if ( difference > 0 )
+    flat.insert(flat.begin() + end, difference, T());
+  else if ( difference < 0 )
+    flat.erase(flat.begin() + end + difference, flat.begin() + end);
+}
+
+// Move the offsets of the rows following row by difference
+void ShiftOffset(std::vector<int> &offset, int row, int difference) {
+  for ( std::size_t i = row + 1; i < offset.size(); i++ )
+    offset.at(i) += difference;
+}
+
+// Append a row (any list with begin/end) starting at begin to a flat (CSR) list
+template < typename T, typename Row >
+void AppendRow(std::vector<T> &flat, std::size_t begin, const Row &row) {
+  flat.resize(begin);
+  flat.insert(flat.end(), row.begin(), row.end());
+}
+
+// Resize the list to size and set the last element. Resize (not push_back) is
+// used as some members are not cleared by Clear and may be longer than size.
+template < typename T, typename U >
+void SetLastElement(std::vector<T> &list, std::size_t size, const U &value) {
+  list.resize(size);
+  list[size - 1] = value;
+}
+
+}
+
+template < typename T >
+void NTBMSummary::ResizeRows(std::vector<std::vector<T>> &list, std::size_t size) {
+  if ( list.size() == size ) return;
+  std::vector<std::vector<T>> &spare = GetSpareRows(list);
+  while ( list.size() > size ) {
+    list.back().clear();
+    spare.push_back(std::move(list.back()));
+    list.pop_back();
+  }
+  while ( list.size() < size ) {
+    if ( spare.empty() ) {
+      list.emplace_back();
+    } else {
+      list.push_back(std::move(spare.back()));
+      spare.pop_back();
+    }
+  }
+}
+
+template < typename T >
+void NTBMSummary::AssignRows(std::vector<std::vector<T>> &list, const std::vector<std::vector<T>> &source) {
+  ResizeRows(list, source.size());
+  for ( std::size_t i = 0; i < source.size(); i++ )
+    list[i] = source[i];
+}
+
+void NTBMSummary::SetLastRow(std::vector<std::vector<Double32_t>> &list, std::size_t size, const double *value) {
+  ResizeRows(list, size);
+  list[size - 1].assign(value, value + NUMBER_OF_VIEWS);
+}
+
+void NTBMSummary::NinjaCluster::Clear() {
+  baby_mind_track_id = -1;
+  bunch_difference = 0;
+  for ( int view = 0; view < NUMBER_OF_VIEWS; view++ ) {
+    hit_source_cluster[view] = -1;
+    plane[view].clear();
+    slot[view].clear();
+    pe[view].clear();
+    ninja_position[view] = 0.;
+    ninja_tangent[view] = 0.;
+  }
+}
 
 NTBMSummary::NTBMSummary() {
   NTBMSummary::Clear("C");
 }
 
+NTBMSummary &NTBMSummary::operator=(const NTBMSummary &obj) {
+  if ( this == &obj ) return *this;
+  TObject::operator=(obj);
+  entry_in_daily_file_ = obj.entry_in_daily_file_;
+  spill_pot_ = obj.spill_pot_;
+  std::copy(obj.bunch_pot_, obj.bunch_pot_ + NUMBER_OF_BUNCHES, bunch_pot_);
+  bsd_spill_number_ = obj.bsd_spill_number_;
+  timestamp_ = obj.timestamp_;
+  bsd_good_spill_flag_ = obj.bsd_good_spill_flag_;
+  wagasci_good_spill_flag_ = obj.wagasci_good_spill_flag_;
+  std::copy(obj.detector_flags_, obj.detector_flags_ + 8, detector_flags_);
+  number_of_tracks_ = obj.number_of_tracks_;
+  ninja_track_type_ = obj.ninja_track_type_;
+  momentum_type_ = obj.momentum_type_;
+  momentum_ = obj.momentum_;
+  momentum_error_ = obj.momentum_error_;
+  AssignRows(baby_mind_position_, obj.baby_mind_position_);
+  AssignRows(baby_mind_position_error_, obj.baby_mind_position_error_);
+  AssignRows(baby_mind_tangent_, obj.baby_mind_tangent_);
+  AssignRows(baby_mind_tangent_error_, obj.baby_mind_tangent_error_);
+  baby_mind_maximum_plane_ = obj.baby_mind_maximum_plane_;
+  track_length_total_ = obj.track_length_total_;
+  charge_ = obj.charge_;
+  direction_ = obj.direction_;
+  bunch_ = obj.bunch_;
+  number_of_ninja_clusters_ = obj.number_of_ninja_clusters_;
+  baby_mind_track_id_ = obj.baby_mind_track_id_;
+  AssignRows(number_of_hits_, obj.number_of_hits_);
+  AssignRows(hit_offset_, obj.hit_offset_);
+  AssignRows(hit_plane_, obj.hit_plane_);
+  AssignRows(hit_slot_, obj.hit_slot_);
+  AssignRows(hit_pe_, obj.hit_pe_);
+  AssignRows(hit_source_cluster_, obj.hit_source_cluster_);
+  bunch_difference_ = obj.bunch_difference_;
+  AssignRows(ninja_position_, obj.ninja_position_);
+  AssignRows(ninja_position_error_, obj.ninja_position_error_);
+  AssignRows(ninja_tangent_, obj.ninja_tangent_);
+  AssignRows(ninja_tangent_error_, obj.ninja_tangent_error_);
+  ninja_position_fallback_ = obj.ninja_position_fallback_;
+  normalization_ = obj.normalization_;
+  total_cross_section_ = obj.total_cross_section_;
+  number_of_true_particles_ = obj.number_of_true_particles_;
+  AssignRows(true_particle_id_, obj.true_particle_id_);
+  true_particle_offset_ = obj.true_particle_offset_;
+  AssignRows(true_particle_position_, obj.true_particle_position_);
+  AssignRows(true_particle_tangent_, obj.true_particle_tangent_);
+  return *this;
+}
+
 void NTBMSummary::Clear(Option_t *option) {
+  // "R" : keep the inner lists as spare rows
+  const bool keep_rows = option != nullptr && std::strchr(option, 'R') != nullptr;
   entry_in_daily_file_ = -1;
   spill_pot_ = -1.;
   for ( double &i : bunch_pot_ )
@@ -22,27 +163,47 @@ void NTBMSummary::Clear(Option_t *option) {
   ninja_track_type_.clear();
   momentum_type_.clear();
   momentum_.clear();
-  baby_mind_position_.clear();
-  baby_mind_tangent_.clear();
   baby_mind_maximum_plane_.clear();
   charge_.clear();
   direction_.clear();
   bunch_.clear();
   number_of_ninja_clusters_ = 0;
   baby_mind_track_id_.clear();
-  number_of_hits_.clear();
-  plane_.clear();
-  slot_.clear();
-  pe_.clear();
   bunch_difference_.clear();
-  ninja_position_.clear();
-  ninja_tangent_.clear();
+  ninja_position_fallback_.clear();
   normalization_ = 1.;
   total_cross_section_ = 1.;
   number_of_true_particles_.clear();
-  true_particle_id_.clear();
-  true_position_.clear();
-  true_tangent_.clear();
+  true_particle_offset_.clear();
+  if ( keep_rows ) {
+    ResizeRows(baby_mind_position_, 0);
+    ResizeRows(baby_mind_tangent_, 0);
+    ResizeRows(number_of_hits_, 0);
+    ResizeRows(hit_offset_, 0);
+    ResizeRows(hit_plane_, 0);
+    ResizeRows(hit_slot_, 0);
+    ResizeRows(hit_pe_, 0);
+    ResizeRows(hit_source_cluster_, 0);
+    ResizeRows(ninja_position_, 0);
+    ResizeRows(ninja_tangent_, 0);
+    ResizeRows(true_particle_id_, 0);
+    ResizeRows(true_particle_position_, 0);
+    ResizeRows(true_particle_tangent_, 0);
+  } else {
+    baby_mind_position_.clear();
+    baby_mind_tangent_.clear();
+    number_of_hits_.clear();
+    hit_offset_.clear();
+    hit_plane_.clear();
+    hit_slot_.clear();
+    hit_pe_.clear();
+    hit_source_cluster_.clear();
+    ninja_position_.clear();
+    ninja_tangent_.clear();
+    true_particle_id_.clear();
+    true_particle_position_.clear();
+    true_particle_tangent_.clear();
+  }
   TObject::Clear(option);
 }
 
@@ -67,13 +228,13 @@ std::ostream &operator<<(std::ostream &os, const NTBMSummary &obj) {
      << "Number of Baby MIND tracks = " << obj.number_of_tracks_ << "\n"
      << "Baby MIND track type (ECC cand. : 0, Sand cand. : 1) = ";
   for (int i = 0; i < obj.number_of_tracks_; i++) {
-    os << i + 1 << " : " << obj.ninja_track_type_.at(i);
+    os << i + 1 << " : " << (int)obj.ninja_track_type_.at(i);
     if(i != obj.number_of_tracks_ - 1) os << ", ";
   }
   os << "\n"
      << "Momentum measurement type (Baby MIND range : 0, curvature : 1) = ";
   for (int i = 0; i < obj.number_of_tracks_; i++) {
-    os << i + 1 << " : " << obj.momentum_type_.at(i);
+    os << i + 1 << " : " << (int)obj.momentum_type_.at(i);
     if(i != obj.number_of_tracks_ - 1) os << ", ";
   }
   os << "\n"
@@ -104,7 +265,7 @@ std::ostream &operator<<(std::ostream &os, const NTBMSummary &obj) {
   os << "\n"
      << "Baby MIND maximum plane = ";
   for (int i = 0; i < obj.number_of_tracks_; i++) {
-    os << i + 1 << " : " << obj.baby_mind_maximum_plane_.at(i);
+    os << i + 1 << " : " << (int)obj.baby_mind_maximum_plane_.at(i);
     if(i != obj.number_of_tracks_ - 1) os << ", ";
   }  
   os << "\n"
@@ -116,19 +277,19 @@ std::ostream &operator<<(std::ostream &os, const NTBMSummary &obj) {
   os << "\n"
      << "Charge = ";
   for (int i = 0; i < obj.number_of_tracks_; i++) {
-    os << i + 1 << " : " << obj.charge_.at(i);
+    os << i + 1 << " : " << (int)obj.charge_.at(i);
     if(i != obj.number_of_tracks_ - 1) os << ", ";
   }
   os << "\n"
      << "Direction = ";
   for (int i = 0; i < obj.number_of_tracks_; i++) {
-    os << i + 1 << " : " << obj.direction_.at(i);
+    os << i + 1 << " : " << (int)obj.direction_.at(i);
     if(i != obj.number_of_tracks_ - 1) os << ", ";
   }
   os << "\n"
      << "Bunch = ";
   for (int i = 0; i < obj.number_of_tracks_; i++) {
-    os << i + 1 << " : " << obj.bunch_.at(i);
+    os << i + 1 << " : " << (int)obj.bunch_.at(i);
     if(i != obj.number_of_tracks_ - 1) os << ", ";
   }
   os << "\n"
@@ -150,12 +311,12 @@ std::ostream &operator<<(std::ostream &os, const NTBMSummary &obj) {
   for (int i = 0; i < obj.number_of_ninja_clusters_; i++) {
     os << i + 1 << " : Y : ( ";
     for (int j = 0; j < obj.number_of_hits_.at(i).at(0); j++) {
-      os << obj.plane_.at(i).at(0).at(j);
+      os << obj.GetPlane(i, 0, j);
       if (j != obj.number_of_hits_.at(i).at(0) - 1) os << ", ";
     }
     os << " ), X : ( ";
     for (int j = 0; j < obj.number_of_hits_.at(i).at(1); j++) {
-      os << obj.plane_.at(i).at(1).at(j);
+      os << obj.GetPlane(i, 1, j);
       if (j != obj.number_of_hits_.at(i).at(1) - 1) os << ", ";
     }
     os << " )\n";
@@ -165,12 +326,12 @@ std::ostream &operator<<(std::ostream &os, const NTBMSummary &obj) {
   for (int i = 0; i < obj.number_of_ninja_clusters_; i++) {
     os << i + 1 << " : Y : ( ";
     for (int j = 0; j < obj.number_of_hits_.at(i).at(0); j++) {
-      os << obj.slot_.at(i).at(0).at(j);
+      os << obj.GetSlot(i, 0, j);
       if (j != obj.number_of_hits_.at(i).at(0) - 1) os << ", ";
     }
     os << " ), X : ( ";
     for (int j = 0; j < obj.number_of_hits_.at(i).at(1); j++) {
-      os << obj.slot_.at(i).at(1).at(j);
+      os << obj.GetSlot(i, 1, j);
       if (j != obj.number_of_hits_.at(i).at(1) - 1) os << ", ";
     }
     os << " )\n";   
@@ -180,12 +341,12 @@ std::ostream &operator<<(std::ostream &os, const NTBMSummary &obj) {
   for (int i = 0; i < obj.number_of_ninja_clusters_; i++) {
     os << i + 1 << " : Y : ( ";
     for (int j = 0; j < obj.number_of_hits_.at(i).at(0); j++) {
-      os << obj.pe_.at(i).at(0).at(j);
+      os << obj.GetPe(i, 0, j);
       if (j != obj.number_of_hits_.at(i).at(0) - 1) os << ", ";
     }
     os << " ), X : ( ";
     for (int j = 0; j < obj.number_of_hits_.at(i).at(1); j++) {
-      os << obj.pe_.at(i).at(1).at(j);
+      os << obj.GetPe(i, 1, j);
       if (j != obj.number_of_hits_.at(i).at(1) - 1) os << ", ";
     }
     os << " )\n";
@@ -193,7 +354,7 @@ std::ostream &operator<<(std::ostream &os, const NTBMSummary &obj) {
   os << "\n"
      << "Bunch difference from the first matched bunch = ";
   for (int i = 0; i < obj.number_of_ninja_clusters_; i++) {
-    os << i + 1 << " : " << obj.bunch_difference_.at(i);
+    os << i + 1 << " : " << (int)obj.bunch_difference_.at(i);
     if (i != obj.number_of_ninja_clusters_ - 1) os << ", ";
   }
   os << "\n"
@@ -214,6 +375,19 @@ std::ostream &operator<<(std::ostream &os, const NTBMSummary &obj) {
        << obj.ninja_tangent_.at(i).at(1) << " +/- "
        << obj.ninja_tangent_error_.at(i).at(1) << " )\n";
   }
+  os << "\n"
+     << "NINJA tracker position fallback (bar average : 1) = ";
+  for (int i = 0; i < obj.number_of_ninja_clusters_; i++) {
+    os << i + 1 << " : " << (int)obj.ninja_position_fallback_.at(i);
+    if (i != obj.number_of_ninja_clusters_ - 1) os << ", ";
+  }
+  os << "\n"
+     << "Hit source 1d cluster (own hits : -1) = ";
+  for (int i = 0; i < obj.number_of_ninja_clusters_; i++) {
+    os << i + 1 << " : ( "
+       << obj.GetHitSourceCluster(i, 0) << ", "
+       << obj.GetHitSourceCluster(i, 1) << " )\n";
+  }
   os << "\n"
      << "Normalization factor = " << obj.normalization_ << "\n"
      << "Total cross section = " << obj.total_cross_section_ << "\n";
@@ -238,8 +412,8 @@ std::ostream &operator<<(std::ostream &os, const NTBMSummary &obj) {
     os << i + 1 << " : ";
       for (int j = 0; j < obj.number_of_true_particles_.at(i); j++) {
 	os << j + 1 << " : ( "
-	   << obj.true_position_.at(i).at(j).at(0) << ", "
-	   << obj.true_position_.at(i).at(j).at(1) << ")\n";	
+	   << obj.GetTruePosition(i, j, 0) << ", "
+	   << obj.GetTruePosition(i, j, 1) << ")\n";	
       }
   }
   os << "True tangent = ";
@@ -247,8 +421,8 @@ std::ostream &operator<<(std::ostream &os, const NTBMSummary &obj) {
     os << i + 1 << " : ";
       for (int j = 0; j < obj.number_of_true_particles_.at(i); j++) {
 	os << j + 1 << " : ( "
-	   << obj.true_tangent_.at(i).at(j).at(0) << ", "
-	   << obj.true_tangent_.at(i).at(j).at(1) << ")\n";	
+	   << obj.GetTrueTangent(i, j, 0) << ", "
+	   << obj.GetTrueTangent(i, j, 1) << ")\n";	
       }
   }
   
@@ -336,10 +510,10 @@ void NTBMSummary::SetNumberOfTracks(int number_of_tracks) {
   momentum_type_.resize(number_of_tracks_);
   momentum_.resize(number_of_tracks_);
   momentum_error_.resize(number_of_tracks_);
-  baby_mind_position_.resize(number_of_tracks_);
-  baby_mind_position_error_.resize(number_of_tracks_);
-  baby_mind_tangent_.resize(number_of_tracks_);
-  baby_mind_tangent_error_.resize(number_of_tracks_);
+  ResizeRows(baby_mind_position_, number_of_tracks_);
+  ResizeRows(baby_mind_position_error_, number_of_tracks_);
+  ResizeRows(baby_mind_tangent_, number_of_tracks_);
+  ResizeRows(baby_mind_tangent_error_, number_of_tracks_);
   for(int i = 0; i < number_of_tracks_; i++) {
     baby_mind_position_.at(i).resize(2);
     baby_mind_position_error_.at(i).resize(2);
@@ -357,6 +531,25 @@ int NTBMSummary::GetNumberOfTracks() const {
   return number_of_tracks_;
 }
 
+int NTBMSummary::AddBabyMindTrack(const BabyMindTrack &track) {
+  const int itrack = number_of_tracks_++;
+  const std::size_t size = number_of_tracks_;
+  SetLastElement(ninja_track_type_, size, track.ninja_track_type);
+  SetLastElement(momentum_type_, size, track.momentum_type);
+  SetLastElement(momentum_, size, track.momentum);
+  SetLastElement(momentum_error_, size, track.momentum_error);
+  SetLastRow(baby_mind_position_, size, track.baby_mind_position);
+  SetLastRow(baby_mind_position_error_, size, track.baby_mind_position_error);
+  SetLastRow(baby_mind_tangent_, size, track.baby_mind_tangent);
+  SetLastRow(baby_mind_tangent_error_, size, track.baby_mind_tangent_error);
+  SetLastElement(baby_mind_maximum_plane_, size, track.baby_mind_maximum_plane);
+  SetLastElement(track_length_total_, size, track.track_length_total);
+  SetLastElement(charge_, size, track.charge);
+  SetLastElement(direction_, size, track.direction);
+  SetLastElement(bunch_, size, track.bunch);
+  return itrack;
+}
+
 void NTBMSummary::SetNinjaTrackType(int track, int ninja_track_type) {
   ninja_track_type_.at(track) = ninja_track_type;
 }
@@ -408,7 +601,7 @@ void NTBMSummary::SetBabyMindPosition(int track, std::vector<double> baby_mind_p
     SetBabyMindPosition(track, view, baby_mind_position.at(view));
 }
 
-std::vector<double> NTBMSummary::GetBabyMindPosition(int track) const {
+const std::vector<double> &NTBMSummary::GetBabyMindPosition(int track) const {
   if (track >= number_of_tracks_)
     throw std::out_of_range("Number of track out of range");
   return baby_mind_position_.at(track);
@@ -431,7 +624,7 @@ void NTBMSummary::SetBabyMindPositionError(int track, std::vector<double> baby_m
     SetBabyMindPositionError(track, view, baby_mind_position_error.at(view));
 }
 
-std::vector<double> NTBMSummary::GetBabyMindPositionError(int track) const {
+const std::vector<double> &NTBMSummary::GetBabyMindPositionError(int track) const {
   if (track >= number_of_tracks_)
     throw std::out_of_range("Number of track out of range");
   return baby_mind_position_error_.at(track);
@@ -454,7 +647,7 @@ void NTBMSummary::SetBabyMindTangent(int track, std::vector<double> baby_mind_ta
     SetBabyMindTangent(track, view, baby_mind_tangent.at(view));
 }
 
-std::vector<double> NTBMSummary::GetBabyMindTangent(int track) const {
+const std::vector<double> &NTBMSummary::GetBabyMindTangent(int track) const {
   if (track >= number_of_tracks_)
     throw std::out_of_range("Number of track out of range");
   return baby_mind_tangent_.at(track);
@@ -477,7 +670,7 @@ void NTBMSummary::SetBabyMindTangentError(int track, std::vector<double> baby_mi
     SetBabyMindTangentError(track, view, baby_mind_tangent_error.at(view));
 }
 
-std::vector<double> NTBMSummary::GetBabyMindTangentError(int track) const {
+const std::vector<double> &NTBMSummary::GetBabyMindTangentError(int track) const {
   if (track >= number_of_tracks_)
     throw std::out_of_range("Number of track out of range");
   return baby_mind_tangent_error_.at(track);
@@ -544,24 +737,36 @@ void NTBMSummary::SetNumberOfNinjaClusters(int number_of_ninja_clusters) {
   // Always set number of clusters before set other elements
   // related to NINJA cluster
   baby_mind_track_id_.resize(number_of_ninja_clusters_);
-  number_of_hits_.resize(number_of_ninja_clusters_);
-  plane_.resize(number_of_ninja_clusters_);
-  slot_.resize(number_of_ninja_clusters_);
-  pe_.resize(number_of_ninja_clusters_);
+  ResizeRows(number_of_hits_, number_of_ninja_clusters_);
+  ResizeRows(hit_offset_, NUMBER_OF_VIEWS);
+  ResizeRows(hit_plane_, NUMBER_OF_VIEWS);
+  ResizeRows(hit_slot_, NUMBER_OF_VIEWS);
+  ResizeRows(hit_pe_, NUMBER_OF_VIEWS);
+  ResizeRows(hit_source_cluster_, NUMBER_OF_VIEWS);
+  for (int view = 0; view < NUMBER_OF_VIEWS; view++) {
+    ResizeOffset(hit_offset_.at(view), number_of_ninja_clusters_);
+    hit_plane_.at(view).resize(hit_offset_.at(view).back());
+    hit_slot_.at(view).resize(hit_offset_.at(view).back());
+    hit_pe_.at(view).resize(hit_offset_.at(view).back());
+    hit_source_cluster_.at(view).resize(number_of_ninja_clusters_, -1);
+  }
   bunch_difference_.resize(number_of_ninja_clusters_);
-  ninja_position_.resize(number_of_ninja_clusters_);
-  ninja_position_error_.resize(number_of_ninja_clusters_);
-  ninja_tangent_.resize(number_of_ninja_clusters);
-  ninja_tangent_error_.resize(number_of_ninja_clusters_);
+  ResizeRows(ninja_position_, number_of_ninja_clusters_);
+  ResizeRows(ninja_position_error_, number_of_ninja_clusters_);
+  ResizeRows(ninja_tangent_, number_of_ninja_clusters);
+  ResizeRows(ninja_tangent_error_, number_of_ninja_clusters_);
+  ninja_position_fallback_.resize(number_of_ninja_clusters_);
   number_of_true_particles_.resize(number_of_ninja_clusters_);
-  true_particle_id_.resize(number_of_ninja_clusters_);
-  true_position_.resize(number_of_ninja_clusters_);
-  true_tangent_.resize(number_of_ninja_clusters_);
+  ResizeRows(true_particle_id_, number_of_ninja_clusters_);
+  ResizeOffset(true_particle_offset_, number_of_ninja_clusters_);
+  ResizeRows(true_particle_position_, NUMBER_OF_VIEWS);
+  ResizeRows(true_particle_tangent_, NUMBER_OF_VIEWS);
+  for (int view = 0; view < NUMBER_OF_VIEWS; view++) {
+    true_particle_position_.at(view).resize(true_particle_offset_.back());
+    true_particle_tangent_.at(view).resize(true_particle_offset_.back());
+  }
   for(int i = 0; i < number_of_ninja_clusters_; i++) {
     number_of_hits_.at(i).resize(2);
-    plane_.at(i).resize(2);
-    slot_.at(i).resize(2);
-    pe_.at(i).resize(2);
     ninja_position_.at(i).resize(2);
     ninja_position_error_.at(i).resize(2);
     ninja_tangent_.at(i).resize(2);
@@ -573,6 +778,75 @@ int NTBMSummary::GetNumberOfNinjaClusters() const {
   return number_of_ninja_clusters_;
 }
 
+int NTBMSummary::AddNinjaCluster(const NinjaCluster &cluster) {
+  for (int view = 0; view < NUMBER_OF_VIEWS; view++) {
+    if (cluster.hit_source_cluster[view] >= number_of_ninja_clusters_)
+      throw std::out_of_range("Hit source cluster out of range");
+    if (cluster.hit_source_cluster[view] >= 0 && !cluster.plane[view].empty())
+      throw std::invalid_argument("Cluster with both own hits and a hit source cluster");
+    if (cluster.slot[view].size() != cluster.plane[view].size() ||
+	cluster.pe[view].size() != cluster.plane[view].size())
+      throw std::invalid_argument("Number of hits differs between plane, slot and pe lists");
+    for (int plane : cluster.plane[view])
+      if (plane < 0 || plane >= NUMBER_OF_PLANES)
+	throw std::out_of_range("Plane out of range");
+    for (int slot : cluster.slot[view])
+      if (slot < 0 || slot >= NUMBER_OF_SLOTS_IN_PLANE)
+	throw std::out_of_range("Slot out of range");
+  }
+  return AddNinjaClusterUnchecked(cluster);
+}
+
+int NTBMSummary::AddNinjaClusterUnchecked(const NinjaCluster &cluster) {
+  const int icluster = number_of_ninja_clusters_++;
+  const std::size_t size = number_of_ninja_clusters_;
+  SetLastElement(baby_mind_track_id_, size, cluster.baby_mind_track_id);
+  ResizeRows(number_of_hits_, size);
+  number_of_hits_[icluster].resize(NUMBER_OF_VIEWS);
+  ResizeRows(hit_offset_, NUMBER_OF_VIEWS);
+  ResizeRows(hit_plane_, NUMBER_OF_VIEWS);
+  ResizeRows(hit_slot_, NUMBER_OF_VIEWS);
+  ResizeRows(hit_pe_, NUMBER_OF_VIEWS);
+  ResizeRows(hit_source_cluster_, NUMBER_OF_VIEWS);
+  for (int view = 0; view < NUMBER_OF_VIEWS; view++) {
+    std::vector<int> &offset = hit_offset_[view];
+    ResizeOffset(offset, icluster);
+    // shared hits : the own row stays empty and the reference is resolved
+    // to the cluster really holding the hits (no chain of references)
+    int source = cluster.hit_source_cluster[view];
+    if (source >= 0) {
+      if (hit_source_cluster_[view][source] >= 0)
+	source = hit_source_cluster_[view][source];
+      number_of_hits_[icluster][view] = offset[source + 1] - offset[source];
+    } else {
+      AppendRow(hit_plane_[view], offset.back(), cluster.plane[view]);
+      AppendRow(hit_slot_[view], offset.back(), cluster.slot[view]);
+      AppendRow(hit_pe_[view], offset.back(), cluster.pe[view]);
+      number_of_hits_[icluster][view] = cluster.plane[view].size();
+    }
+    SetLastElement(hit_source_cluster_[view], size, source);
+    offset.push_back(hit_plane_[view].size());
+  }
+  SetLastElement(bunch_difference_, size, cluster.bunch_difference);
+  SetLastRow(ninja_position_, size, cluster.ninja_position);
+  ResizeRows(ninja_position_error_, size);
+  ninja_position_error_[icluster].resize(NUMBER_OF_VIEWS);
+  SetLastRow(ninja_tangent_, size, cluster.ninja_tangent);
+  ResizeRows(ninja_tangent_error_, size);
+  ninja_tangent_error_[icluster].resize(NUMBER_OF_VIEWS);
+  ninja_position_fallback_.resize(size);
+  number_of_true_particles_.resize(size);
+  ResizeRows(true_particle_id_, size);
+  ResizeOffset(true_particle_offset_, size);
+  ResizeRows(true_particle_position_, NUMBER_OF_VIEWS);
+  ResizeRows(true_particle_tangent_, NUMBER_OF_VIEWS);
+  for (int view = 0; view < NUMBER_OF_VIEWS; view++) {
+    true_particle_position_[view].resize(true_particle_offset_.back());
+    true_particle_tangent_[view].resize(true_particle_offset_.back());
+  }
+  return icluster;
+}
+
 void NTBMSummary::SetBabyMindTrackId(int cluster, int baby_mind_track_id) {
   baby_mind_track_id_.at(cluster) = baby_mind_track_id;
 }
@@ -586,12 +860,16 @@ int NTBMSummary::GetBabyMindTrackId(int cluster) const {
 void NTBMSummary::SetNumberOfHits(int cluster, int view, int number_of_hits) {
   if (view >= NUMBER_OF_VIEWS)
     throw std::out_of_range("View out of range");
+  DetachHits(cluster, view);
+  const int difference = number_of_hits - number_of_hits_.at(cluster).at(view);
   number_of_hits_.at(cluster).at(view) = number_of_hits;
   // Always set number of hits before set other elements
   // related to NINJA tracker hits
-  plane_.at(cluster).at(view).resize(number_of_hits_.at(cluster).at(view));
-  slot_.at(cluster).at(view).resize(number_of_hits_.at(cluster).at(view));
-  pe_.at(cluster).at(view).resize(number_of_hits_.at(cluster).at(view));
+  const int end = hit_offset_.at(view).at(cluster + 1);
+  ResizeRow(hit_plane_.at(view), end, difference);
+  ResizeRow(hit_slot_.at(view), end, difference);
+  ResizeRow(hit_pe_.at(view), end, difference);
+  ShiftOffset(hit_offset_.at(view), cluster, difference);
 }
 
 void NTBMSummary::SetNumberOfHits(int cluster, std::vector<int> number_of_hits) {
@@ -599,7 +877,7 @@ void NTBMSummary::SetNumberOfHits(int cluster, std::vector<int> number_of_hits)
     SetNumberOfHits(cluster, view, number_of_hits.at(view));
 }
 
-std::vector<int> NTBMSummary::GetNumberOfHits(int cluster) const {
+const std::vector<int> &NTBMSummary::GetNumberOfHits(int cluster) const {
   if (cluster >= number_of_ninja_clusters_)
     throw std::out_of_range("Number of cluster out of range");
   return number_of_hits_.at(cluster);
@@ -614,9 +892,10 @@ int NTBMSummary::GetNumberOfHits(int cluster, int view) const {
 void NTBMSummary::SetPlane(int cluster, int view, int hit, int plane) {
   if(view >= NUMBER_OF_VIEWS)
     throw std::out_of_range("View out of range");
-  if (plane >= NUMBER_OF_PLANES)
+  if (plane < 0 || plane >= NUMBER_OF_PLANES)
     throw std::out_of_range("Plane out of range");
-  plane_.at(cluster).at(view).at(hit) = plane;
+  DetachHits(cluster, view);
+  hit_plane_.at(view).at(GetHitIndex(cluster, view, hit)) = plane;
 }
 
 void NTBMSummary::SetPlane(int cluster, int view, std::vector<int> plane) {
@@ -630,29 +909,41 @@ void NTBMSummary::SetPlane(int cluster, std::vector<std::vector<int>> plane) {
 }
 
 std::vector<std::vector<int>> NTBMSummary::GetPlane(int cluster) const {
-  if (cluster >= number_of_ninja_clusters_)
-    throw std::out_of_range("Number of cluster out of range");
-  return plane_.at(cluster);
+  std::vector<std::vector<int>> plane;
+  for (int view = 0; view < NUMBER_OF_VIEWS; view++)
+    plane.push_back(GetPlane(cluster, view));
+  return plane;
 }
 
 std::vector<int> NTBMSummary::GetPlane(int cluster, int view) const {
   if (view >= NUMBER_OF_VIEWS)
     throw std::out_of_range("View our of range");
-  return GetPlane(cluster).at(view);
+  const NTBMArrayView<UChar_t> plane = GetPlaneView(cluster, view);
+  return std::vector<int>(plane.begin(), plane.end());
 }
 
 int NTBMSummary::GetPlane(int cluster, int view, int hit) const {
-  if (hit >= number_of_hits_.at(cluster).at(view))
-    throw std::out_of_range("Number of hit out of range");
-  return GetPlane(cluster, view).at(hit);
+  return hit_plane_.at(view).at(GetHitIndex(cluster, view, hit));
+}
+
+NTBMArrayView<UChar_t> NTBMSummary::GetPlaneView(int cluster, int view) const {
+  if (view >= NUMBER_OF_VIEWS)
+    throw std::out_of_range("View out of range");
+  if (cluster >= number_of_ninja_clusters_)
+    throw std::out_of_range("Number of cluster out of range");
+  const int row = GetHitRow(cluster, view);
+  const int begin = hit_offset_.at(view).at(row);
+  return NTBMArrayView<UChar_t>(hit_plane_.at(view).data() + begin,
+				 hit_offset_.at(view).at(row + 1) - begin);
 }
 
 void NTBMSummary::SetSlot(int cluster, int view, int hit, int slot) {
   if(view >= NUMBER_OF_VIEWS)
     throw std::out_of_range("View out of range");
-  if(slot >= NUMBER_OF_SLOTS_IN_PLANE)
+  if(slot < 0 || slot >= NUMBER_OF_SLOTS_IN_PLANE)
     throw std::out_of_range("Slot out of range");
-  slot_.at(cluster).at(view).at(hit) = slot;
+  DetachHits(cluster, view);
+  hit_slot_.at(view).at(GetHitIndex(cluster, view, hit)) = slot;
 }
 
 void NTBMSummary::SetSlot(int cluster, int view, std::vector<int> slot) {
@@ -666,27 +957,39 @@ void NTBMSummary::SetSlot(int cluster, std::vector<std::vector<int>> slot) {
 }
 
 std::vector<std::vector<int>> NTBMSummary::GetSlot(int cluster) const {
-  if (cluster >= number_of_ninja_clusters_)
-    throw std::out_of_range("Number of cluster out of range");
-  return slot_.at(cluster);
+  std::vector<std::vector<int>> slot;
+  for (int view = 0; view < NUMBER_OF_VIEWS; view++)
+    slot.push_back(GetSlot(cluster, view));
+  return slot;
 }
 
 std::vector<int> NTBMSummary::GetSlot(int cluster, int view) const {
   if (view >= NUMBER_OF_VIEWS)
     throw std::out_of_range("View out of range");
-  return GetSlot(cluster).at(view);
+  const NTBMArrayView<UChar_t> slot = GetSlotView(cluster, view);
+  return std::vector<int>(slot.begin(), slot.end());
 }
 
 int NTBMSummary::GetSlot(int cluster, int view, int hit) const {
-  if (hit >= number_of_hits_.at(cluster).at(view))
-    throw std::out_of_range("Number of hit out of range");
-  return GetSlot(cluster, view).at(hit);
+  return hit_slot_.at(view).at(GetHitIndex(cluster, view, hit));
+}
+
+NTBMArrayView<UChar_t> NTBMSummary::GetSlotView(int cluster, int view) const {
+  if (view >= NUMBER_OF_VIEWS)
+    throw std::out_of_range("View out of range");
+  if (cluster >= number_of_ninja_clusters_)
+    throw std::out_of_range("Number of cluster out of range");
+  const int row = GetHitRow(cluster, view);
+  const int begin = hit_offset_.at(view).at(row);
+  return NTBMArrayView<UChar_t>(hit_slot_.at(view).data() + begin,
+				 hit_offset_.at(view).at(row + 1) - begin);
 }
 
 void NTBMSummary::SetPe(int cluster, int view, int hit, double pe) {
   if(view >= NUMBER_OF_VIEWS)
     throw std::out_of_range("View out of range");
-  pe_.at(cluster).at(view).at(hit) = pe;
+  DetachHits(cluster, view);
+  hit_pe_.at(view).at(GetHitIndex(cluster, view, hit)) = pe;
 }
 
 void NTBMSummary::SetPe(int cluster, int view, std::vector<double> pe) {
@@ -700,21 +1003,31 @@ void NTBMSummary::SetPe(int cluster, std::vector<std::vector<double>> pe) {
 }
 
 std::vector<std::vector<double>> NTBMSummary::GetPe(int cluster) const {
-  if (cluster >= number_of_ninja_clusters_)
-    throw std::out_of_range("Number of cluster out of range");
-  return pe_.at(cluster);
+  std::vector<std::vector<double>> pe;
+  for (int view = 0; view < NUMBER_OF_VIEWS; view++)
+    pe.push_back(GetPe(cluster, view));
+  return pe;
 }
 
 std::vector<double> NTBMSummary::GetPe(int cluster, int view) const {
   if (view >= NUMBER_OF_VIEWS)
     throw std::out_of_range("View our of range");
-  return GetPe(cluster).at(view);
+  return GetPeView(cluster, view).ToVector();
 }
 
 double NTBMSummary::GetPe(int cluster, int view, int hit) const {
-  if (hit >= number_of_hits_.at(cluster).at(view))
-    throw std::out_of_range("Number of hit out of range");
-  return GetPe(cluster, view).at(hit);
+  return hit_pe_.at(view).at(GetHitIndex(cluster, view, hit));
+}
+
+NTBMArrayView<double> NTBMSummary::GetPeView(int cluster, int view) const {
+  if (view >= NUMBER_OF_VIEWS)
+    throw std::out_of_range("View out of range");
+  if (cluster >= number_of_ninja_clusters_)
+    throw std::out_of_range("Number of cluster out of range");
+  const int row = GetHitRow(cluster, view);
+  const int begin = hit_offset_.at(view).at(row);
+  return NTBMArrayView<double>(hit_pe_.at(view).data() + begin,
+			   hit_offset_.at(view).at(row + 1) - begin);
 }
 
 void NTBMSummary::SetBunchDifference(int cluster, int bunch_difference) {
@@ -738,7 +1051,7 @@ void NTBMSummary::SetNinjaPosition(int cluster, std::vector<double> ninja_positi
     SetNinjaPosition(cluster, view, ninja_position.at(view));
 }
 
-std::vector<double> NTBMSummary::GetNinjaPosition(int cluster) const {
+const std::vector<double> &NTBMSummary::GetNinjaPosition(int cluster) const {
   if (cluster >= number_of_ninja_clusters_)
     throw std::out_of_range("Number of cluster out of range");
   return ninja_position_.at(cluster);
@@ -761,7 +1074,7 @@ void NTBMSummary::SetNinjaPositionError(int cluster, std::vector<double> ninja_p
     SetNinjaPositionError(cluster, view, ninja_position_error.at(view));
 }
 
-std::vector<double> NTBMSummary::GetNinjaPositionError(int cluster) const {
+const std::vector<double> &NTBMSummary::GetNinjaPositionError(int cluster) const {
   if (cluster >= number_of_ninja_clusters_)
     throw std::out_of_range("Number of cluster out of range");
   return ninja_position_error_.at(cluster);
@@ -784,7 +1097,7 @@ void NTBMSummary::SetNinjaTangent(int cluster, std::vector<double> ninja_tangent
     SetNinjaTangent(cluster, view, ninja_tangent.at(view));
 }
 
-std::vector<double> NTBMSummary::GetNinjaTangent(int cluster) const {
+const std::vector<double> &NTBMSummary::GetNinjaTangent(int cluster) const {
   if (cluster >= number_of_ninja_clusters_)
     throw std::out_of_range("Number of cluster out of range");
   return ninja_tangent_.at(cluster);
@@ -807,7 +1120,7 @@ void NTBMSummary::SetNinjaTangentError(int cluster, std::vector<double> ninja_ta
     SetNinjaTangentError(cluster, view, ninja_tangent_error.at(view));
 }
 
-std::vector<double> NTBMSummary::GetNinjaTangentError(int cluster) const {
+const std::vector<double> &NTBMSummary::GetNinjaTangentError(int cluster) const {
   if (cluster >= number_of_ninja_clusters_)
     throw std::out_of_range("Number of cluster out of range");
   return ninja_tangent_error_.at(cluster);
@@ -819,15 +1132,27 @@ double NTBMSummary::GetNinjaTangentError(int cluster, int view) const {
   return GetNinjaTangentError(cluster).at(view);
 }
 
+void NTBMSummary::SetNinjaPositionFallback(int cluster, int ninja_position_fallback) {
+  ninja_position_fallback_.at(cluster) = ninja_position_fallback;
+}
+
+int NTBMSummary::GetNinjaPositionFallback(int cluster) const {
+  if (cluster >= number_of_ninja_clusters_)
+    throw std::out_of_range("Number of cluster out of range");
+  return ninja_position_fallback_.at(cluster);
+}
+
 void NTBMSummary::SetNumberOfTrueParticles(int cluster, int number_of_true_particles) {
   number_of_true_particles_.at(cluster) = number_of_true_particles;
   true_particle_id_.at(cluster).resize(number_of_true_particles_.at(cluster));
-  true_position_.at(cluster).resize(number_of_true_particles_.at(cluster));
-  true_tangent_.at(cluster).resize(number_of_true_particles_.at(cluster));
-  for ( int iparticle = 0; iparticle < number_of_true_particles_.at(cluster); iparticle++ ) {
-    true_position_.at(cluster).at(iparticle).resize(2);
-    true_tangent_.at(cluster).at(iparticle).resize(2);
+  const int difference = number_of_true_particles
+    - (true_particle_offset_.at(cluster + 1) - true_particle_offset_.at(cluster));
+  const int end = true_particle_offset_.at(cluster + 1);
+  for ( int view = 0; view < NUMBER_OF_VIEWS; view++ ) {
+    ResizeRow(true_particle_position_.at(view), end, difference);
+    ResizeRow(true_particle_tangent_.at(view), end, difference);
   }
+  ShiftOffset(true_particle_offset_, cluster, difference);
 }
 
 int NTBMSummary::GetNumberOfTrueParticles(int cluster) const {
@@ -845,7 +1170,7 @@ void NTBMSummary::SetTrueParticleId(int cluster, std::vector<int> true_particle_
     SetTrueParticleId(cluster, particle, true_particle_id.at(particle));
 }
 
-std::vector<int> NTBMSummary::GetTrueParticleId(int cluster) const {
+const std::vector<int> &NTBMSummary::GetTrueParticleId(int cluster) const {
   return true_particle_id_.at(cluster);
 }
 
@@ -872,7 +1197,7 @@ double NTBMSummary::GetTotalCrossSection() const {
 void NTBMSummary::SetTruePosition(int cluster, int particle, int view, double true_position) {
   if (view >= NUMBER_OF_VIEWS)
     throw std::out_of_range("View out of range");
-  true_position_.at(cluster).at(particle).at(view) = true_position;
+  true_particle_position_.at(view).at(GetTrueParticleIndex(cluster, particle)) = true_position;
 }
 
 void NTBMSummary::SetTruePosition(int cluster, int particle, std::vector<double> true_position) {
@@ -888,25 +1213,30 @@ void NTBMSummary::SetTruePosition(int cluster, std::vector<std::vector<double>>
 std::vector<std::vector<double>> NTBMSummary::GetTruePosition(int cluster) const {
   if (cluster >= number_of_ninja_clusters_)
     throw std::out_of_range("Number of cluster out of range");
-  return true_position_.at(cluster);
+  std::vector<std::vector<double>> true_position;
+  for (int particle = 0; particle < number_of_true_particles_.at(cluster); particle++)
+    true_position.push_back(GetTruePosition(cluster, particle));
+  return true_position;
 }
 
 std::vector<double> NTBMSummary::GetTruePosition(int cluster, int particle) const {
-  if (particle >= number_of_true_particles_.at(cluster))
-    throw std::out_of_range("Number of true particles our of range");
-  return GetTruePosition(cluster).at(particle);
+  const std::size_t index = GetTrueParticleIndex(cluster, particle);
+  std::vector<double> true_position(NUMBER_OF_VIEWS);
+  for (int view = 0; view < NUMBER_OF_VIEWS; view++)
+    true_position.at(view) = true_particle_position_.at(view).at(index);
+  return true_position;
 }
 
 double NTBMSummary::GetTruePosition(int cluster, int particle, int view) const {
   if (view >= NUMBER_OF_VIEWS)
     throw std::out_of_range("View out of range");
-  return GetTruePosition(cluster, particle).at(view);
+  return true_particle_position_.at(view).at(GetTrueParticleIndex(cluster, particle));
 }
 
 void NTBMSummary::SetTrueTangent(int cluster, int particle, int view, double true_tangent) {
   if (view >= NUMBER_OF_VIEWS)
     throw std::out_of_range("View ourt of range");
-  true_tangent_.at(cluster).at(particle).at(view) = true_tangent;
+  true_particle_tangent_.at(view).at(GetTrueParticleIndex(cluster, particle)) = true_tangent;
 }
 
 void NTBMSummary::SetTrueTangent(int cluster, int particle, std::vector<double> true_tangent) {
@@ -922,19 +1252,132 @@ void NTBMSummary::SetTrueTangent(int cluster, std::vector<std::vector<double>> t
 std::vector<std::vector<double>> NTBMSummary::GetTrueTangent(int cluster) const {
   if (cluster >= number_of_ninja_clusters_)
     throw std::out_of_range("Number of cluster out of range");
-  return true_tangent_.at(cluster);
+  std::vector<std::vector<double>> true_tangent;
+  for (int particle = 0; particle < number_of_true_particles_.at(cluster); particle++)
+    true_tangent.push_back(GetTrueTangent(cluster, particle));
+  return true_tangent;
 }
 
 std::vector<double> NTBMSummary::GetTrueTangent(int cluster, int particle) const {
-  if (particle >= number_of_true_particles_.at(cluster))
-    throw std::out_of_range("Number of true particles out of range");
-  return GetTrueTangent(cluster).at(particle);
+  const std::size_t index = GetTrueParticleIndex(cluster, particle);
+  std::vector<double> true_tangent(NUMBER_OF_VIEWS);
+  for (int view = 0; view < NUMBER_OF_VIEWS; view++)
+    true_tangent.at(view) = true_particle_tangent_.at(view).at(index);
+  return true_tangent;
 }
 
 double NTBMSummary::GetTrueTangent(int cluster, int particle, int view) const {
   if (view >= NUMBER_OF_VIEWS)
     throw std::out_of_range("View out of range");
-  return GetTrueTangent(cluster, particle).at(view);
+  return true_particle_tangent_.at(view).at(GetTrueParticleIndex(cluster, particle));
+}
+
+std::size_t NTBMSummary::GetHitIndex(int cluster, int view, int hit) const {
+  if (view >= NUMBER_OF_VIEWS)
+    throw std::out_of_range("View out of range");
+  if (hit < 0 || hit >= number_of_hits_.at(cluster).at(view))
+    throw std::out_of_range("Number of hit out of range");
+  return hit_offset_.at(view).at(GetHitRow(cluster, view)) + hit;
+}
+
+int NTBMSummary::GetHitSourceCluster(int cluster, int view) const {
+  if (view >= NUMBER_OF_VIEWS)
+    throw std::out_of_range("View out of range");
+  if (cluster >= number_of_ninja_clusters_)
+    throw std::out_of_range("Number of cluster out of range");
+  return hit_source_cluster_.at(view).at(cluster);
+}
+
+int NTBMSummary::GetHitRow(int cluster, int view) const {
+  const int source = hit_source_cluster_.at(view).at(cluster);
+  return source < 0 ? cluster : source;
+}
+
+void NTBMSummary::DetachHits(int cluster, int view) {
+  if (view >= NUMBER_OF_VIEWS)
+    throw std::out_of_range("View out of range");
+  int &source = hit_source_cluster_.at(view).at(cluster);
+  if (source < 0) return;
+  std::vector<int> &offset = hit_offset_.at(view);
+  const int begin = offset.at(source);
+  const int number_of_hits = offset.at(source + 1) - begin;
+  // the own row is empty, the copies are taken before the lists grow
+  const std::vector<UChar_t> plane(hit_plane_.at(view).begin() + begin,
+				   hit_plane_.at(view).begin() + begin + number_of_hits);
+  const std::vector<UChar_t> slot(hit_slot_.at(view).begin() + begin,
+				  hit_slot_.at(view).begin() + begin + number_of_hits);
+  const std::vector<Double32_t> pe(hit_pe_.at(view).begin() + begin,
+			       hit_pe_.at(view).begin() + begin + number_of_hits);
+  const int end = offset.at(cluster + 1);
+  hit_plane_.at(view).insert(hit_plane_.at(view).begin() + end, plane.begin(), plane.end());
+  hit_slot_.at(view).insert(hit_slot_.at(view).begin() + end, slot.begin(), slot.end());
+  hit_pe_.at(view).insert(hit_pe_.at(view).begin() + end, pe.begin(), pe.end());
+  ShiftOffset(offset, cluster, number_of_hits);
+  source = -1;
+}
+
+std::size_t NTBMSummary::GetTrueParticleIndex(int cluster, int particle) const {
+  if (particle < 0 || particle >= number_of_true_particles_.at(cluster))
+    throw std::out_of_range("Number of true particles out of range");
+  return true_particle_offset_.at(cluster) + particle;
+}
+
+void NTBMSummary::FlattenTrueParticleList(const std::vector<std::vector<std::vector<double>>> &nested,
+					  std::vector<int> &offset,
+					  std::vector<std::vector<double>> &flat) {
+  offset.assign(1, 0);
+  flat.assign(NUMBER_OF_VIEWS, std::vector<double>());
+  for ( const auto &cluster : nested ) {
+    for ( const auto &particle : cluster )
+      for ( int view = 0; view < NUMBER_OF_VIEWS; view++ )
+	flat.at(view).push_back((std::size_t)view < particle.size() ? particle.at(view) : 0.);
+    offset.push_back(offset.back() + cluster.size());
+  }
+}
+
+void NTBMSummary::CreateBranch(TTree *tree, NTBMSummary **ntbm) {
+  tree->Branch("NTBMSummary", ntbm, 32000, BRANCH_SPLIT_LEVEL);
+}
+
+/**
+ * @param member member branch name
+ * @return branches of the files before version 13 read by the read rules filling the member
+ * (see NTBMLinkDef.h), empty if the member has the same branch
+ */
+static std::vector<std::string> GetReadRuleSources(const std::string &member) {
+  if ( member == "hit_offset_" || member == "hit_plane_" || member == "hit_slot_" || member == "hit_pe_" )
+    return {"plane_", "slot_", "pe_"};
+  if ( member == "true_particle_offset_" || member == "true_particle_position_" ||
+       member == "true_particle_tangent_" )
+    return {"true_position_", "true_tangent_"};
+  if ( member == "ninja_position_fallback_" || member == "hit_source_cluster_" )
+    return {"number_of_ninja_clusters_"};
+  return {};
+}
+
+void NTBMSummary::SetBranchAddress(TTree *tree, NTBMSummary **ntbm,
+				   const std::vector<std::string> &members) {
+  tree->SetBranchStatus("*", false);
+  for ( const auto &member : members ) {
+    if ( tree->GetBranch(member.c_str()) != nullptr ) {
+      tree->SetBranchStatus(member.c_str(), true);
+      continue;
+    }
+    // older file : the member is filled by a read rule from other branches
+    const std::vector<std::string> sources = GetReadRuleSources(member);
+    bool has_sources = !sources.empty();
+    for ( const auto &source : sources )
+      if ( tree->GetBranch(source.c_str()) == nullptr )
+	has_sources = false;
+    if ( !has_sources ) {
+      // unknown layout (e.g. not split) : all the members are read
+      tree->SetBranchStatus("*", true);
+      break;
+    }
+    for ( const auto &source : sources )
+      tree->SetBranchStatus(source.c_str(), true);
+  }
+  tree->SetBranchAddress("NTBMSummary", ntbm);
 }
 
 ClassImp(NTBMSummary)
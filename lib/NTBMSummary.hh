@@ -5,8 +5,13 @@
 #include <TVector2.h>
 
 #include <vector>
+#include <string>
+#include <map>
+#include <cstdint>
 
 #include "NTBMConst.hh"
+#include "NTBMArrayView.hh"
+#include "NTBMSmallVector.hh"
 
 #ifdef __ROOTCLING__
 #pragma link off globals;
@@ -16,6 +21,8 @@
 #pragma link C++ class NTBMSummary+;
 #endif
 
+class TTree;
+
 /**
  * Class containing info about scintillator detectors for (muon) track matching
  * between Scintillation Tracker/BabyMIND and TSS/Emulsion Shifter/ECC
@@ -25,12 +32,66 @@ class NTBMSummary: public TObject {
 
 public :
 
+  /**
+   * Compact record of one Baby MIND track appended at once by AddBabyMindTrack
+   */
+  struct BabyMindTrack {
+    int ninja_track_type = 0;
+    int momentum_type = 0;
+    double momentum = 0.;
+    double momentum_error = 0.;
+    double baby_mind_position[NUMBER_OF_VIEWS] = {0., 0.};
+    double baby_mind_position_error[NUMBER_OF_VIEWS] = {0., 0.};
+    double baby_mind_tangent[NUMBER_OF_VIEWS] = {0., 0.};
+    double baby_mind_tangent_error[NUMBER_OF_VIEWS] = {0., 0.};
+    int baby_mind_maximum_plane = 0;
+    double track_length_total = 0.;
+    int charge = 0;
+    int direction = 0;
+    int bunch = 0;
+  };
+
+  /**
+   * Compact record of one NINJA tracker cluster appended at once by AddNinjaCluster.
+   * The number of hits in each view is the size of the hit lists, or the number of
+   * hits of the referenced cluster when hit_source_cluster is set for the view.
+   */
+  struct NinjaCluster {
+    ///> hits of one view stored inline without heap allocation (a 1d cluster has a handful of hits)
+    static const std::size_t NUMBER_OF_INLINE_HITS = 8;
+    int baby_mind_track_id = -1;
+    int bunch_difference = 0;
+    ///> cluster whose hits are shared in each view (-1 : hits in the record)
+    int hit_source_cluster[NUMBER_OF_VIEWS] = {-1, -1};
+    NTBMSmallVector<int, NUMBER_OF_INLINE_HITS> plane[NUMBER_OF_VIEWS];
+    NTBMSmallVector<int, NUMBER_OF_INLINE_HITS> slot[NUMBER_OF_VIEWS];
+    NTBMSmallVector<double, NUMBER_OF_INLINE_HITS> pe[NUMBER_OF_VIEWS];
+    double ninja_position[NUMBER_OF_VIEWS] = {0., 0.};
+    double ninja_tangent[NUMBER_OF_VIEWS] = {0., 0.};
+
+    /**
+     * Reset the record to the default values, the hit list capacity is kept
+     * so that one record can be reused for all the clusters of a spill
+     */
+    void Clear();
+  };
+
   NTBMSummary();
 
+  NTBMSummary(const NTBMSummary &obj) = default;
+
+  /**
+   * Copy all the members reusing the lists (and their capacity) of this object
+   * @param obj source object
+   * @return this object
+   */
+  NTBMSummary &operator=(const NTBMSummary &obj);
+
   /**
    * Set the all members to zero
-   * no memory is released.
-   * @param option same as TObject option
+   * @param option same as TObject option, with "R" the inner lists of the nested
+   * members are kept (with their capacity) and reused when the object is filled again.
+   * Otherwise the inner lists are released, only the outer list capacity is kept.
    */
   void Clear(Option_t *option) override;
 
@@ -42,6 +103,9 @@ public :
    */
   friend std::ostream &operator<<(std::ostream &os, const NTBMSummary &obj);
 
+  ///> RNTuple data model binding the members to the fields (NTBMNTuple.cc)
+  friend struct NTBMNTupleModel;
+
   // Setter/Getter
 
   void SetEntryInDailyFile(int entry_in_daily_file);
@@ -78,6 +142,13 @@ public :
 
   void SetNumberOfTracks(int number_of_tracks);
 
+  /**
+   * Append one Baby MIND track (number of tracks is incremented)
+   * @param track track record
+   * @return id of the new track
+   */
+  int AddBabyMindTrack(const BabyMindTrack &track);
+
   int GetNumberOfTracks() const;
 
   void SetNinjaTrackType(int track, int ninja_track_type);
@@ -100,7 +171,7 @@ public :
 
   void SetBabyMindPosition(int track, std::vector<double> baby_mind_position);
 
-  std::vector<double> GetBabyMindPosition(int track) const;
+  const std::vector<double> &GetBabyMindPosition(int track) const;
 
   double GetBabyMindPosition(int track, int view) const;
 
@@ -108,7 +179,7 @@ public :
 
   void SetBabyMindPositionError(int track, std::vector<double> baby_mind_position_error);
 
-  std::vector<double> GetBabyMindPositionError(int track) const;
+  const std::vector<double> &GetBabyMindPositionError(int track) const;
 
   double GetBabyMindPositionError(int track, int view) const;
   
@@ -116,7 +187,7 @@ public :
 
   void SetBabyMindTangent(int track, std::vector<double> baby_mind_tangent);
 
-  std::vector<double> GetBabyMindTangent(int track) const;
+  const std::vector<double> &GetBabyMindTangent(int track) const;
 
   double GetBabyMindTangent(int track, int view) const;
 
@@ -124,7 +195,7 @@ public :
 
   void SetBabyMindTangentError(int track, std::vector<double> baby_mind_tangent_error);
 
-  std::vector<double> GetBabyMindTangentError(int track) const;
+  const std::vector<double> &GetBabyMindTangentError(int track) const;
 
   double GetBabyMindTangentError(int track, int view) const;
 
@@ -152,6 +223,22 @@ public :
 
   int GetNumberOfNinjaClusters() const;
 
+  /**
+   * Append one NINJA tracker cluster (number of clusters is incremented).
+   * The hit lists are validated in the same way as the setters.
+   * @param cluster cluster record
+   * @return id of the new cluster
+   */
+  int AddNinjaCluster(const NinjaCluster &cluster);
+
+  /**
+   * Same as AddNinjaCluster without any validation of the record, for
+   * clusters built from the hits of an already validated cluster
+   * @param cluster cluster record
+   * @return id of the new cluster
+   */
+  int AddNinjaClusterUnchecked(const NinjaCluster &cluster);
+
   void SetBabyMindTrackId(int cluster, int baby_mind_track_id);
 
   int GetBabyMindTrackId(int cluster) const;
@@ -160,7 +247,7 @@ public :
 
   void SetNumberOfHits(int cluster, std::vector<int> number_of_hits);
 
-  std::vector<int> GetNumberOfHits(int cluster) const;
+  const std::vector<int> &GetNumberOfHits(int cluster) const;
 
   int GetNumberOfHits(int cluster, int view) const;
 
@@ -176,6 +263,14 @@ public :
 
   int GetPlane(int cluster, int view, int hit) const;
 
+  /**
+   * Read the planes of the hits of one cluster in one view without copying
+   * @param cluster cluster id
+   * @param view sideview or topview
+   * @return view of the flat hit list, valid until the hits are resized
+   */
+  NTBMArrayView<UChar_t> GetPlaneView(int cluster, int view) const;
+
   void SetSlot(int cluster, int view, int hit, int slot);
 
   void SetSlot(int cluster, int view, std::vector<int> slot);
@@ -188,6 +283,14 @@ public :
 
   int GetSlot(int cluster, int view, int hit) const;
 
+  /**
+   * Read the slots of the hits of one cluster in one view without copying
+   * @param cluster cluster id
+   * @param view sideview or topview
+   * @return view of the flat hit list, valid until the hits are resized
+   */
+  NTBMArrayView<UChar_t> GetSlotView(int cluster, int view) const;
+
   void SetPe(int cluster, int view, int hit, double pe);
 
   void SetPe(int cluster, int view, std::vector<double> pe);
@@ -200,6 +303,24 @@ public :
 
   double GetPe(int cluster, int view, int hit) const;
 
+  /**
+   * 2d clusters made by the track matching do not copy the hits of their two
+   * 1d clusters but refer to them. All the hit getters resolve the reference,
+   * and the hit setters give the cluster its own copy of the hits first.
+   * @param cluster cluster id
+   * @param view sideview or topview
+   * @return id of the cluster holding the hits, -1 if the cluster holds its own hits
+   */
+  int GetHitSourceCluster(int cluster, int view) const;
+
+  /**
+   * Read the pe/tot of the hits of one cluster in one view without copying
+   * @param cluster cluster id
+   * @param view sideview or topview
+   * @return view of the flat hit list, valid until the hits are resized
+   */
+  NTBMArrayView<double> GetPeView(int cluster, int view) const;
+
   void SetBunchDifference(int cluster, int bunch_difference);
 
   int GetBunchDifference(int cluster) const;
@@ -208,7 +329,7 @@ public :
 
   void SetNinjaPosition(int cluster, std::vector<double> ninja_position);
 
-  std::vector<double> GetNinjaPosition(int cluster) const;
+  const std::vector<double> &GetNinjaPosition(int cluster) const;
 
   double GetNinjaPosition(int cluster, int view) const;
 
@@ -216,7 +337,7 @@ public :
 
   void SetNinjaPositionError(int cluster, std::vector<double> ninja_position_error);
 
-  std::vector<double> GetNinjaPositionError(int cluster) const;
+  const std::vector<double> &GetNinjaPositionError(int cluster) const;
 
   double GetNinjaPositionError(int cluster, int view) const;
 
@@ -224,7 +345,7 @@ public :
 
   void SetNinjaTangent(int cluster, std::vector<double> ninja_tangent);
 
-  std::vector<double> GetNinjaTangent(int cluster) const;
+  const std::vector<double> &GetNinjaTangent(int cluster) const;
 
   double GetNinjaTangent(int cluster, int view) const;
 
@@ -232,10 +353,14 @@ public :
 
   void SetNinjaTangentError(int cluster, std::vector<double> ninja_tangent_error);
 
-  std::vector<double> GetNinjaTangentError(int cluster) const;
+  const std::vector<double> &GetNinjaTangentError(int cluster) const;
 
   double GetNinjaTangentError(int cluster, int view) const;
 
+  void SetNinjaPositionFallback(int cluster, int ninja_position_fallback);
+
+  int GetNinjaPositionFallback(int cluster) const;
+
   void SetNumberOfTrueParticles(int cluster, int number_of_true_particles);
 
   int GetNumberOfTrueParticles(int cluster) const;
@@ -244,7 +369,7 @@ public :
 
   void SetTrueParticleId(int cluster, std::vector<int> true_particle_id);
 
-  std::vector<int> GetTrueParticleId(int cluster) const;
+  const std::vector<int> &GetTrueParticleId(int cluster) const;
 
   int GetTrueParticleId(int cluster, int particle) const;
 
@@ -280,8 +405,71 @@ public :
 
   double GetTrueTangent(int cluster, int particle, int view) const;
 
+  // Schema evolution helpers (used by the read rules in NTBMLinkDef.h)
+
+  /**
+   * Convert a nested per cluster list written before version 13
+   * (cluster -> view -> hit) into flat per view lists and offsets
+   * @param nested list as stored on file
+   * @param offset view -> cluster + 1 offsets (filled)
+   * @param flat view -> hit list (filled)
+   */
+  template < typename T, typename U >
+  static void FlattenHitList(const std::vector<std::vector<std::vector<T>>> &nested,
+			     std::vector<std::vector<int>> &offset,
+			     std::vector<std::vector<U>> &flat);
+
+  /**
+   * Convert a nested true particle list written before version 13
+   * (cluster -> particle -> view) into flat per view lists and offsets
+   * @param nested list as stored on file
+   * @param offset cluster + 1 offsets (filled)
+   * @param flat view -> particle list (filled)
+   */
+  static void FlattenTrueParticleList(const std::vector<std::vector<std::vector<double>>> &nested,
+				      std::vector<int> &offset,
+				      std::vector<std::vector<double>> &flat);
+
+  /**
+   * Convert a list written before version 13 to the compact storage type
+   * @param onfile list as stored on file
+   * @param list member list (filled)
+   */
+  template < typename T, typename U >
+  static void ConvertList(const std::vector<T> &onfile, std::vector<U> &list);
+
+  template < typename T, typename U >
+  static void ConvertList(const std::vector<std::vector<T>> &onfile, std::vector<std::vector<U>> &list);
+
+  ///> Split level of the NTBMSummary branch (one independently readable branch for each member)
+  static const int BRANCH_SPLIT_LEVEL = 99;
+
+  /**
+   * Create the NTBMSummary branch split into one branch for each member
+   * @param tree output tree
+   * @param ntbm address of the NTBMSummary pointer filled in the tree
+   */
+  static void CreateBranch(TTree *tree, NTBMSummary **ntbm);
+
+  /**
+   * Set the NTBMSummary branch address and read only the listed members.
+   * The other members keep the values of the object (empty lists for a new object).
+   * For files written before version 13, the branches the read rules convert into the
+   * members are read instead (e.g. plane_/slot_/pe_ for hit_plane_). Files whose members
+   * are not found (e.g. not split) are read entirely.
+   * @param tree input tree
+   * @param ntbm address of the NTBMSummary pointer
+   * @param members member branch names (e.g. "ninja_position_")
+   */
+  static void SetBranchAddress(TTree *tree, NTBMSummary **ntbm,
+			       const std::vector<std::string> &members);
+
 private :
 
+  // Storage types (schema version 13) : small ids and flags are 8 bit (std::int8_t, signed on
+  // all platforms unlike Char_t), reconstructed and true kinematics and pe/tot are Double32_t
+  // (double in memory, float on disk). Beam information (POT, timestamp) and MC weights stay double.
+
   ///> File information
   int entry_in_daily_file_;
   ///> Beam information extracted from B2BeamSummary
@@ -304,31 +492,31 @@ private :
   ///> Number of Baby MIND reconstructed tracks;
   int number_of_tracks_;
   ///> Track type (0:ECC interaction cand, 1:sand muon, 2:Upstream WAGASCI/PM -1:Downstream WAGASCI)
-  std::vector<int> ninja_track_type_;
+  std::vector<std::int8_t> ninja_track_type_;
   ///> Momentum measurement type (0:range, 1:curvature)
-  std::vector<int> momentum_type_;
+  std::vector<std::int8_t> momentum_type_;
   ///> Baby MIND reconstructed momentum
-  std::vector<double> momentum_;
+  std::vector<Double32_t> momentum_;
   ///> Baby MIND reconstructed momentum error
-  std::vector<double> momentum_error_;
+  std::vector<Double32_t> momentum_error_;
   ///> Baby MIND reconstructed position
-  std::vector<std::vector<double>> baby_mind_position_;
+  std::vector<std::vector<Double32_t>> baby_mind_position_;
   ///> Baby MIND reconstructed position error
-  std::vector<std::vector<double>> baby_mind_position_error_;
+  std::vector<std::vector<Double32_t>> baby_mind_position_error_;
   ///> Baby MIND reconstructed tangent
-  std::vector<std::vector<double>> baby_mind_tangent_;
+  std::vector<std::vector<Double32_t>> baby_mind_tangent_;
   ///> Baby MIND reconstructed tangent error
-  std::vector<std::vector<double>> baby_mind_tangent_error_;
+  std::vector<std::vector<Double32_t>> baby_mind_tangent_error_;
   ///> Baby MIND maximum plane
-  std::vector<int> baby_mind_maximum_plane_;
+  std::vector<std::int8_t> baby_mind_maximum_plane_;
   ///> WAGASCI total material length
-  std::vector<double> track_length_total_;
+  std::vector<Double32_t> track_length_total_;
   ///> Baby MIND reconstructed charge (assuming muon +/-)
-  std::vector<int> charge_;
+  std::vector<std::int8_t> charge_;
   ///> Baby MIND reconstructed track direction (+/-)
-  std::vector<int> direction_;
+  std::vector<std::int8_t> direction_;
   ///> Bunch number where the track detected
-  std::vector<int> bunch_;
+  std::vector<std::int8_t> bunch_;
   ///> NINJA tracker information for muon track matching
   ///> cluster -> view(2) -> hit
   ///> Number of NINJA tracker 3d clusters
@@ -337,24 +525,31 @@ private :
   std::vector<int> baby_mind_track_id_;
   ///> Number of NINJA tracker hits
   std::vector<std::vector<int>> number_of_hits_;
-  ///> List of hit scintillator plane in NINJA tracker
-  std::vector<std::vector<std::vector<int>>> plane_;
-  ///> List of hit scintillator slot in NINJA tracker
-  std::vector<std::vector<std::vector<int>>> slot_;
-  ///> List of hit scintillator pe/tot in NINJA tracker
-  std::vector<std::vector<std::vector<double>>> pe_;
+  ///> Hits are stored flat per view (compressed sparse row)
+  ///> view(2) -> cluster + 1, hits of cluster i are [ offset(i), offset(i + 1) )
+  std::vector<std::vector<int>> hit_offset_;
+  ///> List of hit scintillator plane in NINJA tracker (view(2) -> hit)
+  std::vector<std::vector<UChar_t>> hit_plane_;
+  ///> List of hit scintillator slot in NINJA tracker (view(2) -> hit)
+  std::vector<std::vector<UChar_t>> hit_slot_;
+  ///> List of hit scintillator pe/tot in NINJA tracker (view(2) -> hit)
+  std::vector<std::vector<Double32_t>> hit_pe_;
+  ///> Cluster whose hits are shared, view(2) -> cluster (-1 : own hits)
+  std::vector<std::vector<int>> hit_source_cluster_;
   ///> Difference from the first hit bunch in NINJA tracker
-  std::vector<int> bunch_difference_;
+  std::vector<std::int8_t> bunch_difference_;
   ///> Reconstructed position for track matching
-  std::vector<std::vector<double>> ninja_position_;
+  std::vector<std::vector<Double32_t>> ninja_position_;
   ///> Reconstructed position error for track matching
-  std::vector<std::vector<double>> ninja_position_error_;
+  std::vector<std::vector<Double32_t>> ninja_position_error_;
   ///> Reconstructed tangent for track matching
-  std::vector<std::vector<double>> ninja_tangent_;
+  std::vector<std::vector<Double32_t>> ninja_tangent_;
   ///> Reconstructed tangent error for track matching
-  std::vector<std::vector<double>> ninja_tangent_error_;
+  std::vector<std::vector<Double32_t>> ninja_tangent_error_;
+  ///> Position reconstruction fallback flag (1 : bar average as the spill exceeded the budget)
+  std::vector<UChar_t> ninja_position_fallback_;
   ///> True particle information for MC
-  ///> cluster -> true particle -> view(2)
+  ///> cluster -> true particle (position/tangent stored flat per view)
   ///> Noramalization factor from beam MC
   double normalization_;
   ///> Total cross section from NEUT
@@ -363,12 +558,126 @@ private :
   std::vector<int> number_of_true_particles_;
   ///> PDG particle id of true particles
   std::vector<std::vector<int>> true_particle_id_;
-  ///> True position
-  std::vector<std::vector<std::vector<double>>> true_position_;
-  ///> True tangent
-  std::vector<std::vector<std::vector<double>>> true_tangent_;
+  ///> cluster + 1, particles of cluster i are [ offset(i), offset(i + 1) )
+  std::vector<int> true_particle_offset_;
+  ///> True position (view(2) -> particle)
+  std::vector<std::vector<Double32_t>> true_particle_position_;
+  ///> True tangent (view(2) -> particle)
+  std::vector<std::vector<Double32_t>> true_particle_tangent_;
+
+  /**
+   * Inner lists released by Clear("R") and reused when the nested members grow again.
+   * Each member has its own spare lists, so a row only gets the capacity of a row of the
+   * same member (e.g. a position pair does not take the capacity of a hit list).
+   * They belong to the object : neither copied with it nor written.
+   */
+  template < typename T >
+  struct SpareRows {
+    ///> nested member -> its released inner lists
+    std::map<const std::vector<std::vector<T>>*, std::vector<std::vector<T>>> rows;
+    SpareRows() {}
+    SpareRows(const SpareRows&) {}
+    SpareRows &operator=(const SpareRows&) { return *this; }
+  };
+  SpareRows<double> spare_double_rows_; //!
+  SpareRows<int> spare_int_rows_; //!
+  SpareRows<UChar_t> spare_uchar_rows_; //!
+
+  std::vector<std::vector<double>> &GetSpareRows(const std::vector<std::vector<double>> &list) {
+    return spare_double_rows_.rows[&list];
+  }
+  std::vector<std::vector<int>> &GetSpareRows(const std::vector<std::vector<int>> &list) {
+    return spare_int_rows_.rows[&list];
+  }
+  std::vector<std::vector<UChar_t>> &GetSpareRows(const std::vector<std::vector<UChar_t>> &list) {
+    return spare_uchar_rows_.rows[&list];
+  }
+
+  /**
+   * Resize a nested list. New inner lists are taken from the spare rows of the list and
+   * removed ones are moved to them, so their capacity is kept.
+   * @param list nested list
+   * @param size new size
+   */
+  template < typename T >
+  void ResizeRows(std::vector<std::vector<T>> &list, std::size_t size);
 
-  ClassDefOverride(NTBMSummary, 12) // NT BM Summary
+  /**
+   * Copy a nested list into the inner lists already allocated
+   * @param list nested list (filled)
+   * @param source source list
+   */
+  template < typename T >
+  void AssignRows(std::vector<std::vector<T>> &list, const std::vector<std::vector<T>> &source);
+
+  /**
+   * Resize the per view list to size and set the last element
+   * @param list track/cluster -> view list
+   * @param size new size
+   * @param value values for each view
+   */
+  void SetLastRow(std::vector<std::vector<Double32_t>> &list, std::size_t size, const double *value);
+
+  /**
+   * Index of the hit in the flat per view hit lists
+   * @param cluster cluster id
+   * @param view sideview or topview
+   * @param hit hit id in the cluster
+   * @return index in hit_plane_/hit_slot_/hit_pe_
+   */
+  std::size_t GetHitIndex(int cluster, int view, int hit) const;
+
+  /**
+   * Cluster whose row of the flat hit lists holds the hits of the cluster
+   * @param cluster cluster id
+   * @param view sideview or topview
+   * @return cluster id of the row
+   */
+  int GetHitRow(int cluster, int view) const;
+
+  /**
+   * Copy the shared hits into the own row of the cluster before modifying them
+   * @param cluster cluster id
+   * @param view sideview or topview
+   */
+  void DetachHits(int cluster, int view);
+
+  /**
+   * Index of the true particle in the flat per view true particle lists
+   * @param cluster cluster id
+   * @param particle true particle id in the cluster
+   * @return index in true_particle_position_/true_particle_tangent_
+   */
+  std::size_t GetTrueParticleIndex(int cluster, int particle) const;
+
+  ClassDefOverride(NTBMSummary, 13) // NT BM Summary
 };
 
+template < typename T, typename U >
+void NTBMSummary::FlattenHitList(const std::vector<std::vector<std::vector<T>>> &nested,
+				 std::vector<std::vector<int>> &offset,
+				 std::vector<std::vector<U>> &flat) {
+  offset.assign(NUMBER_OF_VIEWS, std::vector<int>(1, 0));
+  flat.assign(NUMBER_OF_VIEWS, std::vector<U>());
+  for ( const auto &cluster : nested ) {
+    for ( int view = 0; view < NUMBER_OF_VIEWS; view++ ) {
+      if ( (std::size_t)view < cluster.size() )
+	flat.at(view).insert(flat.at(view).end(), cluster.at(view).begin(), cluster.at(view).end());
+      offset.at(view).push_back(flat.at(view).size());
+    }
+  }
+}
+
+template < typename T, typename U >
+void NTBMSummary::ConvertList(const std::vector<T> &onfile, std::vector<U> &list) {
+  list.assign(onfile.begin(), onfile.end());
+}
+
+template < typename T, typename U >
+void NTBMSummary::ConvertList(const std::vector<std::vector<T>> &onfile, std::vector<std::vector<U>> &list) {
+  list.resize(onfile.size());
+  for ( std::size_t i = 0; i < onfile.size(); i++ )
+    ConvertList(onfile.at(i), list.at(i));
+}
+
 #endif
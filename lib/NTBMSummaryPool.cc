@@ -0,0 +1,43 @@
+#include "NTBMSummaryPool.hh"
+#include "NTBMSummary.hh"
+
+void NTBMSummaryPool::Releaser::operator()(NTBMSummary *ntbm) const {
+  pool->Release(ntbm);
+}
+
+NTBMSummaryPool::~NTBMSummaryPool() {
+  for ( NTBMSummary *ntbm : free_ )
+    delete ntbm;
+}
+
+NTBMSummaryPool::Pointer NTBMSummaryPool::Acquire() {
+  NTBMSummary *ntbm = nullptr;
+  if ( free_.empty() ) {
+    ntbm = new NTBMSummary();
+    number_of_created_++;
+  } else {
+    ntbm = free_.back();
+    free_.pop_back();
+    number_of_reused_++;
+  }
+  return Pointer(ntbm, Releaser{this});
+}
+
+void NTBMSummaryPool::Release(NTBMSummary *ntbm) {
+  if ( ntbm == nullptr ) return;
+  ntbm->Clear("R");
+  free_.push_back(ntbm);
+}
+
+std::size_t NTBMSummaryPool::GetNumberOfCreated() const {
+  return number_of_created_;
+}
+
+std::size_t NTBMSummaryPool::GetNumberOfReused() const {
+  return number_of_reused_;
+}
+
+NTBMSummaryPool &NTBMSummaryPool::GetThreadPool() {
+  static thread_local NTBMSummaryPool pool;
+  return pool;
+}
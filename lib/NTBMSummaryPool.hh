@@ -0,0 +1,73 @@
+#ifndef NTBM_SUMMARY_POOL_HH
+#define NTBM_SUMMARY_POOL_HH
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+class NTBMSummary;
+
+/**
+ * Pool of reusable NTBMSummary objects. Released objects are cleared with Clear("R")
+ * so that their lists keep the capacity of the previous spills (and files), and a
+ * steady-state spill loop does not allocate the NTBMSummary lists again.
+ * A pool is used by one thread only, each thread has its own pool (GetThreadPool).
+ */
+class NTBMSummaryPool {
+
+public :
+
+  /**
+   * Deleter returning the object to its pool
+   */
+  struct Releaser {
+    NTBMSummaryPool *pool;
+    void operator()(NTBMSummary *ntbm) const;
+  };
+
+  ///> Object acquired from a pool, returned to the pool when destroyed
+  typedef std::unique_ptr<NTBMSummary, Releaser> Pointer;
+
+  NTBMSummaryPool() = default;
+
+  ~NTBMSummaryPool();
+
+  NTBMSummaryPool(const NTBMSummaryPool&) = delete;
+  NTBMSummaryPool &operator=(const NTBMSummaryPool&) = delete;
+
+  /**
+   * Get a cleared object, a new one is created only when the pool is empty
+   * @return object owned by the caller until it is destroyed
+   */
+  Pointer Acquire();
+
+  /**
+   * Clear the object keeping its capacity and keep it for the next Acquire
+   * @param ntbm object acquired from this pool
+   */
+  void Release(NTBMSummary *ntbm);
+
+  /**
+   * @return number of objects created by the pool
+   */
+  std::size_t GetNumberOfCreated() const;
+
+  /**
+   * @return number of Acquire calls served by a released object
+   */
+  std::size_t GetNumberOfReused() const;
+
+  /**
+   * @return pool of the calling thread
+   */
+  static NTBMSummaryPool &GetThreadPool();
+
+private :
+
+  std::vector<NTBMSummary*> free_;
+  std::size_t number_of_created_ = 0;
+  std::size_t number_of_reused_ = 0;
+
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "NinjaGeometry.hh"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+void WriteNinjaGeometryTable(std::ostream &os,
+			     const TVector3 (&position)[NUMBER_OF_VIEWS][NUMBER_OF_PLANES][NUMBER_OF_SLOTS_IN_PLANE],
+			     const TVector3 (&error)[NUMBER_OF_VIEWS],
+			     const bool (&dead)[NUMBER_OF_VIEWS][NUMBER_OF_PLANES][NUMBER_OF_SLOTS_IN_PLANE]) {
+  os << "# NINJA tracker geometry table" << '\n'
+     << "# position <view> <plane> <slot> <x> <y> <z> <dead>" << '\n'
+     << "# error <view> <x> <y> <z>" << '\n';
+  // enough digits to read back the same double values
+  os << std::setprecision(std::numeric_limits<double>::max_digits10);
+  for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ ) {
+    for ( int iplane = 0; iplane < NUMBER_OF_PLANES; iplane++ )
+      for ( int islot = 0; islot < NUMBER_OF_SLOTS_IN_PLANE; islot++ ) {
+	const TVector3 &bar = position[iview][iplane][islot];
+	os << "position " << iview << " " << iplane << " " << islot << " "
+	   << bar.X() << " " << bar.Y() << " " << bar.Z() << " "
+	   << dead[iview][iplane][islot] << '\n';
+      }
+    os << "error " << iview << " "
+       << error[iview].X() << " " << error[iview].Y() << " " << error[iview].Z() << '\n';
+  }
+}
+
+#ifdef NTBM_STANDALONE_GEOMETRY
+
+namespace {
+
+/**
+ * Geometry table filled from the dumped file
+ */
+struct NinjaGeometryTable {
+  TVector3 position[NUMBER_OF_VIEWS][NUMBER_OF_PLANES][NUMBER_OF_SLOTS_IN_PLANE];
+  bool dead[NUMBER_OF_VIEWS][NUMBER_OF_PLANES][NUMBER_OF_SLOTS_IN_PLANE];
+  TVector3 error[NUMBER_OF_VIEWS];
+  int number_of_positions = 0;
+  int number_of_errors = 0;
+};
+
+NinjaGeometryTable geometry_table;
+std::once_flag geometry_table_flag;
+
+void LoadDefaultNinjaGeometryTable() {
+  std::call_once(geometry_table_flag, []() {
+      if ( geometry_table.number_of_positions > 0 ) return; // already read explicitly
+      const std::string path = GetNinjaGeometryTablePath();
+      std::ifstream ifs(path);
+      if ( !ifs )
+	throw std::runtime_error("Failed to open NINJA geometry table : " + path);
+      ReadNinjaGeometryTable(ifs);
+    });
+}
+
+bool IsValidChannel(int view, int plane, int slot) {
+  return 0 <= view && view < NUMBER_OF_VIEWS &&
+    0 <= plane && plane < NUMBER_OF_PLANES &&
+    0 <= slot && slot < NUMBER_OF_SLOTS_IN_PLANE;
+}
+
+}
+
+std::string GetNinjaGeometryTablePath() {
+  if ( const char *path = std::getenv("NINJA_TRACKER_GEOMETRY") )
+    return path;
+  return NTBM_GEOMETRY_TABLE_PATH;
+}
+
+void ReadNinjaGeometryTable(std::istream &is) {
+  NinjaGeometryTable table;
+  std::string line;
+  while ( std::getline(is, line) ) {
+    if ( line.empty() || line.at(0) == '#' ) continue;
+    std::istringstream iss(line);
+    std::string key;
+    int view, plane, slot;
+    double x, y, z;
+    bool dead;
+    iss >> key;
+    if ( key == "position" && iss >> view >> plane >> slot >> x >> y >> z >> dead &&
+	 IsValidChannel(view, plane, slot) ) {
+      table.position[view][plane][slot].SetXYZ(x, y, z);
+      table.dead[view][plane][slot] = dead;
+      table.number_of_positions++;
+    }
+    else if ( key == "error" && iss >> view >> x >> y >> z &&
+	      0 <= view && view < NUMBER_OF_VIEWS ) {
+      table.error[view].SetXYZ(x, y, z);
+      table.number_of_errors++;
+    }
+    else
+      throw std::runtime_error("Invalid NINJA geometry table line : " + line);
+  }
+  if ( table.number_of_positions != NUMBER_OF_VIEWS * NUMBER_OF_PLANES * NUMBER_OF_SLOTS_IN_PLANE ||
+       table.number_of_errors != NUMBER_OF_VIEWS )
+    throw std::runtime_error("Incomplete NINJA geometry table");
+  geometry_table = table;
+}
+
+bool GetNinjaTrackerPosition(int view, int plane, int slot, TVector3 &position) {
+  LoadDefaultNinjaGeometryTable();
+  if ( !IsValidChannel(view, plane, slot) ) return false;
+  position = geometry_table.position[view][plane][slot];
+  return true;
+}
+
+void GetNinjaTrackerError(int view, TVector3 &error) {
+  LoadDefaultNinjaGeometryTable();
+  if ( 0 <= view && view < NUMBER_OF_VIEWS )
+    error = geometry_table.error[view];
+}
+
+bool IsNinjaTrackerDeadChannel(int view, int readout, int plane, int slot) {
+  LoadDefaultNinjaGeometryTable();
+  if ( !IsValidChannel(view, plane, slot) ) return false;
+  return geometry_table.dead[view][plane][slot];
+}
+
+#endif
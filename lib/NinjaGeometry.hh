@@ -0,0 +1,98 @@
+#ifndef NINJA_GEOMETRY_HH
+#define NINJA_GEOMETRY_HH
+
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include <TVector3.h>
+
+#ifndef NTBM_STANDALONE_GEOMETRY
+#include <B2Enum.hh>
+#include <B2Dimension.hh>
+#endif
+
+#include "NTBMConst.hh"
+
+/*
+ * NINJA tracker geometry used by the reconstruction.
+ *
+ * In the full build the functions forward to B2Dimension. In the lightweight
+ * build (NTBM_STANDALONE_GEOMETRY, CMake option NINJA_RECON_WITH_GEANT4=OFF)
+ * they look up a geometry table dumped once by NinjaGeometryDump in a full
+ * build. The table is read at the first call from the file given by the
+ * NINJA_TRACKER_GEOMETRY environment variable or from the installed default.
+ */
+
+/**
+ * Write the geometry table
+ * @param os output stream
+ * @param position bar positions [view][plane][slot]
+ * @param error position error [view]
+ * @param dead dead channel flags [view][plane][slot]
+ */
+void WriteNinjaGeometryTable(std::ostream &os,
+			     const TVector3 (&position)[NUMBER_OF_VIEWS][NUMBER_OF_PLANES][NUMBER_OF_SLOTS_IN_PLANE],
+			     const TVector3 (&error)[NUMBER_OF_VIEWS],
+			     const bool (&dead)[NUMBER_OF_VIEWS][NUMBER_OF_PLANES][NUMBER_OF_SLOTS_IN_PLANE]);
+
+#ifdef NTBM_STANDALONE_GEOMETRY
+
+/**
+ * Read the geometry table used by the standalone geometry.
+ * Called implicitly at the first lookup with the default table path.
+ * @param is input stream
+ */
+void ReadNinjaGeometryTable(std::istream &is);
+
+/**
+ * Get the path of the default geometry table
+ * @return NINJA_TRACKER_GEOMETRY environment variable or installed default table
+ */
+std::string GetNinjaGeometryTablePath();
+
+/**
+ * Get NINJA tracker scintillator bar position in the tracker box coordinate
+ * @param view view
+ * @param plane plane
+ * @param slot slot
+ * @param position scintillator bar position
+ * @return true if the channel exists
+ */
+bool GetNinjaTrackerPosition(int view, int plane, int slot, TVector3 &position);
+
+/**
+ * Get NINJA tracker position error
+ * @param view view
+ * @param error position error
+ */
+void GetNinjaTrackerError(int view, TVector3 &error);
+
+/**
+ * Check if the NINJA tracker channel is dead. The NINJA readout is fixed
+ * by the view and the plane, so the readout is not used in the lookup.
+ * @param view view
+ * @param readout readout
+ * @param plane plane
+ * @param slot slot
+ * @return true if the channel is dead
+ */
+bool IsNinjaTrackerDeadChannel(int view, int readout, int plane, int slot);
+
+#else
+
+inline bool GetNinjaTrackerPosition(int view, int plane, int slot, TVector3 &position) {
+  return B2Dimension::GetPosNinjaTracker((B2View)view, plane, slot, position);
+}
+
+inline void GetNinjaTrackerError(int view, TVector3 &error) {
+  B2Dimension::GetErrorNinja((B2View)view, error);
+}
+
+inline bool IsNinjaTrackerDeadChannel(int view, int readout, int plane, int slot) {
+  return B2Dimension::CheckDeadChannel(B2Detector::kNinja, (B2View)view, (B2Readout)readout, plane, slot);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,181 @@
+#include "NinjaTrackerReadAhead.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <TBranch.h>
+
+std::ostream &operator<<(std::ostream &os, const ReadAheadStatistics &statistics) {
+  os << "hits = " << statistics.hits << ", "
+     << "misses = " << statistics.misses << ", "
+     << "skipped = " << statistics.skipped << ", "
+     << "stall time = " << statistics.stall_time << " s";
+  return os;
+}
+
+NinjaTrackerReadAhead::NinjaTrackerReadAhead(TTree *tree, std::size_t depth, Long64_t cache_size) :
+  tree_(tree), number_of_entries_(tree->GetEntries()),
+  current_slot_(0), has_current_slot_(false),
+  next_entry_(0), requested_entry_(0), stop_(false) {
+
+  if ( cache_size >= 0 )
+    tree_->SetCacheSize(cache_size);
+
+  tree_->SetBranchAddress("ADC", branch_buffer_.adc);
+  tree_->SetBranchAddress("LEADTIME", branch_buffer_.lt);
+  tree_->SetBranchAddress("TRAILTIME", branch_buffer_.tt);
+  tree_->SetBranchAddress("UNIXTIME", branch_buffer_.unixtime);
+  tree_->SetBranchAddress("PE", branch_buffer_.pe);
+  tree_->SetBranchAddress("VIEW", branch_buffer_.view);
+  tree_->SetBranchAddress("PLN", branch_buffer_.pln);
+  tree_->SetBranchAddress("CH", branch_buffer_.ch);
+
+  // Only the unixtime branch is read for the index
+  TBranch *unixtime_branch = tree_->GetBranch("UNIXTIME");
+  unixtime_index_.resize(number_of_entries_);
+  for ( Long64_t ientry = 0; ientry < number_of_entries_; ientry++ ) {
+    unixtime_branch->GetEntry(ientry);
+    unixtime_index_.at(ientry) = branch_buffer_.unixtime[0];
+  }
+
+  if ( cache_size != 0 )
+    tree_->AddBranchToCache("*", kTRUE);
+
+  if ( depth > 0 ) {
+    // One more slot for the entry held by the consumer
+    slots_.resize(depth + 1);
+    for ( std::size_t islot = 0; islot < slots_.size(); islot++ )
+      free_slots_.push_back(islot);
+    thread_ = std::thread(&NinjaTrackerReadAhead::Prefetch, this);
+  } else {
+    slots_.resize(1);
+  }
+
+}
+
+NinjaTrackerReadAhead::~NinjaTrackerReadAhead() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+  if ( thread_.joinable() )
+    thread_.join();
+}
+
+void NinjaTrackerReadAhead::ReadEntry(Long64_t entry, NinjaTrackerEntry &buffer) {
+  tree_->GetEntry(entry);
+  std::memcpy(&buffer, &branch_buffer_, sizeof(NinjaTrackerEntry));
+  buffer.entry = entry;
+}
+
+void NinjaTrackerReadAhead::Prefetch() {
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while ( true ) {
+    condition_.wait(lock, [this] {
+	return stop_ || ( !free_slots_.empty() &&
+			  std::max(next_entry_, requested_entry_) < number_of_entries_ );
+      });
+    if ( stop_ ) break;
+    // the consumer already skipped these entries
+    if ( next_entry_ < requested_entry_ )
+      next_entry_ = requested_entry_;
+    const Long64_t entry = next_entry_++;
+    const std::size_t islot = free_slots_.back();
+    free_slots_.pop_back();
+
+    // errors are passed to the consumer thread and thrown by GetEntry
+    lock.unlock();
+    try {
+      ReadEntry(entry, slots_.at(islot));
+    } catch (...) {
+      lock.lock();
+      error_ = std::current_exception();
+      condition_.notify_all();
+      break;
+    }
+    lock.lock();
+
+    ready_slots_.push_back(islot);
+    condition_.notify_all();
+  }
+
+}
+
+NinjaTrackerEntry &NinjaTrackerReadAhead::GetEntry(Long64_t entry) {
+
+  if ( entry < 0 || entry >= number_of_entries_ )
+    throw std::out_of_range("NINJA tracker entry out of range : " + std::to_string(entry));
+  if ( entry < requested_entry_ )
+    throw std::invalid_argument("NINJA tracker entries should be requested in increasing order : "
+				+ std::to_string(entry));
+
+  // Synchronous mode
+  if ( !thread_.joinable() ) {
+    if ( has_current_slot_ && entry == requested_entry_ )
+      return slots_.front();
+    requested_entry_ = entry;
+    ReadEntry(entry, slots_.front());
+    has_current_slot_ = true;
+    return slots_.front();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  // The entry held by the consumer is requested again, the prefetch thread already passed it
+  if ( has_current_slot_ && slots_.at(current_slot_).entry == entry ) {
+    statistics_.hits++;
+    return slots_.at(current_slot_);
+  }
+  if ( has_current_slot_ ) {
+    free_slots_.push_back(current_slot_);
+    has_current_slot_ = false;
+  }
+  requested_entry_ = entry;
+  condition_.notify_all();
+
+  bool stalled = false;
+  std::chrono::steady_clock::time_point stall_start;
+  while ( true ) {
+    while ( !ready_slots_.empty() && slots_.at(ready_slots_.front()).entry < entry ) {
+      free_slots_.push_back(ready_slots_.front());
+      ready_slots_.pop_front();
+      statistics_.skipped++;
+      condition_.notify_all();
+    }
+    if ( !ready_slots_.empty() ) break;
+    if ( error_ ) std::rethrow_exception(error_);
+    if ( !stalled ) stall_start = std::chrono::steady_clock::now();
+    stalled = true;
+    condition_.wait(lock);
+  }
+
+  if ( stalled ) {
+    statistics_.misses++;
+    statistics_.stall_time += std::chrono::duration<double>
+      (std::chrono::steady_clock::now() - stall_start).count();
+  } else {
+    statistics_.hits++;
+  }
+
+  current_slot_ = ready_slots_.front();
+  has_current_slot_ = true;
+  ready_slots_.pop_front();
+  return slots_.at(current_slot_);
+
+}
+
+Long64_t NinjaTrackerReadAhead::GetEntries() const {
+  return number_of_entries_;
+}
+
+UInt_t NinjaTrackerReadAhead::GetUnixtime(Long64_t entry) const {
+  return unixtime_index_.at(entry);
+}
+
+const ReadAheadStatistics &NinjaTrackerReadAhead::GetStatistics() const {
+  return statistics_;
+}
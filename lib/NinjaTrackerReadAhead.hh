@@ -0,0 +1,126 @@
+#ifndef NINJA_TRACKER_READ_AHEAD_HH
+#define NINJA_TRACKER_READ_AHEAD_HH
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <ostream>
+
+#include <TTree.h>
+
+#include "NTBMConst.hh"
+
+/**
+ * Counters of a read-ahead layer reported at the end of the run
+ */
+struct ReadAheadStatistics {
+  ///> number of requested entries already decoded when requested
+  Long64_t hits = 0;
+  ///> number of requested entries the consumer had to wait for
+  Long64_t misses = 0;
+  ///> number of decoded entries dropped without being requested
+  Long64_t skipped = 0;
+  ///> total time the consumer waited for the background thread
+  double stall_time = 0.; // s
+};
+
+std::ostream &operator<<(std::ostream &os, const ReadAheadStatistics &statistics);
+
+/**
+ * One entry of the NINJA tracker raw data tree
+ */
+struct NinjaTrackerEntry {
+  Long64_t entry;
+  Int_t adc[NUMBER_OF_SLOTS_IN_TRACKER];
+  Int_t lt[NUMBER_OF_SLOTS_IN_TRACKER];
+  Int_t tt[NUMBER_OF_SLOTS_IN_TRACKER];
+  UInt_t unixtime[NUMBER_OF_SLOTS_IN_TRACKER];
+  Float_t pe[NUMBER_OF_SLOTS_IN_TRACKER];
+  Int_t view[NUMBER_OF_SLOTS_IN_TRACKER];
+  Int_t pln[NUMBER_OF_SLOTS_IN_TRACKER];
+  Int_t ch[NUMBER_OF_SLOTS_IN_TRACKER];
+};
+
+/**
+ * Read-ahead layer for the NINJA tracker raw data tree.
+ * A background thread decodes the entries after the last requested one,
+ * so the requested entries should be increasing (entries can be skipped).
+ * The unixtime of the first slot of all entries is indexed at construction
+ * so that the corresponding entry can be searched without decoding the others.
+ * The tree must not be used by the caller while this object exists.
+ */
+class NinjaTrackerReadAhead {
+
+public :
+
+  /**
+   * @param tree NINJA tracker raw data tree
+   * @param depth number of entries decoded ahead (0 : read synchronously)
+   * @param cache_size TTreeCache size in bytes (negative : ROOT default)
+   */
+  NinjaTrackerReadAhead(TTree *tree, std::size_t depth, Long64_t cache_size = -1);
+
+  ~NinjaTrackerReadAhead();
+
+  NinjaTrackerReadAhead(const NinjaTrackerReadAhead&) = delete;
+  NinjaTrackerReadAhead &operator=(const NinjaTrackerReadAhead&) = delete;
+
+  /**
+   * Get decoded entry. The returned object is owned by the caller until the next call.
+   * The same entry requested again returns the same object without reading it again.
+   * An error of the background thread while reading the entry is thrown here.
+   * @param entry entry number not smaller than the previous request
+   * @return decoded entry
+   */
+  NinjaTrackerEntry &GetEntry(Long64_t entry);
+
+  /**
+   * @return number of entries in the tree
+   */
+  Long64_t GetEntries() const;
+
+  /**
+   * @param entry entry number
+   * @return unixtime of the first slot of the entry
+   */
+  UInt_t GetUnixtime(Long64_t entry) const;
+
+  /**
+   * @return read-ahead counters
+   */
+  const ReadAheadStatistics &GetStatistics() const;
+
+private :
+
+  void ReadEntry(Long64_t entry, NinjaTrackerEntry &buffer);
+  void Prefetch();
+
+  TTree *tree_;
+  Long64_t number_of_entries_;
+  std::vector<UInt_t> unixtime_index_;
+
+  // tree branches are always read into this buffer then copied to a slot
+  NinjaTrackerEntry branch_buffer_;
+  std::vector<NinjaTrackerEntry> slots_;
+  std::deque<std::size_t> ready_slots_;
+  std::vector<std::size_t> free_slots_;
+  std::size_t current_slot_;
+  bool has_current_slot_;
+
+  Long64_t next_entry_;
+  Long64_t requested_entry_;
+  bool stop_;
+  ///> error thrown by the background thread, the entries read before it are still returned
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread thread_;
+
+  ReadAheadStatistics statistics_;
+
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include "WorkerQueue.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+///> Suffix of the jobs claimed by a worker
+static const std::string RUNNING_SUFFIX = ".running";
+///> Suffix of the jobs claimed again after their worker stopped
+static const std::string RECOVERED_SUFFIX = ".recovered.running";
+
+static bool EndsWith(const std::string &name, const std::string &suffix) {
+  return name.size() >= suffix.size() &&
+    name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/**
+ * @param path job file path
+ * @return true if the job file is not empty and ends with a newline (completely written)
+ */
+static bool IsCompleteJobFile(const std::string &path) {
+  std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+  if ( !ifs || ifs.tellg() <= 0 ) return false;
+  ifs.seekg(-1, std::ios::end);
+  return ifs.get() == '\n';
+}
+
+std::vector<std::string> SplitJobLine(const std::string &line) {
+  std::vector<std::string> arguments;
+  std::istringstream iss(line);
+  std::string argument;
+  while ( iss >> argument ) {
+    if ( arguments.empty() && argument.at(0) == '#' ) break;
+    arguments.push_back(argument);
+  }
+  return arguments;
+}
+
+WorkerQueue::WorkerQueue(const std::string &manifest) :
+  is_spool_(false), manifest_(&std::cin), line_number_(0), idle_timeout_(0.),
+  running_fd_(-1), number_of_succeeded_(0), number_of_failed_(0) {
+  if ( manifest != "-" ) {
+    manifest_file_.open(manifest);
+    if ( !manifest_file_.is_open() )
+      throw std::runtime_error("Cannot open manifest : " + manifest);
+    manifest_ = &manifest_file_;
+  }
+}
+
+WorkerQueue::WorkerQueue(const std::string &spool_directory, double idle_timeout) :
+  is_spool_(true), manifest_(nullptr), line_number_(0),
+  spool_directory_(spool_directory), idle_timeout_(idle_timeout),
+  running_fd_(-1), number_of_succeeded_(0), number_of_failed_(0) {
+  if ( !fs::is_directory(spool_directory_) )
+    throw std::runtime_error("Spool directory not found : " + spool_directory_);
+}
+
+WorkerQueue::~WorkerQueue() {
+  if ( running_fd_ >= 0 )
+    ::close(running_fd_);
+}
+
+bool WorkerQueue::Next(std::vector<std::string> &arguments) {
+  arguments.clear();
+  return is_spool_ ? NextFromSpool(arguments) : NextFromManifest(arguments);
+}
+
+bool WorkerQueue::NextFromManifest(std::vector<std::string> &arguments) {
+  std::string line;
+  while ( std::getline(*manifest_, line) ) {
+    line_number_++;
+    arguments = SplitJobLine(line);
+    if ( !arguments.empty() ) {
+      job_name_ = "line " + std::to_string(line_number_);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WorkerQueue::ClaimJob(const std::string &path, const std::string &running_path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if ( fd < 0 ) return false;
+  // the lock of a running job is held by its worker
+  if ( ::flock(fd, LOCK_EX | LOCK_NB) != 0 ) {
+    ::close(fd);
+    return false;
+  }
+  // the job may have been renamed by its worker before it was locked here
+  struct stat locked, current;
+  if ( ::fstat(fd, &locked) != 0 || ::stat(path.c_str(), &current) != 0 ||
+       locked.st_dev != current.st_dev || locked.st_ino != current.st_ino ) {
+    ::close(fd);
+    return false;
+  }
+  // rename is atomic and keeps the lock
+  boost::system::error_code error_code;
+  fs::rename(path, running_path, error_code);
+  if ( error_code ) {
+    ::close(fd);
+    return false;
+  }
+  running_fd_ = fd;
+  running_path_ = running_path;
+  return true;
+}
+
+bool WorkerQueue::NextFromSpool(std::vector<std::string> &arguments) {
+  const auto start = std::chrono::steady_clock::now();
+  auto read_arguments = [&]() {
+    std::ifstream ifs(running_path_);
+    std::string line;
+    while ( arguments.empty() && std::getline(ifs, line) )
+      arguments = SplitJobLine(line);
+    return !arguments.empty();
+  };
+  while ( true ) {
+    // Jobs are processed in the order of their names, those left by stopped workers first
+    std::vector<fs::path> jobs;
+    std::vector<fs::path> left_jobs;
+    for ( fs::directory_iterator it(spool_directory_), end; it != end; ++it ) {
+      if ( !fs::is_regular_file(it->status()) ) continue;
+      const std::string name = it->path().filename().string();
+      if ( it->path().extension() == ".job" )
+	jobs.push_back(it->path());
+      else if ( EndsWith(name, ".job" + RUNNING_SUFFIX) || EndsWith(name, ".job" + RECOVERED_SUFFIX) )
+	left_jobs.push_back(it->path());
+    }
+    std::sort(jobs.begin(), jobs.end());
+    std::sort(left_jobs.begin(), left_jobs.end());
+
+    for ( const auto &job : left_jobs ) {
+      const std::string path = job.string();
+      const bool is_recovered = EndsWith(path, RECOVERED_SUFFIX);
+      const std::string job_path = path.substr(0, path.size() - ( is_recovered ? RECOVERED_SUFFIX : RUNNING_SUFFIX ).size());
+      if ( !ClaimJob(path, job_path + RECOVERED_SUFFIX) ) continue;
+      job_path_ = job_path;
+      job_name_ = fs::path(job_path).filename().string() + " (recovered)";
+      if ( is_recovered ) {
+	Finish(false); // left twice
+	continue;
+      }
+      if ( read_arguments() )
+	return true;
+      Finish(false); // empty job file
+    }
+
+    for ( const auto &job : jobs ) {
+      // a job file still written in place is claimed later
+      if ( !IsCompleteJobFile(job.string()) ) continue;
+      if ( !ClaimJob(job.string(), job.string() + RUNNING_SUFFIX) ) continue;
+      job_path_ = job.string();
+      job_name_ = job.filename().string();
+      if ( read_arguments() )
+	return true;
+      Finish(false); // empty job file
+    }
+
+    const double idle_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if ( idle_time >= idle_timeout_ )
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  }
+}
+
+void WorkerQueue::Finish(bool success) {
+  if ( success ) number_of_succeeded_++;
+  else number_of_failed_++;
+  if ( is_spool_ && !running_path_.empty() ) {
+    boost::system::error_code error_code;
+    fs::rename(running_path_, job_path_ + ( success ? ".done" : ".failed" ), error_code);
+    running_path_.clear();
+    // the lock is released after the rename so that the job is not claimed again
+    ::close(running_fd_);
+    running_fd_ = -1;
+  }
+}
+
+const std::string &WorkerQueue::GetJobName() const {
+  return job_name_;
+}
+
+std::size_t WorkerQueue::GetNumberOfSucceeded() const {
+  return number_of_succeeded_;
+}
+
+std::size_t WorkerQueue::GetNumberOfFailed() const {
+  return number_of_failed_;
+}
@@ -0,0 +1,116 @@
+#ifndef WORKER_QUEUE_HH
+#define WORKER_QUEUE_HH
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <fstream>
+
+/**
+ * Queue of jobs consumed by the long-lived worker mode of the executables.
+ * One job is one line of whitespace separated arguments (e.g. input and output paths).
+ * Lines which are empty or start with '#' are ignored.
+ *
+ * Jobs are read either from a manifest (a file or stdin) or from a spool directory.
+ * In a spool directory, each "*.job" file holds one job line ended by a newline. Producers
+ * write the job to "*.job.tmp" and rename it to "*.job", so that a job is never read while
+ * written; a "*.job" file which is empty or does not end with a newline is not claimed yet.
+ * A worker claims a job by locking it and renaming it to "*.job.running" (so several
+ * workers can share a spool directory) and renames it to "*.job.done" or "*.job.failed"
+ * when finished. The lock
+ * is held until then and released by the system if the worker crashes, so a
+ * "*.job.running" file without lock is left by a stopped worker : the job is claimed
+ * again as "*.job.recovered.running". A recovered job left again is not retried (it may
+ * crash the workers) and is renamed to "*.job.failed". The worker stops when no new job
+ * appears within the idle timeout.
+ */
+class WorkerQueue {
+
+public :
+
+  /**
+   * Read jobs from a manifest
+   * @param manifest manifest file path ("-" : stdin)
+   */
+  explicit WorkerQueue(const std::string &manifest);
+
+  /**
+   * Read jobs from a spool directory
+   * @param spool_directory spool directory path
+   * @param idle_timeout time to wait for new jobs before stopping [s]
+   */
+  WorkerQueue(const std::string &spool_directory, double idle_timeout);
+
+  ~WorkerQueue();
+
+  WorkerQueue(const WorkerQueue&) = delete;
+  WorkerQueue &operator=(const WorkerQueue&) = delete;
+
+  /**
+   * Get next job. The previous job must be finished with Finish.
+   * @param arguments arguments of the job
+   * @return false if there is no more job
+   */
+  bool Next(std::vector<std::string> &arguments);
+
+  /**
+   * Finish the current job
+   * @param success true if the job succeeded
+   */
+  void Finish(bool success);
+
+  /**
+   * @return name of the current job (manifest line number or spool file name)
+   */
+  const std::string &GetJobName() const;
+
+  /**
+   * @return number of succeeded jobs
+   */
+  std::size_t GetNumberOfSucceeded() const;
+
+  /**
+   * @return number of failed jobs
+   */
+  std::size_t GetNumberOfFailed() const;
+
+private :
+
+  bool NextFromManifest(std::vector<std::string> &arguments);
+  bool NextFromSpool(std::vector<std::string> &arguments);
+
+  /**
+   * Claim a spool job file
+   * @param path job file path (*.job or *.job.running left by a stopped worker)
+   * @param running_path path of the claimed job
+   * @return true if the job is claimed (locked by this worker)
+   */
+  bool ClaimJob(const std::string &path, const std::string &running_path);
+
+  bool is_spool_;
+  std::ifstream manifest_file_;
+  std::istream *manifest_;
+  std::size_t line_number_;
+
+  std::string spool_directory_;
+  double idle_timeout_;
+  ///> path of the current job file without the state suffix ("*.job")
+  std::string job_path_;
+  std::string running_path_;
+  ///> lock of the current job file (-1 : no job)
+  int running_fd_;
+
+  std::string job_name_;
+  std::size_t number_of_succeeded_;
+  std::size_t number_of_failed_;
+
+};
+
+/**
+ * Split a job line into arguments
+ * @param line job line
+ * @return arguments (empty for blank or comment lines)
+ */
+std::vector<std::string> SplitJobLine(const std::string &line);
+
+#endif
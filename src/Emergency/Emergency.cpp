@@ -1,3 +1,5 @@
+#include <iostream>
+
 #include <B2Reader.hh>
 #include <B2SpillSummary.hh>
 #include <B2TrackSummary.hh>
@@ -5,6 +7,7 @@
 #include <B2HitSummary.hh>
 
 #include <NTBMSummary.hh>
+#include <NTBMStartupMarker.hh>
 
 bool MyHasDetector(const B2TrackSummary *track, B2Detector det) {
 
@@ -52,7 +55,7 @@ int main (int argc, char *argv[]) {
 
   TFile *ofile = new TFile(argv[3], "recreate");
   TTree *otree = new TTree("tree", "tree");
-  otree->Branch("NTBMSummary", &ntbm);
+  NTBMSummary::CreateBranch(otree, &ntbm);
 
   Int_t i_itree = 0;
 
@@ -76,6 +79,7 @@ int main (int argc, char *argv[]) {
 
     otree->Fill();
     ntbm->Clear("C");
+    MarkFirstSpill();
     i_itree++;
 
   }
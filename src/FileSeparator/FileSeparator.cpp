@@ -3,13 +3,20 @@
 #include <boost/log/trivial.hpp>
 #include <boost/log/expressions.hpp>
 
+// root includes
+#include <TROOT.h>
+
 // B2 includes
 #include "B2Reader.hh"
 
+#include "NTBMConst.hh"
+#include "NinjaTrackerReadAhead.hh"
+#include "NTBMStartupMarker.hh"
+
 namespace logging = boost::log;
 
 ///> number of slots used in the NINJA tracker
-const int NUM_SLOTS = 250;
+const int NUM_SLOTS = NUMBER_OF_SLOTS_IN_TRACKER;
 
 int main(int argc, char *argv[]) {
 
@@ -20,14 +27,19 @@ int main(int argc, char *argv[]) {
 
   BOOST_LOG_TRIVIAL(info) << "==========NINJA File Separator Start==========";
 
-  if (argc != 4) {
+  if (argc < 4 || argc > 6) {
     BOOST_LOG_TRIVIAL(error) << "Usage : " << argv[0]
-			     << " <input wagasci file path> <input ninja file path> <output ninja file path>";
+			     << " <input wagasci file path> <input ninja file path> <output ninja file path>"
+			     << " [<read-ahead depth (default 16, 0 : synchronous)> [<tree cache size in MB>]]";
     std::exit(1);
   }
 
   try {
 
+    const std::size_t read_ahead_depth = argc > 4 ? std::stoul(argv[4]) : 16;
+    const Long64_t tree_cache_size = argc > 5 ? std::stoll(argv[5]) * 1024 * 1024 : -1;
+    if (read_ahead_depth > 0) ROOT::EnableThreadSafety();
+
     B2Reader reader(argv[1]);
     TFile *input_nt_file = new TFile(argv[2], "read");
     TFile *output_nt_file = new TFile(argv[3], "recreate");
@@ -38,25 +50,18 @@ int main(int argc, char *argv[]) {
 
     // Tracker input file settings
     TTree *input_nt_tree = (TTree*)input_nt_file->Get("tree");
-
-    Int_t adc[NUM_SLOTS], tt[NUM_SLOTS], lt[NUM_SLOTS];
-    UInt_t unixtime[NUM_SLOTS];
-    Float_t pe[NUM_SLOTS];
-    Int_t view[NUM_SLOTS], pln[NUM_SLOTS], ch[NUM_SLOTS];
-
-    input_nt_tree->SetBranchAddress("ADC", adc);
-    input_nt_tree->SetBranchAddress("LEADTIME", lt);
-    input_nt_tree->SetBranchAddress("TRAILTIME", tt);
-    input_nt_tree->SetBranchAddress("UNIXTIME", unixtime);
-    input_nt_tree->SetBranchAddress("PE", pe);
-    input_nt_tree->SetBranchAddress("VIEW", view);
-    input_nt_tree->SetBranchAddress("PLN", pln);
-    input_nt_tree->SetBranchAddress("CH", ch);
+    // Entries are decoded in a background thread
+    NinjaTrackerReadAhead input_nt_reader(input_nt_tree, read_ahead_depth, tree_cache_size);
 
     BOOST_LOG_TRIVIAL(debug) << "Tracker input file setting done";
 
     // Tracker output file settings
     TTree *output_nt_tree = new TTree("tree", "tree");
+    NinjaTrackerEntry output_nt_entry;
+    Int_t *adc = output_nt_entry.adc, *tt = output_nt_entry.tt, *lt = output_nt_entry.lt;
+    UInt_t *unixtime = output_nt_entry.unixtime;
+    Float_t *pe = output_nt_entry.pe;
+    Int_t *view = output_nt_entry.view, *pln = output_nt_entry.pln, *ch = output_nt_entry.ch;
     
     output_nt_tree->Branch("ADC", adc, Form("ADC[%d]/I", NUM_SLOTS));
     output_nt_tree->Branch("LEADTIME", lt, Form("LEADTIME[%d]/I", NUM_SLOTS));
@@ -78,6 +83,7 @@ int main(int argc, char *argv[]) {
 	start_time = spill_summary.GetBeamSummary().GetTimestamp();
       }
       end_time = spill_summary.GetBeamSummary().GetTimestamp();
+      MarkFirstSpill();
     }
 
     BOOST_LOG_TRIVIAL(debug) << "Start Unixtime : " << start_time;
@@ -92,16 +98,20 @@ int main(int argc, char *argv[]) {
 
     BOOST_LOG_TRIVIAL(info) << "-----NINJA tracker data extraction start-----";
     
-    for (int nt_entry = 0; nt_entry < input_nt_tree->GetEntries(); nt_entry++) {
+    for (int nt_entry = 0; nt_entry < input_nt_reader.GetEntries(); nt_entry++) {
 
-      input_nt_tree->GetEntry(nt_entry);
-      
-      if ((int)unixtime[0] < start_time - 1 ||
-	  (int)unixtime[0] > end_time + 1) continue;
+      // Entries out of the time window are not decoded
+      if ((int)input_nt_reader.GetUnixtime(nt_entry) < start_time - 1 ||
+	  (int)input_nt_reader.GetUnixtime(nt_entry) > end_time + 1) continue;
+
+      output_nt_entry = input_nt_reader.GetEntry(nt_entry);
       
       output_nt_tree->Fill();
     }
 
+    BOOST_LOG_TRIVIAL(info) << "Tracker read-ahead (" << read_ahead_depth << " entries) : "
+			    << input_nt_reader.GetStatistics();
+
     output_nt_file->cd();
     output_nt_tree->Write();
     output_nt_file->Close();
@@ -0,0 +1,176 @@
+// system includes
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstring>
+
+// boost includes
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+
+// B2 includes
+#include <B2Enum.hh>
+#include "NTBMSummary.hh"
+#include "NTBMReader.hh"
+#include "NTBMFlatFile.hh"
+#include "NTBMStartupMarker.hh"
+
+namespace logging = boost::log;
+
+///> Members exported to the flat file
+const std::vector<std::string> EXPORTED_MEMBERS = {"entry_in_daily_file_", "bsd_spill_number_", "timestamp_",
+						   "number_of_tracks_", "ninja_track_type_", "momentum_type_",
+						   "momentum_", "baby_mind_position_", "baby_mind_tangent_",
+						   "charge_", "bunch_", "number_of_ninja_clusters_",
+						   "baby_mind_track_id_", "number_of_hits_", "bunch_difference_",
+						   "ninja_position_", "ninja_tangent_", "ninja_position_fallback_"};
+
+/**
+ * Records of all the exported spills
+ */
+struct FlatRecords {
+  std::vector<NTBMFlatSpill> spills;
+  std::vector<NTBMFlatTrack> tracks;
+  std::vector<NTBMFlatCluster> clusters;
+};
+
+/**
+ * Append the tracks and clusters of one spill
+ * @param ntbm NTBMSummary object
+ * @param records flat records
+ */
+void AppendSpill(const NTBMSummary &ntbm, FlatRecords &records) {
+  NTBMFlatSpill spill = {};
+  spill.timestamp = ntbm.GetTimestamp();
+  spill.bsd_spill_number = ntbm.GetBsdSpillNumber();
+  spill.entry_in_daily_file = ntbm.GetEntryInDailyFile();
+  spill.first_track = records.tracks.size();
+  spill.first_cluster = records.clusters.size();
+  spill.number_of_tracks = ntbm.GetNumberOfTracks();
+  spill.number_of_clusters = ntbm.GetNumberOfNinjaClusters();
+  const std::uint32_t spill_id = records.spills.size();
+
+  for ( int itrack = 0; itrack < ntbm.GetNumberOfTracks(); itrack++ ) {
+    NTBMFlatTrack track = {};
+    const std::vector<double> &position = ntbm.GetBabyMindPosition(itrack);
+    const std::vector<double> &tangent = ntbm.GetBabyMindTangent(itrack);
+    for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ ) {
+      track.baby_mind_position[iview] = position.at(iview);
+      track.baby_mind_tangent[iview] = tangent.at(iview);
+    }
+    track.momentum = ntbm.GetMomentum(itrack);
+    track.spill = spill_id;
+    track.ninja_track_type = ntbm.GetNinjaTrackType(itrack);
+    track.momentum_type = ntbm.GetMomentumType(itrack);
+    track.charge = ntbm.GetCharge(itrack);
+    track.bunch = ntbm.GetBunch(itrack);
+    records.tracks.push_back(track);
+  }
+
+  for ( int icluster = 0; icluster < ntbm.GetNumberOfNinjaClusters(); icluster++ ) {
+    NTBMFlatCluster cluster = {};
+    const std::vector<double> &position = ntbm.GetNinjaPosition(icluster);
+    const std::vector<double> &tangent = ntbm.GetNinjaTangent(icluster);
+    const std::vector<int> &number_of_hits = ntbm.GetNumberOfHits(icluster);
+    for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ ) {
+      cluster.ninja_position[iview] = position.at(iview);
+      cluster.ninja_tangent[iview] = tangent.at(iview);
+      cluster.number_of_hits[iview] = number_of_hits.at(iview);
+    }
+    cluster.spill = spill_id;
+    const int track_id = ntbm.GetBabyMindTrackId(icluster);
+    cluster.track = track_id < 0 ? -1 : (std::int32_t)( spill.first_track + track_id );
+    cluster.bunch_difference = ntbm.GetBunchDifference(icluster);
+    if ( ntbm.GetNinjaPositionFallback(icluster) )
+      cluster.flags |= kNTBMFlatPositionFallback;
+    if ( number_of_hits.at(B2View::kSideView) > 0 && number_of_hits.at(B2View::kTopView) > 0 )
+      cluster.flags |= kNTBMFlatMatched2d;
+    records.clusters.push_back(cluster);
+  }
+
+  records.spills.push_back(spill);
+}
+
+/**
+ * Write the flat file (header and the record arrays)
+ * @param path output file path
+ * @param records flat records
+ */
+void WriteFlatFile(const std::string &path, const FlatRecords &records) {
+  NTBMFlatHeader header = {};
+  std::memcpy(header.magic, "NTBMFLAT", sizeof(header.magic));
+  header.version = NTBM_FLAT_FILE_VERSION;
+  header.byte_order = NTBM_FLAT_FILE_BYTE_ORDER;
+  header.spill_record_size = sizeof(NTBMFlatSpill);
+  header.track_record_size = sizeof(NTBMFlatTrack);
+  header.cluster_record_size = sizeof(NTBMFlatCluster);
+  header.number_of_spills = records.spills.size();
+  header.number_of_tracks = records.tracks.size();
+  header.number_of_clusters = records.clusters.size();
+  // record sizes are multiples of 8 so that all the arrays stay aligned
+  header.spill_offset = sizeof(NTBMFlatHeader);
+  header.track_offset = header.spill_offset + records.spills.size() * sizeof(NTBMFlatSpill);
+  header.cluster_offset = header.track_offset + records.tracks.size() * sizeof(NTBMFlatTrack);
+
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  if ( !ofs.is_open() )
+    throw std::runtime_error("Cannot open output flat file : " + path);
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  ofs.write(reinterpret_cast<const char*>(records.spills.data()), records.spills.size() * sizeof(NTBMFlatSpill));
+  ofs.write(reinterpret_cast<const char*>(records.tracks.data()), records.tracks.size() * sizeof(NTBMFlatTrack));
+  ofs.write(reinterpret_cast<const char*>(records.clusters.data()),
+	    records.clusters.size() * sizeof(NTBMFlatCluster));
+  if ( !ofs )
+    throw std::runtime_error("Cannot write output flat file : " + path);
+}
+
+// main function
+int main(int argc, char *argv[]) {
+
+  logging::core::get()->set_filter
+    (
+     logging::trivial::severity >= logging::trivial::info
+     );
+
+  BOOST_LOG_TRIVIAL(info) << "==========NINJA Flat Export Start==========";
+
+  if ( argc < 3 ) {
+    BOOST_LOG_TRIVIAL(error) << "Usage : " << argv[0]
+			     << " <output flat file path> <input NTBM file path> [<input NTBM file path> ...]";
+    std::exit(1);
+  }
+
+  try {
+
+    // the spills of all the input files (e.g. a run period) are written in one flat file
+    FlatRecords records;
+    for ( int iarg = 2; iarg < argc; iarg++ ) {
+      NTBMReader reader(argv[iarg], EXPORTED_MEMBERS);
+      for ( Long64_t ientry = 0; ientry < reader.GetEntries(); ientry++ ) {
+	reader.GetEntry(ientry);
+	AppendSpill(*reader.GetNTBMSummary(), records);
+	MarkFirstSpill();
+      }
+      BOOST_LOG_TRIVIAL(info) << "Input : " << argv[iarg] << " (" << reader.GetEntries() << " spills)";
+    }
+
+    WriteFlatFile(argv[1], records);
+    BOOST_LOG_TRIVIAL(info) << "Output : " << argv[1] << " (" << records.spills.size() << " spills, "
+			    << records.tracks.size() << " tracks, " << records.clusters.size() << " clusters)";
+
+  } catch (const std::runtime_error &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Runtime error : " << error.what();
+    std::exit(1);
+  } catch (const std::invalid_argument &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Invalid argument error : " << error.what();
+    std::exit(1);
+  } catch (const std::out_of_range &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Out of range error : " << error.what();
+    std::exit(1);
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "==========NINJA Flat Export Finish==========";
+  std::exit(0);
+
+}
@@ -1,5 +1,7 @@
 // system includes
 #include <vector>
+#include <string>
+#include <memory>
 
 // boost includes
 #include <boost/log/core.hpp>
@@ -9,11 +11,12 @@
 // root includes
 #include <TFile.h>
 #include <TTree.h>
+#include <TROOT.h>
 
 // B2 includes
 #include "B2Reader.hh"
 #include "B2Writer.hh"
-#include "B2Dimension.hh"
+#include "B2Const.hh"
 #include "B2Enum.hh"
 #include "B2Measurement.hh"
 #include "B2HitSummary.hh"
@@ -21,30 +24,37 @@
 #include "B2BeamSummary.hh"
 
 #include "NTBMConst.hh"
+#include "NinjaTrackerReadAhead.hh"
+#include "NinjaGeometry.hh"
+#include "WorkerQueue.hh"
+#include "NTBMStartupMarker.hh"
 
 namespace logging = boost::log;
 
+///> Default time to wait for new jobs in the spool directory before stopping in the worker mode
+const double DEFAULT_SPOOL_IDLE_TIMEOUT = 60.; // s
+
 /**
  * Get corresponding NINJA spill number (entry number in the NINJA tracker root file)
  * to the WAGASCI spill summary
  * @param output_spill_summary WAGASCI/BabyMIND spill summary
- * @param tree TTree in the NINJA tracker root file
+ * @param ntreader NINJA tracker root file reader (only the unixtime index is used)
  * @param start # of entry to start (not to consider already assigned entries)
  * @return corresponding entry number in the root file
  */
-Int_t GetNinjaSpill(const B2SpillSummary &output_spill_summary, TTree *tree, Int_t start,
-		    UInt_t ut[NUMBER_OF_SLOTS_IN_TRACKER]) {
+Int_t GetNinjaSpill(const B2SpillSummary &output_spill_summary, const NinjaTrackerReadAhead &ntreader,
+		    Int_t start) {
 
   const Double_t wagasci_time = output_spill_summary.GetBeamSummary().GetTimestamp();
 
   BOOST_LOG_TRIVIAL(debug) << "Getting NINJA entry # for BSD unixtime :  "
 			   << (Int_t) wagasci_time;
 
-  for(int ientry = start; ientry < tree->GetEntries(); ientry++) {
-    tree->GetEntry(ientry);
-    if(std::fabs(((Int_t)ut[0] - (Int_t)wagasci_time)) < 2) { // Check proper cast TODO
+  for(int ientry = start; ientry < ntreader.GetEntries(); ientry++) {
+    const UInt_t ut = ntreader.GetUnixtime(ientry);
+    if(std::fabs(((Int_t)ut - (Int_t)wagasci_time)) < 2) { // Check proper cast TODO
       BOOST_LOG_TRIVIAL(debug) << "Found NINJA entry # " << ientry
-			       << ": Unixtime : " << ut[0];
+			       << ": Unixtime : " << ut;
       return ientry;
     }
   }
@@ -122,8 +132,8 @@ void AddNinjaAsHitSummary(B2SpillSummary &output_spill_summary,
       B2View::kTopView : B2View::kSideView;
     output_hit_summary.SetView(ninja_view);
     TVector3 pos, err;	
-    B2Dimension::GetPosNinjaTracker(ninja_view, (UInt_t) pln[slot], (UInt_t) ch[slot], pos);
-    B2Dimension::GetErrorNinja(ninja_view, err);
+    GetNinjaTrackerPosition(ninja_view, (UInt_t) pln[slot], (UInt_t) ch[slot], pos);
+    GetNinjaTrackerError(ninja_view, err);
     output_hit_summary.SetScintillatorPosition(B2Position(pos, err));
     output_hit_summary.SetReconRelativePosition(B2Position(pos, err));
     B2ScintillatorType scintillator_type = (view[slot] == B2View::kTopView) ?
@@ -146,6 +156,99 @@ void AddNinjaAsHitSummary(B2SpillSummary &output_spill_summary,
   
 }
 
+/**
+ * Convert NINJA tracker hits of one day into B2HitSummary
+ * @param wagasci_file input WAGASCI file path
+ * @param ninja_file input NINJA tracker file path
+ * @param output_file output file path
+ * @param subrunid subrun 0(2019)/1(2020)
+ * @param read_ahead_depth number of tracker entries decoded ahead
+ * @param tree_cache_size TTreeCache size of the tracker tree in bytes (negative : ROOT default)
+ */
+void ConvertFile(const std::string &wagasci_file, const std::string &ninja_file,
+		 const std::string &output_file, Int_t subrunid,
+		 std::size_t read_ahead_depth, Long64_t tree_cache_size) {
+
+  B2Reader reader(wagasci_file);
+  // the file is also closed when a job of the worker mode fails
+  std::unique_ptr<TFile> ntfile(new TFile(ninja_file.c_str(), "read"));
+  B2Writer writer(output_file, reader);
+  BOOST_LOG_TRIVIAL(info) << "-----Settings Summary-----";
+  BOOST_LOG_TRIVIAL(info) << "Reader  file : " << wagasci_file;
+  BOOST_LOG_TRIVIAL(info) << "Tracker file : " << ninja_file;
+  BOOST_LOG_TRIVIAL(info) << "Writer  file : " << output_file;
+  BOOST_LOG_TRIVIAL(info) << "Subrun id    : " << subrunid;
+
+  // Tracker file settings
+  BOOST_LOG_TRIVIAL(info) << "Tracker file tree setting...";
+  TTree *nttree = (TTree*)ntfile->Get("tree");
+  if (!nttree)
+    throw std::runtime_error("Tracker tree not found : " + ninja_file);
+  // Matched entries are decoded in a background thread
+  NinjaTrackerReadAhead ntreader(nttree, read_ahead_depth, tree_cache_size);
+  BOOST_LOG_TRIVIAL(info) << "done!";
+
+  Int_t ntentry = 0; // Tracker file entry
+  const Int_t ntentry_max = ntreader.GetEntries();
+
+  while (reader.ReadNextSpill() > 0 && ntentry < ntentry_max) {
+
+    auto &output_spill_summary = writer.GetSpillSummary();
+    auto &beam_summary = output_spill_summary.GetBeamSummary();
+    // Get corresponding NINJA entry
+    Int_t ntentry_tmp = GetNinjaSpill(output_spill_summary, ntreader, ntentry);
+
+    // Add NINJA entry as B2HitSummary
+    if (ntentry_tmp > 0) {
+      NinjaTrackerEntry &ntdata = ntreader.GetEntry(ntentry_tmp);
+      ntentry = ntentry_tmp + 1;
+      AddNinjaAsHitSummary(output_spill_summary, ntdata.lt, ntdata.tt, ntdata.pe,
+			   ntdata.view, ntdata.pln, ntdata.ch, subrunid);
+      beam_summary.EnableDetector(B2Detector::kNinja);
+    }
+    else {
+      beam_summary.DisableDetector(B2Detector::kNinja);
+    }
+    writer.Fill();
+    MarkFirstSpill();
+
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "Tracker read-ahead (" << read_ahead_depth << " entries) : "
+			  << ntreader.GetStatistics();
+
+}
+
+/**
+ * Long-lived worker mode : convert the files in the queue with the same initialized state
+ * @param queue job queue, one job is "<input wagasci file> <input ninja file> <output file> <subrun>"
+ * @param read_ahead_depth number of tracker entries decoded ahead
+ * @param tree_cache_size TTreeCache size of the tracker tree in bytes (negative : ROOT default)
+ * @return true if all jobs succeeded
+ */
+bool RunWorker(WorkerQueue &queue, std::size_t read_ahead_depth, Long64_t tree_cache_size) {
+
+  std::vector<std::string> arguments;
+  while (queue.Next(arguments)) {
+    BOOST_LOG_TRIVIAL(info) << "-----Job " << queue.GetJobName() << "-----";
+    try {
+      if (arguments.size() != 4)
+	throw std::invalid_argument("Job should be <input wagasci file> <input ninja file> <output file> <subrun>");
+      ConvertFile(arguments.at(0), arguments.at(1), arguments.at(2), std::stoi(arguments.at(3)),
+		  read_ahead_depth, tree_cache_size);
+      queue.Finish(true);
+    } catch (const std::exception &error) {
+      // any error of one job (e.g. out_of_range of a bad subrun id) must not stop the worker
+      BOOST_LOG_TRIVIAL(error) << "Job " << queue.GetJobName() << " failed : " << error.what();
+      queue.Finish(false);
+    }
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "Worker jobs : " << queue.GetNumberOfSucceeded() << " succeeded, "
+			  << queue.GetNumberOfFailed() << " failed";
+  return queue.GetNumberOfFailed() == 0;
+}
+
 // main function
 int main(int argc, char *argv[]) {
 
@@ -156,64 +259,44 @@ int main(int argc, char *argv[]) {
   
   BOOST_LOG_TRIVIAL(info) << "==========NINJA Hit Converter Start==========";
 
-  if (argc != 5) {
+  // worker mode : HitConverter --manifest <manifest>|--spool <directory> [--spool-idle-timeout <s>]
+  //               [<read-ahead depth> [<tree cache size>]]
+  const bool is_worker = argc > 2 &&
+    (std::string(argv[1]) == "--manifest" || std::string(argv[1]) == "--spool");
+  const bool has_idle_timeout = is_worker && argc > 4 && std::string(argv[3]) == "--spool-idle-timeout";
+  const int first_option = is_worker ? (has_idle_timeout ? 5 : 3) : 5;
+
+  if ((!is_worker && (argc < 5 || argc > 7)) || (is_worker && argc > first_option + 2) ||
+      (has_idle_timeout && std::string(argv[1]) != "--spool")) {
     BOOST_LOG_TRIVIAL(error) << "Usage : "<< argv[0]
-			     << " <input wagasci file path> <input ninja file path> <output file path> <subrun 0(2019)/1(2020)>";
+			     << " <input wagasci file path> <input ninja file path> <output file path> <subrun 0(2019)/1(2020)>"
+			     << " [<read-ahead depth (default 16, 0 : synchronous)> [<tree cache size in MB>]]";
+    BOOST_LOG_TRIVIAL(error) << "Worker mode : "<< argv[0]
+			     << " --manifest <manifest file path (- : stdin)>"
+			     << " | --spool <spool directory> [--spool-idle-timeout <s (default 60)>]"
+			     << " [<read-ahead depth> [<tree cache size in MB>]]";
+    BOOST_LOG_TRIVIAL(error) << "(one job is \"<input wagasci file path> <input ninja file path> <output file path> <subrun>\")";
     std::exit(1);
   }
 
   try {
-    B2Reader reader(argv[1]);
-    TFile *ntfile = new TFile(argv[2], "read");
-    B2Writer writer(argv[3], reader);
-    Int_t subrunid = atoi(argv[4]);
-    BOOST_LOG_TRIVIAL(info) << "-----Settings Summary-----";
-    BOOST_LOG_TRIVIAL(info) << "Reader  file : " << argv[1];
-    BOOST_LOG_TRIVIAL(info) << "Tracker file : " << argv[2];
-    BOOST_LOG_TRIVIAL(info) << "Writer  file : " << argv[3];
-    BOOST_LOG_TRIVIAL(info) << "Subrun id    : " << argv[4];
-
-    // Tracker file settings
-    BOOST_LOG_TRIVIAL(info) << "Tracker file tree setting...";
-    TTree *nttree = (TTree*)ntfile->Get("tree");
-
-    Int_t adc[NUMBER_OF_SLOTS_IN_TRACKER], tt[NUMBER_OF_SLOTS_IN_TRACKER], lt[NUMBER_OF_SLOTS_IN_TRACKER];
-    UInt_t unixtime[NUMBER_OF_SLOTS_IN_TRACKER];
-    Float_t pe[NUMBER_OF_SLOTS_IN_TRACKER];
-    Int_t view[NUMBER_OF_SLOTS_IN_TRACKER], pln[NUMBER_OF_SLOTS_IN_TRACKER], ch[NUMBER_OF_SLOTS_IN_TRACKER];
-    
-    nttree->SetBranchAddress("ADC", adc);
-    nttree->SetBranchAddress("LEADTIME", lt);
-    nttree->SetBranchAddress("TRAILTIME", tt);
-    nttree->SetBranchAddress("UNIXTIME", unixtime);
-    nttree->SetBranchAddress("PE", pe);
-    nttree->SetBranchAddress("VIEW", view);
-    nttree->SetBranchAddress("PLN", pln);
-    nttree->SetBranchAddress("CH", ch);
-    BOOST_LOG_TRIVIAL(info) << "done!";
-
-    Int_t ntentry = 0; // Tracker file entry
-    const Int_t ntentry_max = nttree->GetEntries();
-
-    while (reader.ReadNextSpill() > 0 && ntentry < ntentry_max) {
-
-      auto &output_spill_summary = writer.GetSpillSummary();
-      auto &beam_summary = output_spill_summary.GetBeamSummary();
-      // Get corresponding NINJA entry
-      Int_t ntentry_tmp = GetNinjaSpill(output_spill_summary, nttree, ntentry, unixtime);
-      
-      // Add NINJA entry as B2HitSummary
-      if (ntentry_tmp > 0) {
-	nttree->GetEntry(ntentry_tmp);
-	ntentry = ntentry_tmp + 1;
-	AddNinjaAsHitSummary(output_spill_summary, lt, tt, pe, view, pln, ch, subrunid);
-	beam_summary.EnableDetector(B2Detector::kNinja);
-      }
-      else {
-	beam_summary.DisableDetector(B2Detector::kNinja);
-      }
-      writer.Fill();
-      
+    const std::size_t read_ahead_depth = argc > first_option ? std::stoul(argv[first_option]) : 16;
+    const Long64_t tree_cache_size = argc > first_option + 1 ?
+      std::stoll(argv[first_option + 1]) * 1024 * 1024 : -1;
+    if (read_ahead_depth > 0) ROOT::EnableThreadSafety();
+
+    if (is_worker) {
+      // ROOT, dictionaries and geometry are initialized once for all the jobs
+      std::unique_ptr<WorkerQueue> queue;
+      if (std::string(argv[1]) == "--manifest")
+	queue.reset(new WorkerQueue(argv[2]));
+      else
+	queue.reset(new WorkerQueue(argv[2], has_idle_timeout ? std::stod(argv[4]) : DEFAULT_SPOOL_IDLE_TIMEOUT));
+      if (!RunWorker(*queue, read_ahead_depth, tree_cache_size))
+	std::exit(1);
+    }
+    else {
+      ConvertFile(argv[1], argv[2], argv[3], atoi(argv[4]), read_ahead_depth, tree_cache_size);
     }
   
   } catch (const std::runtime_error &error) {
@@ -222,6 +305,9 @@ int main(int argc, char *argv[]) {
   } catch (const std::invalid_argument &error) {
     BOOST_LOG_TRIVIAL(fatal) << "Invalid argument error : " << error.what();
     std::exit(1);
+  } catch (const std::out_of_range &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Out of range error : " << error.what();
+    std::exit(1);
   }
 
   BOOST_LOG_TRIVIAL(info) << "==========NINJA Hit Converter Finish==========";
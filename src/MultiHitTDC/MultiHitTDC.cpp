@@ -12,6 +12,8 @@
 #include <TH2D.h>
 #include <TCanvas.h>
 
+#include "NTBMStartupMarker.hh"
+
 namespace logging = boost::log;
 
 ///> number of slosts used in the NINJA tracker
@@ -56,6 +58,7 @@ int main (int argc, char *argv[]) {
 	if (islot == 50 || islot == 115) continue;
 	h_lt->Fill(lt[islot]);
       }
+      MarkFirstSpill();
     }
 
     TCanvas *c = new TCanvas("c","c");
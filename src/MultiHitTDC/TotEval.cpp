@@ -11,10 +11,11 @@
 // B2 includes
 #include <B2Reader.hh>
 #include <B2Enum.hh>
-#include <B2Dimension.hh>
 #include <B2SpillSummary.hh>
 #include <B2HitSummary.hh>
 
+#include "NTBMStartupMarker.hh"
+
 namespace logging = boost::log;
 
 int main (int argc, char*argv[]) {
@@ -65,6 +66,7 @@ int main (int argc, char*argv[]) {
 	  } // readout
 	} // hit
       } // fi
+      MarkFirstSpill();
     } // while
 
     c->cd();
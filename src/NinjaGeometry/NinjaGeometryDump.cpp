@@ -0,0 +1,76 @@
+// system includes
+#include <fstream>
+
+// boost includes
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+
+// B2 includes
+#include <B2Enum.hh>
+#include <B2Dimension.hh>
+#include <B2Measurement.hh>
+
+#include "NTBMConst.hh"
+#include "NinjaGeometry.hh"
+
+namespace logging = boost::log;
+
+/*
+ * Dump the NINJA tracker geometry of B2Dimension into the table read by the
+ * lightweight (Geant4-free) build. Only built with NINJA_RECON_WITH_GEANT4=ON.
+ */
+
+int main(int argc, char *argv[]) {
+
+  logging::core::get()->set_filter
+    (
+     logging::trivial::severity >= logging::trivial::info
+     );
+
+  BOOST_LOG_TRIVIAL(info) << "==========NINJA Geometry Dump Start==========";
+
+  if ( argc != 2 ) {
+    BOOST_LOG_TRIVIAL(error) << "Usage : " << argv[0]
+			     << " <output geometry table path>";
+    std::exit(1);
+  }
+
+  try {
+
+    TVector3 position[NUMBER_OF_VIEWS][NUMBER_OF_PLANES][NUMBER_OF_SLOTS_IN_PLANE];
+    TVector3 error[NUMBER_OF_VIEWS];
+    bool dead[NUMBER_OF_VIEWS][NUMBER_OF_PLANES][NUMBER_OF_SLOTS_IN_PLANE];
+
+    for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ ) {
+      const B2ScintillatorType scintillator_type = iview == B2View::kTopView ?
+	B2ScintillatorType::kVertical : B2ScintillatorType::kHorizontal;
+      for ( int iplane = 0; iplane < NUMBER_OF_PLANES; iplane++ ) {
+	const B2Readout readout = detector_to_single_readout(B2Detector::kNinja, scintillator_type, iplane);
+	for ( int islot = 0; islot < NUMBER_OF_SLOTS_IN_PLANE; islot++ ) {
+	  B2Dimension::GetPosNinjaTracker((B2View)iview, iplane, islot, position[iview][iplane][islot]);
+	  dead[iview][iplane][islot] = B2Dimension::CheckDeadChannel(B2Detector::kNinja, (B2View)iview,
+								     readout, iplane, islot);
+	}
+      }
+      B2Dimension::GetErrorNinja((B2View)iview, error[iview]);
+    }
+
+    std::ofstream ofs(argv[1]);
+    if ( !ofs )
+      throw std::runtime_error("Failed to open output file : " + std::string(argv[1]));
+    WriteNinjaGeometryTable(ofs, position, error, dead);
+    BOOST_LOG_TRIVIAL(info) << "Geometry table written : " << argv[1];
+
+  } catch (const std::runtime_error &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Runtime error : " << error.what();
+    std::exit(1);
+  } catch (const std::invalid_argument &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Invalid argument error : " << error.what();
+    std::exit(1);
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "==========NINJA Geometry Dump Finish==========";
+  std::exit(0);
+
+}
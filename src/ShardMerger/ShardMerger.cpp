@@ -0,0 +1,262 @@
+// system includes
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <map>
+
+// boost includes
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+
+// root includes
+#include <TFile.h>
+#include <TTree.h>
+#include <TKey.h>
+#include <TParameter.h>
+
+#include "NTBMSummary.hh"
+#include "NTBMSkim.hh"
+#include "NTBMStartupMarker.hh"
+
+namespace logging = boost::log;
+
+/**
+ * Summary of one NTBM shard file created by TrackMatch with --first-entry/--last-entry
+ */
+struct NtbmShard {
+  std::string path;
+  TFile *file;
+  ///> one NTBM tree for each z shift
+  std::vector<TTree*> trees;
+  ///> z shift parameters (z_shift_<i>) of the trees [mm]
+  std::map<std::string, double> z_shifts;
+  ///> entry range in the daily file (both ends included)
+  Long64_t first_entry;
+  Long64_t last_entry;
+  ///> number of entries in the daily file
+  Long64_t number_of_entries;
+  ///> entry_in_daily_file of the first/last NTBMSummary in the shard
+  int first_entry_in_daily_file;
+  int last_entry_in_daily_file;
+};
+
+/**
+ * Get TParameter value written by TrackMatch
+ * @param file shard file
+ * @param name parameter name
+ * @return parameter value
+ */
+Long64_t GetShardParameter(TFile *file, const char *name) {
+  auto *parameter = dynamic_cast<TParameter<Long64_t>*>(file->Get(name));
+  if ( parameter == nullptr )
+    throw std::runtime_error(std::string("Shard parameter not found : ") + name
+			     + " in " + file->GetName());
+  return parameter->GetVal();
+}
+
+/**
+ * Get NTBM tree name written by TrackMatch
+ * @param ishift z shift id
+ * @param number_of_z_shifts number of z shifts in the file
+ * @return tree name
+ */
+std::string GetNtbmTreeName(int ishift, int number_of_z_shifts) {
+  if ( number_of_z_shifts == 1 ) return "tree";
+  return "tree_zshift" + std::to_string(ishift);
+}
+
+/**
+ * Open the shard file and check entry_in_daily_file is continuous inside the shard.
+ * Only the entry_in_daily_file_ branch is read.
+ * @param path shard file path
+ * @return shard summary
+ */
+NtbmShard OpenShard(const std::string &path) {
+  NtbmShard shard;
+  shard.path = path;
+  shard.file = new TFile(path.c_str(), "read");
+  if ( shard.file->IsZombie() )
+    throw std::runtime_error("Cannot open shard file : " + path);
+  int number_of_z_shifts = 1;
+  if ( auto *parameter = dynamic_cast<TParameter<int>*>(shard.file->Get("number_of_z_shifts")) )
+    number_of_z_shifts = parameter->GetVal();
+  for ( int ishift = 0; ishift < number_of_z_shifts; ishift++ ) {
+    const std::string tree_name = GetNtbmTreeName(ishift, number_of_z_shifts);
+    const TKey *key = shard.file->GetKey(tree_name.c_str());
+    if ( key != nullptr && std::string(key->GetClassName()) != "TTree" )
+      throw std::runtime_error("Only TTree shards can be merged (not " + std::string(key->GetClassName())
+			       + ") : " + path);
+    TTree *tree = (TTree*)shard.file->Get(tree_name.c_str());
+    if ( tree == nullptr )
+      throw std::runtime_error("NTBM tree " + tree_name + " not found in " + path);
+    shard.trees.push_back(tree);
+    const std::string z_shift_name = "z_shift_" + std::to_string(ishift);
+    if ( auto *z_shift = dynamic_cast<TParameter<double>*>(shard.file->Get(z_shift_name.c_str())) )
+      shard.z_shifts[z_shift_name] = z_shift->GetVal();
+  }
+  // All the trees are filled once per spill
+  TTree *tree = shard.trees.front();
+
+  shard.first_entry = GetShardParameter(shard.file, "first_entry");
+  shard.last_entry = GetShardParameter(shard.file, "last_entry");
+  shard.number_of_entries = GetShardParameter(shard.file, "number_of_entries");
+
+  const Long64_t number_of_shard_entries = tree->GetEntries();
+  if ( number_of_shard_entries != shard.last_entry - shard.first_entry + 1 )
+    throw std::runtime_error("Shard " + path + " has " + std::to_string(number_of_shard_entries)
+			     + " entries while its range is " + std::to_string(shard.first_entry)
+			     + " - " + std::to_string(shard.last_entry));
+
+  NTBMSummary *ntbm = nullptr;
+  NTBMSummary::SetBranchAddress(tree, &ntbm, {"entry_in_daily_file_"});
+  for ( Long64_t ientry = 0; ientry < number_of_shard_entries; ientry++ ) {
+    tree->GetEntry(ientry);
+    if ( ientry == 0 )
+      shard.first_entry_in_daily_file = ntbm->GetEntryInDailyFile();
+    else if ( ntbm->GetEntryInDailyFile() != shard.last_entry_in_daily_file + 1 )
+      throw std::runtime_error("Entry in daily file is not continuous in " + path + " : "
+			       + std::to_string(shard.last_entry_in_daily_file) + " -> "
+			       + std::to_string(ntbm->GetEntryInDailyFile()));
+    shard.last_entry_in_daily_file = ntbm->GetEntryInDailyFile();
+  }
+  tree->ResetBranchAddresses();
+  tree->SetBranchStatus("*", true);
+  delete ntbm;
+
+  BOOST_LOG_TRIVIAL(info) << "Shard : " << path << " : entries "
+			  << shard.first_entry << " - " << shard.last_entry;
+
+  return shard;
+}
+
+bool CompareShards(const NtbmShard &lhs, const NtbmShard &rhs) {
+  return lhs.first_entry < rhs.first_entry;
+}
+
+// main function
+int main(int argc, char *argv[]) {
+
+  logging::core::get()->set_filter
+    (
+     logging::trivial::severity >= logging::trivial::info
+     );
+
+  BOOST_LOG_TRIVIAL(info) << "==========NINJA Shard Merger Start==========";
+
+  if ( argc < 3 ) {
+    BOOST_LOG_TRIVIAL(error) << "Usage : " << argv[0]
+			     << " <output NTBM file path> <input NTBM shard file path> [<input NTBM shard file path> ...]";
+    std::exit(1);
+  }
+
+  try {
+
+    std::vector<NtbmShard> shards;
+    for ( int iarg = 2; iarg < argc; iarg++ )
+      shards.push_back(OpenShard(argv[iarg]));
+    std::sort(shards.begin(), shards.end(), CompareShards);
+
+    // Check the shards cover the whole daily file without gaps or overlaps
+    const Long64_t number_of_entries = shards.front().number_of_entries;
+    if ( shards.front().first_entry != 0 )
+      throw std::runtime_error("Gap at the beginning of the daily file : first shard starts from "
+			       + std::to_string(shards.front().first_entry));
+    for ( std::size_t ishard = 1; ishard < shards.size(); ishard++ ) {
+      const NtbmShard &previous = shards.at(ishard - 1);
+      const NtbmShard &current = shards.at(ishard);
+      if ( current.number_of_entries != number_of_entries ||
+	   current.trees.size() != previous.trees.size() )
+	throw std::runtime_error("Shards come from different daily files : " + previous.path
+				 + ", " + current.path);
+      if ( current.z_shifts != previous.z_shifts )
+	throw std::runtime_error("Shards are matched with different z shifts : " + previous.path
+				 + ", " + current.path);
+      if ( current.first_entry > previous.last_entry + 1 )
+	throw std::runtime_error("Gap between shards : " + previous.path + " and " + current.path);
+      if ( current.first_entry < previous.last_entry + 1 )
+	throw std::runtime_error("Overlap between shards : " + previous.path + " and " + current.path);
+      if ( current.first_entry_in_daily_file != previous.last_entry_in_daily_file + 1 )
+	throw std::runtime_error("Entry in daily file is not continuous between shards : "
+				 + previous.path + " and " + current.path);
+    }
+    if ( shards.back().last_entry != number_of_entries - 1 )
+      throw std::runtime_error("Gap at the end of the daily file : last shard ends at "
+			       + std::to_string(shards.back().last_entry));
+
+    // Baskets are copied as they are when possible (no deserialization of NTBMSummary)
+    TFile *output_file = new TFile(argv[1], "recreate");
+    if ( output_file->IsZombie() )
+      throw std::runtime_error("Cannot create output file : " + std::string(argv[1]));
+    const int number_of_z_shifts = shards.front().trees.size();
+    for ( int ishift = 0; ishift < number_of_z_shifts; ishift++ ) {
+      TTree *output_tree = shards.front().trees.at(ishift)->CloneTree(0);
+      output_tree->SetDirectory(output_file);
+      for ( const auto &shard : shards ) {
+	output_tree->CopyEntries(shard.trees.at(ishift), -1, "fast");
+	MarkFirstSpill();
+      }
+      output_file->cd();
+      output_tree->Write();
+    }
+
+    // Entries with matched 2d clusters, shifted by the entries of the previous shards
+    // (not written by older TrackMatch, then the merged file has no skim either)
+    for ( int ishift = 0; ishift < number_of_z_shifts; ishift++ ) {
+      const std::string tree_name = GetNtbmTreeName(ishift, number_of_z_shifts);
+      NTBMSkim merged_skim(tree_name);
+      bool has_skim = true;
+      Long64_t offset = 0;
+      for ( const auto &shard : shards ) {
+	NTBMSkim shard_skim(tree_name);
+	if ( !shard_skim.Read(*shard.file) ) {
+	  BOOST_LOG_TRIVIAL(warning) << "No skim of " << tree_name << " in " << shard.path
+				     << ", the merged file has no skim";
+	  has_skim = false;
+	  break;
+	}
+	merged_skim.Add(shard_skim, offset);
+	offset += shard.last_entry - shard.first_entry + 1;
+      }
+      output_file->cd();
+      if ( has_skim )
+	merged_skim.Write();
+    }
+
+    // Copy the z shift information (the same in all the shards)
+    output_file->cd();
+    TParameter<int>("number_of_z_shifts", number_of_z_shifts).Write();
+    for ( const auto &z_shift : shards.front().z_shifts )
+      TParameter<double>(z_shift.first.c_str(), z_shift.second).Write();
+    TParameter<Long64_t>("first_entry", 0).Write();
+    TParameter<Long64_t>("last_entry", number_of_entries - 1).Write();
+    TParameter<Long64_t>("number_of_entries", number_of_entries).Write();
+    // Spills over the position reconstruction budget (not written by older TrackMatch)
+    Long64_t number_of_fallback_spills = 0;
+    bool has_fallback_spills = false;
+    for ( const auto &shard : shards )
+      if ( auto *parameter = dynamic_cast<TParameter<Long64_t>*>(shard.file->Get("number_of_fallback_spills")) ) {
+	number_of_fallback_spills += parameter->GetVal();
+	has_fallback_spills = true;
+      }
+    if ( has_fallback_spills )
+      TParameter<Long64_t>("number_of_fallback_spills", number_of_fallback_spills).Write();
+    output_file->Close();
+
+    for ( auto &shard : shards )
+      shard.file->Close();
+
+    BOOST_LOG_TRIVIAL(info) << shards.size() << " shards merged into " << argv[1];
+
+  } catch (const std::runtime_error &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Runtime error : " << error.what();
+    std::exit(1);
+  } catch (const std::invalid_argument &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Invalid argument error : " << error.what();
+    std::exit(1);
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "==========NINJA Shard Merger Finish==========";
+  std::exit(0);
+
+}
@@ -0,0 +1,133 @@
+// system includes
+#include <vector>
+#include <string>
+#include <memory>
+
+// boost includes
+#include <boost/program_options.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+
+// root includes
+#include <TError.h>
+
+#include "NTBMSummary.hh"
+#include "NTBMReader.hh"
+#include "NTBMSpillIndex.hh"
+#include "NTBMStartupMarker.hh"
+
+namespace logging = boost::log;
+namespace po = boost::program_options;
+
+/*
+ * Index of the spills of all the daily NTBM files by BSD spill number and timestamp.
+ * The daily files are added to the index as they are processed and a spill is looked
+ * up without scanning the files : only its file is opened and only its entry is read.
+ */
+
+/**
+ * Print the spills, each NTBM file is opened once
+ * @param locations spill locations
+ * @param locate_only only the locations are printed, the NTBM files are not opened
+ */
+void PrintSpills(const std::vector<NTBMSpillLocation> &locations, bool locate_only) {
+  std::unique_ptr<NTBMReader> reader;
+  std::string reader_path;
+  for ( const auto &location : locations ) {
+    BOOST_LOG_TRIVIAL(info) << "BSD spill number : " << location.bsd_spill_number
+			    << ", timestamp : " << (int)location.timestamp
+			    << " -> " << location.path << " : " << location.tree_name
+			    << " entry " << location.entry;
+    if ( locate_only ) continue;
+    if ( reader == nullptr || location.path + ":" + location.tree_name != reader_path ) {
+      reader.reset();
+      reader.reset(new NTBMReader(location.path, std::vector<std::string>(), location.tree_name));
+      reader_path = location.path + ":" + location.tree_name;
+    }
+    reader->GetEntry(location.entry);
+    BOOST_LOG_TRIVIAL(info) << *reader->GetNTBMSummary();
+    MarkFirstSpill();
+  }
+}
+
+// main function
+int main(int argc, char *argv[]) {
+
+  gErrorIgnoreLevel = kError;
+
+  logging::core::get()->set_filter
+    (
+     logging::trivial::severity >= logging::trivial::info
+     );
+
+  po::options_description options("Options");
+  options.add_options()
+    ("index", po::value<std::string>()->required(), "spill index file path")
+    ("add", po::value<std::vector<std::string> >()->multitoken(),
+     "NTBM file paths to be added to the index (a file added again supersedes its earlier spills)")
+    ("tree", po::value<std::string>()->default_value("tree"), "tree (or RNTuple) name of the added files")
+    ("spill", po::value<int>(), "look up a BSD spill number")
+    ("timestamp", po::value<double>(), "look up a BSD timestamp [s]")
+    ("tolerance", po::value<double>()->default_value(1.),
+     "largest difference from the looked up timestamp [s]")
+    ("locate", po::bool_switch()->default_value(false),
+     "only print the file and entry of the spills found")
+    ("list", po::bool_switch()->default_value(false), "list the indexed files");
+  po::positional_options_description positional;
+  positional.add("index", 1);
+
+  po::variables_map vm;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), vm);
+    po::notify(vm);
+    if ( vm.count("add") + vm.count("spill") + vm.count("timestamp") + vm["list"].as<bool>() != 1 )
+      throw po::error("one of --add, --spill, --timestamp and --list is required");
+  } catch (const po::error &error) {
+    BOOST_LOG_TRIVIAL(error) << error.what();
+    BOOST_LOG_TRIVIAL(error) << "Usage : " << argv[0] << " <spill index file path> --add <NTBM file path> [...] [--tree <tree name>]";
+    BOOST_LOG_TRIVIAL(error) << "        " << argv[0] << " <spill index file path> --spill <BSD spill number> [--locate]";
+    BOOST_LOG_TRIVIAL(error) << "        " << argv[0] << " <spill index file path> --timestamp <BSD timestamp>"
+			     << " [--tolerance <s>] [--locate]";
+    BOOST_LOG_TRIVIAL(error) << "        " << argv[0] << " <spill index file path> --list";
+    std::exit(1);
+  }
+
+  try {
+
+    const NTBMSpillIndex index(vm["index"].as<std::string>());
+
+    if ( vm.count("add") ) {
+      for ( const auto &path : vm["add"].as<std::vector<std::string> >() ) {
+	const Long64_t number_of_spills = index.Add(path, vm["tree"].as<std::string>());
+	BOOST_LOG_TRIVIAL(info) << "Added : " << path << " (" << number_of_spills << " spills)";
+      }
+    } else if ( vm["list"].as<bool>() ) {
+      for ( const auto &file : index.GetFiles() )
+	BOOST_LOG_TRIVIAL(info) << file.first.first << " : " << file.first.second
+				<< " (" << file.second << " spills)";
+    } else {
+      const std::vector<NTBMSpillLocation> locations = vm.count("spill") ?
+	index.FindSpillNumber(vm["spill"].as<int>()) :
+	index.FindTimestamp(vm["timestamp"].as<double>(), vm["tolerance"].as<double>());
+      if ( locations.empty() ) {
+	BOOST_LOG_TRIVIAL(error) << "Spill not found in the index";
+	std::exit(1);
+      }
+      PrintSpills(locations, vm["locate"].as<bool>());
+    }
+
+  } catch (const std::runtime_error &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Runtime error : " << error.what();
+    std::exit(1);
+  } catch (const std::invalid_argument &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Invalid argument error : " << error.what();
+    std::exit(1);
+  } catch (const std::out_of_range &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Out of range error : " << error.what();
+    std::exit(1);
+  }
+
+  std::exit(0);
+
+}
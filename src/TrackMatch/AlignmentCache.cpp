@@ -0,0 +1,128 @@
+#include "AlignmentCache.hpp"
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <stdexcept>
+
+///> Alignment cache magic string
+static const char ALIGNMENT_CACHE_MAGIC[8] = {'N', 'T', 'B', 'M', 'A', 'L', 'G', 'N'};
+
+template <typename T>
+static void WriteValue(std::ostream &os, T value) {
+  os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static T ReadValue(std::istream &is) {
+  T value;
+  is.read(reinterpret_cast<char*>(&value), sizeof(T));
+  if ( !is )
+    throw std::runtime_error("Alignment cache truncated");
+  return value;
+}
+
+void WriteAlignmentCacheHeader(std::ostream &os, int datatype) {
+  os.write(ALIGNMENT_CACHE_MAGIC, sizeof(ALIGNMENT_CACHE_MAGIC));
+  WriteValue<std::uint32_t>(os, ALIGNMENT_CACHE_VERSION);
+  WriteValue<std::int32_t>(os, datatype);
+  if ( !os )
+    throw std::runtime_error("Cannot write alignment cache header");
+}
+
+int ReadAlignmentCacheHeader(std::istream &is) {
+  char magic[sizeof(ALIGNMENT_CACHE_MAGIC)];
+  is.read(magic, sizeof(magic));
+  if ( !is || std::memcmp(magic, ALIGNMENT_CACHE_MAGIC, sizeof(magic)) != 0 )
+    throw std::runtime_error("Not an alignment cache");
+  const std::uint32_t version = ReadValue<std::uint32_t>(is);
+  if ( version != ALIGNMENT_CACHE_VERSION )
+    throw std::runtime_error("Alignment cache version not supported : " + std::to_string(version));
+  return ReadValue<std::int32_t>(is);
+}
+
+bool WriteAlignmentCacheSpill(std::ostream &os, const NTBMSummary &ntbm) {
+
+  if ( ntbm.GetNumberOfTracks() == 0 || ntbm.GetNumberOfNinjaClusters() == 0 )
+    return false;
+
+  WriteValue<std::int32_t>(os, ntbm.GetEntryInDailyFile());
+  WriteValue<std::int32_t>(os, ntbm.GetNumberOfTracks());
+  WriteValue<std::int32_t>(os, ntbm.GetNumberOfNinjaClusters());
+
+  for ( int itrack = 0; itrack < ntbm.GetNumberOfTracks(); itrack++ ) {
+    WriteValue<std::int32_t>(os, ntbm.GetNinjaTrackType(itrack));
+    WriteValue<std::int32_t>(os, ntbm.GetBunch(itrack));
+    for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ )
+      WriteValue<double>(os, ntbm.GetBabyMindPosition(itrack, iview));
+    for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ )
+      WriteValue<double>(os, ntbm.GetBabyMindTangent(itrack, iview));
+  }
+
+  for ( int icluster = 0; icluster < ntbm.GetNumberOfNinjaClusters(); icluster++ ) {
+    WriteValue<std::int32_t>(os, ntbm.GetBunchDifference(icluster));
+    for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ )
+      WriteValue<std::int32_t>(os, ntbm.GetNumberOfHits(icluster, iview));
+    for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ )
+      WriteValue<double>(os, ntbm.GetNinjaPosition(icluster, iview));
+    for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ ) {
+      for ( int ihit = 0; ihit < ntbm.GetNumberOfHits(icluster, iview); ihit++ ) {
+	WriteValue<std::uint8_t>(os, ntbm.GetPlane(icluster, iview, ihit));
+	WriteValue<std::uint8_t>(os, ntbm.GetSlot(icluster, iview, ihit));
+	WriteValue<float>(os, ntbm.GetPe(icluster, iview, ihit));
+      }
+    }
+  }
+
+  if ( !os )
+    throw std::runtime_error("Cannot write alignment cache");
+
+  return true;
+
+}
+
+bool ReadAlignmentCacheSpill(std::istream &is, NTBMSummary &ntbm) {
+
+  std::int32_t entry_in_daily_file;
+  is.read(reinterpret_cast<char*>(&entry_in_daily_file), sizeof(entry_in_daily_file));
+  if ( is.eof() ) return false;
+  if ( !is )
+    throw std::runtime_error("Alignment cache truncated");
+
+  ntbm.Clear("R");
+  ntbm.SetEntryInDailyFile(entry_in_daily_file);
+  const int number_of_tracks = ReadValue<std::int32_t>(is);
+  const int number_of_clusters = ReadValue<std::int32_t>(is);
+
+  ntbm.SetNumberOfTracks(number_of_tracks);
+  for ( int itrack = 0; itrack < number_of_tracks; itrack++ ) {
+    ntbm.SetNinjaTrackType(itrack, ReadValue<std::int32_t>(is));
+    ntbm.SetBunch(itrack, ReadValue<std::int32_t>(is));
+    for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ )
+      ntbm.SetBabyMindPosition(itrack, iview, ReadValue<double>(is));
+    for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ )
+      ntbm.SetBabyMindTangent(itrack, iview, ReadValue<double>(is));
+  }
+
+  ntbm.SetNumberOfNinjaClusters(number_of_clusters);
+  for ( int icluster = 0; icluster < number_of_clusters; icluster++ ) {
+    ntbm.SetBabyMindTrackId(icluster, -1);
+    ntbm.SetBunchDifference(icluster, ReadValue<std::int32_t>(is));
+    for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ )
+      ntbm.SetNumberOfHits(icluster, iview, ReadValue<std::int32_t>(is));
+    for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ ) {
+      ntbm.SetNinjaPosition(icluster, iview, ReadValue<double>(is));
+      ntbm.SetNinjaTangent(icluster, iview, 0.);
+    }
+    for ( int iview = 0; iview < NUMBER_OF_VIEWS; iview++ ) {
+      for ( int ihit = 0; ihit < ntbm.GetNumberOfHits(icluster, iview); ihit++ ) {
+	ntbm.SetPlane(icluster, iview, ihit, ReadValue<std::uint8_t>(is));
+	ntbm.SetSlot(icluster, iview, ihit, ReadValue<std::uint8_t>(is));
+	ntbm.SetPe(icluster, iview, ihit, ReadValue<float>(is));
+      }
+    }
+  }
+
+  return true;
+
+}
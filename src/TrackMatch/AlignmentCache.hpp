@@ -0,0 +1,57 @@
+#ifndef NINJARECON_ALIGNMENTCACHE_HPP
+#define NINJARECON_ALIGNMENTCACHE_HPP
+
+#include <iostream>
+#include <cstdint>
+
+#include "NTBMSummary.hh"
+
+/*
+ * Compact binary cache of the z shift independent part of the track matching.
+ * Only spills with both Baby MIND tracks and NINJA 1D clusters are written.
+ *
+ * header : magic "NTBMALGN" (8 bytes), version (uint32), datatype (int32)
+ * spill  : entry in daily file (int32), number of tracks (int32), number of clusters (int32)
+ * track  : NINJA track type (int32), bunch (int32),
+ *          Baby MIND position/tangent at BM_SECOND_LAYER_POS (double x 2 views each)
+ * cluster: bunch difference (int32), number of hits (int32 x 2 views),
+ *          position without angle info (double x 2 views),
+ *          then plane (uint8), slot (uint8) and pe/tot (float) for each hit
+ *
+ * All values are in the native byte order.
+ */
+
+///> Alignment cache format version
+static const std::uint32_t ALIGNMENT_CACHE_VERSION = 1;
+
+/**
+ * Write alignment cache header (runtime_error if the stream fails)
+ * @param os output stream (binary)
+ * @param datatype MC or real data
+ */
+void WriteAlignmentCacheHeader(std::ostream &os, int datatype);
+
+/**
+ * Read and check alignment cache header
+ * @param is input stream (binary)
+ * @return datatype MC or real data
+ */
+int ReadAlignmentCacheHeader(std::istream &is);
+
+/**
+ * Write the Baby MIND tracks and NINJA 1D clusters of the spill
+ * @param os output stream (binary)
+ * @param ntbm NTBMSummary object after the CreateNinjaCluster and TransferBabyMindTrackInfo functions
+ * @return true if the spill is written (runtime_error if the stream fails)
+ */
+bool WriteAlignmentCacheSpill(std::ostream &os, const NTBMSummary &ntbm);
+
+/**
+ * Read one spill from the alignment cache
+ * @param is input stream (binary)
+ * @param ntbm NTBMSummary object to be filled (cleared before filling)
+ * @return false at the end of the cache
+ */
+bool ReadAlignmentCacheSpill(std::istream &is, NTBMSummary &ntbm);
+
+#endif
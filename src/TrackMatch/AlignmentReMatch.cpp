@@ -0,0 +1,312 @@
+// system includes
+#include <vector>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <array>
+
+// boost includes
+#include <boost/program_options.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+
+// root includes
+#include <TROOT.h>
+#include <TFile.h>
+#include <TH1D.h>
+#include <TParameter.h>
+#include <TString.h>
+
+// B2 includes
+#include <B2Enum.hh>
+#include "NTBMSummary.hh"
+
+#include "TrackMatch.hpp"
+#include "AlignmentCache.hpp"
+#include "NinjaPositionBatch.hpp"
+#include "NTBMStartupMarker.hh"
+
+namespace logging = boost::log;
+namespace po = boost::program_options;
+
+/**
+ * One point of the alignment scan
+ */
+struct AlignmentScanPoint {
+  ///> z shift from nominal [mm]
+  double z_shift;
+  ///> offset added to the Baby MIND extrapolation .at(y/x) [mm]
+  std::array<double, 2> transverse_offset;
+  ///> allowance of the bunch candidate search .at(y/x) [mm]
+  std::array<double, 2> allowance;
+};
+
+/**
+ * Create the scan points of all the combinations of the scanned values
+ * @param z_shifts list of z shifts
+ * @param y_offsets list of y offsets
+ * @param x_offsets list of x offsets
+ * @param y_allowances list of y allowances
+ * @param x_allowances list of x allowances
+ * @return scan points, the z shift is the outermost loop
+ */
+std::vector<AlignmentScanPoint> CreateAlignmentScanPoints(const std::vector<double> &z_shifts,
+							  const std::vector<double> &y_offsets,
+							  const std::vector<double> &x_offsets,
+							  const std::vector<double> &y_allowances,
+							  const std::vector<double> &x_allowances) {
+  std::vector<AlignmentScanPoint> points;
+  for ( double z_shift : z_shifts )
+    for ( double y_offset : y_offsets )
+      for ( double x_offset : x_offsets )
+	for ( double y_allowance : y_allowances )
+	  for ( double x_allowance : x_allowances ) {
+	    if ( y_allowance <= 0. || x_allowance <= 0. )
+	      throw std::invalid_argument("Allowance should be positive");
+	    AlignmentScanPoint point;
+	    point.z_shift = z_shift;
+	    point.transverse_offset.at(B2View::kSideView) = y_offset;
+	    point.transverse_offset.at(B2View::kTopView) = x_offset;
+	    point.allowance.at(B2View::kSideView) = y_allowance;
+	    point.allowance.at(B2View::kTopView) = x_allowance;
+	    points.push_back(point);
+	  }
+  return points;
+}
+
+/**
+ * Residual histograms between Baby MIND extrapolation and NINJA tracker
+ * for one scan point
+ */
+struct AlignmentResidual {
+  TH1D *hist_pos_y;
+  TH1D *hist_pos_x;
+  Long64_t number_of_matched_tracks;
+};
+
+/**
+ * Create residual histograms
+ * @param name suffix of the histogram names ("zshift<i>" or "scan<i>")
+ * @param point scan point
+ * @return residual histograms not attached to any directory
+ */
+AlignmentResidual CreateAlignmentResidual(const std::string &name, const AlignmentScanPoint &point) {
+  const std::string title = Form("z shift = %.1f mm, offset (y, x) = (%.1f, %.1f) mm, allowance (y, x) = (%.1f, %.1f) mm",
+			     point.z_shift,
+			     point.transverse_offset.at(B2View::kSideView),
+			     point.transverse_offset.at(B2View::kTopView),
+			     point.allowance.at(B2View::kSideView),
+			     point.allowance.at(B2View::kTopView));
+  AlignmentResidual residual;
+  residual.hist_pos_y = new TH1D(("hist_pos_y_" + name).c_str(),
+				 (title + ";y_{extrapolate} - y_{ST} [mm];Entries/4 mm").c_str(),
+				 250, -500, 500);
+  residual.hist_pos_x = new TH1D(("hist_pos_x_" + name).c_str(),
+				 (title + ";x_{extrapolate} - x_{ST} [mm];Entries/4 mm").c_str(),
+				 250, -500, 500);
+  residual.number_of_matched_tracks = 0;
+  return residual;
+}
+
+/**
+ * Rerun the matching and reconstruction of one day for all the scan points
+ * @param cache_path alignment cache file path
+ * @param points list of scan points
+ * @param residuals residual histograms for each scan point to be filled
+ */
+void ReMatchDailyCache(const std::string &cache_path, const std::vector<AlignmentScanPoint> &points,
+		       std::vector<AlignmentResidual> &residuals) {
+
+  std::ifstream cache(cache_path, std::ios::binary);
+  if ( !cache.is_open() )
+    throw std::runtime_error("Cannot open alignment cache : " + cache_path);
+  ReadAlignmentCacheHeader(cache);
+
+  std::vector<NTBMSummary> spills;
+  NTBMSummary spill;
+  while ( ReadAlignmentCacheSpill(cache, spill) )
+    spills.push_back(spill);
+
+  // Positions of all the spills in the day are reconstructed in one batch
+  std::vector<NTBMSummary> shifted_spills;
+  NinjaPositionBatch position_batch;
+  for ( std::size_t ipoint = 0; ipoint < points.size(); ipoint++ ) {
+    const AlignmentScanPoint &point = points.at(ipoint);
+    shifted_spills = spills;
+    for ( auto &ntbm : shifted_spills ) {
+      MatchNinjaClusters(&ntbm, point.z_shift, point.transverse_offset, point.allowance);
+      SpillArena::GetThreadArena().Reset();
+      position_batch.AddSpill(&ntbm);
+    }
+    position_batch.Reconstruct();
+    MarkFirstSpill();
+
+    for ( auto &ntbm : shifted_spills ) {
+      for ( int icluster = 0; icluster < ntbm.GetNumberOfNinjaClusters(); icluster++ ) {
+	const int trackid = ntbm.GetBabyMindTrackId(icluster);
+	if ( trackid < 0 ) continue;
+	const std::array<double, 2> hit_expected_position
+	  = CalculateExpectedPosition(&ntbm, trackid, point.z_shift, point.transverse_offset);
+	residuals.at(ipoint).hist_pos_y->Fill(hit_expected_position.at(B2View::kSideView)
+					      - ntbm.GetNinjaPosition(icluster, B2View::kSideView));
+	residuals.at(ipoint).hist_pos_x->Fill(hit_expected_position.at(B2View::kTopView)
+					      - ntbm.GetNinjaPosition(icluster, B2View::kTopView));
+	residuals.at(ipoint).number_of_matched_tracks++;
+      } // icluster
+    } // spill
+  } // ipoint
+
+  BOOST_LOG_TRIVIAL(info) << "Alignment cache done : " << cache_path
+			  << " (" << spills.size() << " spills)";
+
+}
+
+// main function
+int main(int argc, char *argv[]) {
+
+  logging::core::get()->set_filter
+    (
+     logging::trivial::severity >= logging::trivial::info
+     );
+
+  BOOST_LOG_TRIVIAL(info) << "==========NINJA Alignment Re-Matching Start==========";
+
+  po::options_description options("Options");
+  options.add_options()
+    ("output", po::value<std::string>()->required(), "output residual histogram file path")
+    ("z-shift", po::value<std::string>()->required(),
+     "z shift from nominal [mm] : <z shift>, <z shift>,<z shift>,... or <start>:<stop>:<step> (stop included)")
+    ("y-offset", po::value<std::string>()->default_value("0"),
+     "y offset added to the Baby MIND extrapolation [mm] : single value, list or range as the z shift")
+    ("x-offset", po::value<std::string>()->default_value("0"),
+     "x offset added to the Baby MIND extrapolation [mm] : single value, list or range as the z shift")
+    ("y-allowance", po::value<std::string>()->default_value(Form("%g", TEMPORAL_ALLOWANCE[B2View::kSideView])),
+     "y allowance of the bunch candidate search [mm] : single value, list or range as the z shift")
+    ("x-allowance", po::value<std::string>()->default_value(Form("%g", TEMPORAL_ALLOWANCE[B2View::kTopView])),
+     "x allowance of the bunch candidate search [mm] : single value, list or range as the z shift")
+    ("cache", po::value<std::vector<std::string> >()->required(), "input alignment cache file paths")
+    ("threads", po::value<unsigned int>()->default_value(std::thread::hardware_concurrency()),
+     "number of threads (one daily cache per thread at a time)");
+  po::positional_options_description positional;
+  positional.add("output", 1).add("z-shift", 1).add("cache", -1);
+
+  po::variables_map vm;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(options).positional(positional)
+	      .style(po::command_line_style::unix_style ^ po::command_line_style::allow_short).run(), vm);
+    po::notify(vm);
+  } catch (const po::error &error) {
+    BOOST_LOG_TRIVIAL(error) << error.what();
+    BOOST_LOG_TRIVIAL(error) << "Usage : " << argv[0]
+			     << " <output file path> <z shift> <input alignment cache file path> [...]"
+			     << " [--y-offset <y offset>] [--x-offset <x offset>]"
+			     << " [--y-allowance <y allowance>] [--x-allowance <x allowance>]"
+			     << " [--threads <number of threads>]";
+    std::exit(1);
+  }
+
+  try {
+
+    const std::vector<double> z_shifts = ParseZShifts(vm["z-shift"].as<std::string>());
+    const std::vector<double> y_offsets = ParseScanValues(vm["y-offset"].as<std::string>(), "y offset");
+    const std::vector<double> x_offsets = ParseScanValues(vm["x-offset"].as<std::string>(), "x offset");
+    const std::vector<double> y_allowances = ParseScanValues(vm["y-allowance"].as<std::string>(), "y allowance");
+    const std::vector<double> x_allowances = ParseScanValues(vm["x-allowance"].as<std::string>(), "x allowance");
+    const std::vector<AlignmentScanPoint> points
+      = CreateAlignmentScanPoints(z_shifts, y_offsets, x_offsets, y_allowances, x_allowances);
+    // The outputs of a z shift only scan keep their z shift names
+    const bool z_shift_only = y_offsets.size() == 1 && x_offsets.size() == 1
+      && y_allowances.size() == 1 && x_allowances.size() == 1;
+    std::vector<std::string> point_names;
+    for ( std::size_t ipoint = 0; ipoint < points.size(); ipoint++ )
+      point_names.push_back((z_shift_only ? "zshift" : "scan") + std::to_string(ipoint));
+    BOOST_LOG_TRIVIAL(info) << "Number of scan points : " << points.size();
+    const std::vector<std::string> cache_paths = vm["cache"].as<std::vector<std::string> >();
+    const unsigned int number_of_threads
+      = std::max(1u, std::min<unsigned int>(vm["threads"].as<unsigned int>(), cache_paths.size()));
+
+    ROOT::EnableThreadSafety();
+    TH1::AddDirectory(kFALSE);
+
+    // Each thread fills its own histograms which are merged at the end
+    std::vector<std::vector<AlignmentResidual> > thread_residuals(number_of_threads);
+    for ( auto &residuals : thread_residuals )
+      for ( std::size_t ipoint = 0; ipoint < points.size(); ipoint++ )
+	residuals.push_back(CreateAlignmentResidual(point_names.at(ipoint), points.at(ipoint)));
+
+    std::atomic<std::size_t> next_cache(0);
+    std::mutex error_mutex;
+    std::string error_message;
+    std::vector<std::thread> threads;
+    for ( unsigned int ithread = 0; ithread < number_of_threads; ithread++ ) {
+      threads.emplace_back([&, ithread]() {
+	  std::size_t icache;
+	  while ( (icache = next_cache++) < cache_paths.size() ) {
+	    try {
+	      ReMatchDailyCache(cache_paths.at(icache), points, thread_residuals.at(ithread));
+	    } catch (const std::exception &error) {
+	      std::lock_guard<std::mutex> lock(error_mutex);
+	      error_message = error.what();
+	      return;
+	    }
+	  }
+	});
+    }
+    for ( auto &thread : threads )
+      thread.join();
+    if ( !error_message.empty() )
+      throw std::runtime_error(error_message);
+
+    std::vector<AlignmentResidual> &residuals = thread_residuals.front();
+    for ( unsigned int ithread = 1; ithread < number_of_threads; ithread++ ) {
+      for ( std::size_t ipoint = 0; ipoint < points.size(); ipoint++ ) {
+	residuals.at(ipoint).hist_pos_y->Add(thread_residuals.at(ithread).at(ipoint).hist_pos_y);
+	residuals.at(ipoint).hist_pos_x->Add(thread_residuals.at(ithread).at(ipoint).hist_pos_x);
+	residuals.at(ipoint).number_of_matched_tracks
+	  += thread_residuals.at(ithread).at(ipoint).number_of_matched_tracks;
+      }
+    }
+
+    TFile *output = new TFile(vm["output"].as<std::string>().c_str(), "recreate");
+    output->cd();
+    for ( std::size_t ipoint = 0; ipoint < points.size(); ipoint++ ) {
+      const AlignmentScanPoint &point = points.at(ipoint);
+      BOOST_LOG_TRIVIAL(info) << "z shift = " << point.z_shift << " mm, "
+			      << "offset (y, x) = (" << point.transverse_offset.at(B2View::kSideView) << ", "
+			      << point.transverse_offset.at(B2View::kTopView) << ") mm, "
+			      << "allowance (y, x) = (" << point.allowance.at(B2View::kSideView) << ", "
+			      << point.allowance.at(B2View::kTopView) << ") mm : "
+			      << "matched tracks = " << residuals.at(ipoint).number_of_matched_tracks << ", "
+			      << "Y residual mean = " << residuals.at(ipoint).hist_pos_y->GetMean() << " mm, "
+			      << "X residual mean = " << residuals.at(ipoint).hist_pos_x->GetMean() << " mm";
+      residuals.at(ipoint).hist_pos_y->Write();
+      residuals.at(ipoint).hist_pos_x->Write();
+      TParameter<Long64_t>(("number_of_matched_tracks_" + point_names.at(ipoint)).c_str(),
+			   residuals.at(ipoint).number_of_matched_tracks).Write();
+      TParameter<double>(Form("z_shift_%d", (int)ipoint), point.z_shift).Write();
+      TParameter<double>(Form("y_offset_%d", (int)ipoint), point.transverse_offset.at(B2View::kSideView)).Write();
+      TParameter<double>(Form("x_offset_%d", (int)ipoint), point.transverse_offset.at(B2View::kTopView)).Write();
+      TParameter<double>(Form("y_allowance_%d", (int)ipoint), point.allowance.at(B2View::kSideView)).Write();
+      TParameter<double>(Form("x_allowance_%d", (int)ipoint), point.allowance.at(B2View::kTopView)).Write();
+    }
+    output->Close();
+
+  } catch (const std::runtime_error &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Runtime error : " << error.what();
+    std::exit(1);
+  } catch (const std::invalid_argument &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Invalid argument error : " << error.what();
+    std::exit(1);
+  } catch (const std::out_of_range &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Out of range error : " << error.what();
+    std::exit(1);
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "==========NINJA Alignment Re-Matching Finish==========";
+  std::exit(0);
+
+}
@@ -0,0 +1,155 @@
+#include "AllocationCounter.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace {
+
+// trivially initialized so that the counters can be used inside operator new
+thread_local std::size_t number_of_allocations = 0;
+thread_local std::size_t allocated_bytes = 0;
+
+void *CountedAllocate(std::size_t size) {
+  number_of_allocations++;
+  allocated_bytes += size;
+  if ( size == 0 ) size = 1;
+  while ( true ) {
+    if ( void *pointer = std::malloc(size) )
+      return pointer;
+    std::new_handler handler = std::get_new_handler();
+    if ( handler == nullptr )
+      throw std::bad_alloc();
+    handler();
+  }
+}
+
+#if __cpp_aligned_new >= 201606
+void *CountedAllocate(std::size_t size, std::size_t alignment) {
+  number_of_allocations++;
+  allocated_bytes += size;
+  if ( size == 0 ) size = 1;
+  while ( true ) {
+    void *pointer = nullptr;
+    if ( posix_memalign(&pointer, std::max(alignment, sizeof(void*)), size) == 0 )
+      return pointer;
+    std::new_handler handler = std::get_new_handler();
+    if ( handler == nullptr )
+      throw std::bad_alloc();
+    handler();
+  }
+}
+#endif
+
+}
+
+std::size_t GetNumberOfAllocations() {
+  return number_of_allocations;
+}
+
+std::size_t GetAllocatedBytes() {
+  return allocated_bytes;
+}
+
+CacheMissCounter::CacheMissCounter() : file_descriptor_(-1) {
+#ifdef __linux__
+  perf_event_attr attribute;
+  std::memset(&attribute, 0, sizeof(attribute));
+  attribute.size = sizeof(attribute);
+  attribute.type = PERF_TYPE_HARDWARE;
+  attribute.config = PERF_COUNT_HW_CACHE_MISSES;
+  attribute.disabled = 1;
+  attribute.exclude_kernel = 1;
+  attribute.exclude_hv = 1;
+  file_descriptor_ = syscall(__NR_perf_event_open, &attribute, 0, -1, -1, 0);
+#endif
+}
+
+CacheMissCounter::~CacheMissCounter() {
+#ifdef __linux__
+  if ( file_descriptor_ >= 0 ) close(file_descriptor_);
+#endif
+}
+
+bool CacheMissCounter::IsAvailable() const {
+  return file_descriptor_ >= 0;
+}
+
+void CacheMissCounter::Start() {
+#ifdef __linux__
+  if ( file_descriptor_ < 0 ) return;
+  ioctl(file_descriptor_, PERF_EVENT_IOC_RESET, 0);
+  ioctl(file_descriptor_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+long long CacheMissCounter::Stop() {
+#ifdef __linux__
+  if ( file_descriptor_ < 0 ) return -1;
+  ioctl(file_descriptor_, PERF_EVENT_IOC_DISABLE, 0);
+  long long count = 0;
+  if ( read(file_descriptor_, &count, sizeof(count)) != sizeof(count) )
+    return -1;
+  return count;
+#else
+  return -1;
+#endif
+}
+
+void *operator new(std::size_t size) {
+  return CountedAllocate(size);
+}
+
+void *operator new[](std::size_t size) {
+  return CountedAllocate(size);
+}
+
+void operator delete(void *pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+#if __cpp_aligned_new >= 201606
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return CountedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return CountedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+#endif
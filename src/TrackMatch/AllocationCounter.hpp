@@ -0,0 +1,58 @@
+#ifndef NINJARECON_ALLOCATIONCOUNTER_HPP
+#define NINJARECON_ALLOCATIONCOUNTER_HPP
+
+#include <cstddef>
+
+/*
+ * Heap allocation counters of the calling thread. They are counted by the
+ * replacement of the global operator new in AllocationCounter.cpp, which is
+ * linked only into the executables measuring their allocations
+ * (TrackMatchKernelBenchmark, and TrackMatch built with NINJA_COUNT_ALLOCATIONS=ON).
+ */
+
+/**
+ * @return number of operator new calls of the calling thread
+ */
+std::size_t GetNumberOfAllocations();
+
+/**
+ * @return number of bytes requested by operator new calls of the calling thread
+ */
+std::size_t GetAllocatedBytes();
+
+/**
+ * Hardware cache miss counter of the calling thread (Linux perf events).
+ * It is not available when the kernel does not allow user space perf events
+ * (e.g. kernel.perf_event_paranoid > 2 or in a container).
+ */
+class CacheMissCounter {
+
+public :
+
+  CacheMissCounter();
+
+  ~CacheMissCounter();
+
+  CacheMissCounter(const CacheMissCounter&) = delete;
+  CacheMissCounter &operator=(const CacheMissCounter&) = delete;
+
+  bool IsAvailable() const;
+
+  /**
+   * Reset and start counting
+   */
+  void Start();
+
+  /**
+   * Stop counting
+   * @return number of cache misses since Start (-1 : not available)
+   */
+  long long Stop();
+
+private :
+
+  int file_descriptor_;
+
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "B2ReadAhead.hpp"
+
+#include <chrono>
+
+B2ReadAhead::B2ReadAhead(const std::string &path, std::size_t depth) :
+  slots_(depth + 1), first_entry_(0), last_entry_(-1), next_entry_(0),
+  has_current_slot_(false), current_slot_(0), stop_(false) {
+  for ( auto &slot : slots_ ) {
+    slot.reader.reset(new B2Reader(path));
+    slot.loaded = false;
+    slot.status = 0;
+  }
+}
+
+B2ReadAhead::~B2ReadAhead() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+  if ( thread_.joinable() )
+    thread_.join();
+}
+
+Long64_t B2ReadAhead::GetEntries() const {
+  return slots_.front().reader->GetEntries();
+}
+
+std::size_t B2ReadAhead::GetSlotId(Long64_t entry) const {
+  return (entry - first_entry_) % slots_.size();
+}
+
+void B2ReadAhead::Start(Long64_t first_entry, Long64_t last_entry) {
+  first_entry_ = first_entry;
+  last_entry_ = last_entry;
+  next_entry_ = first_entry;
+  if ( slots_.size() > 1 )
+    thread_ = std::thread(&B2ReadAhead::Prefetch, this);
+}
+
+void B2ReadAhead::Prefetch() {
+
+  // Spills are decoded in order, each one in the reader of its slot
+  for ( Long64_t entry = first_entry_; entry <= last_entry_; entry++ ) {
+    Slot &slot = slots_.at(GetSlotId(entry));
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [&] {
+	  return stop_ || ( !slot.loaded && !( has_current_slot_ && current_slot_ == GetSlotId(entry) ) );
+	});
+      if ( stop_ ) return;
+    }
+    // errors are passed to the consumer thread and thrown by Next
+    int status = 0;
+    std::exception_ptr error;
+    try {
+      status = slot.reader->ReadSpill(entry);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      slot.status = status;
+      slot.error = error;
+      slot.loaded = true;
+    }
+    condition_.notify_all();
+    if ( status <= 0 ) return;
+  }
+
+}
+
+B2Reader *B2ReadAhead::Next() {
+
+  if ( next_entry_ > last_entry_ ) return nullptr;
+  const std::size_t islot = GetSlotId(next_entry_);
+  Slot &slot = slots_.at(islot);
+
+  // Synchronous mode
+  if ( !thread_.joinable() ) {
+    if ( slot.reader->ReadSpill(next_entry_) <= 0 ) {
+      next_entry_ = last_entry_ + 1;
+      return nullptr;
+    }
+    next_entry_++;
+    return slot.reader.get();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if ( has_current_slot_ ) {
+    slots_.at(current_slot_).loaded = false;
+    has_current_slot_ = false;
+    condition_.notify_all();
+  }
+
+  if ( slot.loaded ) {
+    statistics_.hits++;
+  } else {
+    const auto stall_start = std::chrono::steady_clock::now();
+    condition_.wait(lock, [&] { return slot.loaded; });
+    statistics_.misses++;
+    statistics_.stall_time += std::chrono::duration<double>
+      (std::chrono::steady_clock::now() - stall_start).count();
+  }
+
+  if ( slot.error ) {
+    next_entry_ = last_entry_ + 1;
+    std::rethrow_exception(slot.error);
+  }
+  if ( slot.status <= 0 ) {
+    next_entry_ = last_entry_ + 1;
+    return nullptr;
+  }
+  has_current_slot_ = true;
+  current_slot_ = islot;
+  next_entry_++;
+  return slot.reader.get();
+
+}
+
+const ReadAheadStatistics &B2ReadAhead::GetStatistics() const {
+  return statistics_;
+}
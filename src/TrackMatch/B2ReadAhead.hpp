@@ -0,0 +1,89 @@
+#ifndef NINJARECON_B2READAHEAD_HPP
+#define NINJARECON_B2READAHEAD_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <B2Reader.hh>
+
+#include "NinjaTrackerReadAhead.hh"
+
+/**
+ * Read-ahead layer for the B2 input file.
+ * B2Reader keeps only one decoded spill, so depth + 1 readers of the same file
+ * are opened and a background thread decodes the next spills in the idle readers
+ * while the consumer processes the current one. Entries are read in order.
+ */
+class B2ReadAhead {
+
+public :
+
+  /**
+   * @param path input B2 file path
+   * @param depth number of spills decoded ahead (0 : read synchronously)
+   */
+  B2ReadAhead(const std::string &path, std::size_t depth);
+
+  ~B2ReadAhead();
+
+  B2ReadAhead(const B2ReadAhead&) = delete;
+  B2ReadAhead &operator=(const B2ReadAhead&) = delete;
+
+  /**
+   * @return number of entries in the input file
+   */
+  Long64_t GetEntries() const;
+
+  /**
+   * Start reading the entry range
+   * @param first_entry first entry to be read
+   * @param last_entry last entry to be read (included)
+   */
+  void Start(Long64_t first_entry, Long64_t last_entry);
+
+  /**
+   * Get the reader holding the next spill. The reader is valid until the next call.
+   * An error of the background thread while decoding the spill is thrown here.
+   * @return reader or nullptr at the end of the entry range
+   */
+  B2Reader *Next();
+
+  /**
+   * @return read-ahead counters
+   */
+  const ReadAheadStatistics &GetStatistics() const;
+
+private :
+
+  struct Slot {
+    std::unique_ptr<B2Reader> reader;
+    bool loaded;
+    int status;
+    ///> error thrown while decoding the spill of the slot
+    std::exception_ptr error;
+  };
+
+  std::size_t GetSlotId(Long64_t entry) const;
+  void Prefetch();
+
+  std::vector<Slot> slots_;
+  Long64_t first_entry_;
+  Long64_t last_entry_;
+  Long64_t next_entry_;
+  bool has_current_slot_;
+  std::size_t current_slot_;
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread thread_;
+
+  ReadAheadStatistics statistics_;
+
+};
+
+#endif
@@ -0,0 +1,274 @@
+// system includes
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+
+// boost includes
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+
+// B2 includes
+#include <B2Enum.hh>
+#include <B2Const.hh>
+#include "NTBMSummary.hh"
+#include "NinjaGeometry.hh"
+
+#include "TrackMatch.hpp"
+#include "TrackMatchKernels.hpp"
+#include "SpillArena.hpp"
+#include "AllocationCounter.hpp"
+
+namespace logging = boost::log;
+
+/*
+ * Benchmark of the TrackMatch kernels specialized on the view at compile time
+ * against the runtime view dispatch. Random but reproducible inputs are used.
+ * The track matching of synthetic spills is also measured (time, heap allocations
+ * and cache misses per spill).
+ */
+
+///> Number of track areas evaluated in the hit/gap benchmarks
+const int NUMBER_OF_AREAS = 4096;
+
+///> Number of synthetic spills in the matching benchmark
+const int NUMBER_OF_MATCHING_SPILLS = 2000;
+
+/**
+ * Run a benchmark and return the time per call
+ * @param name benchmark name
+ * @param number_of_calls number of calls in one repetition
+ * @param repetitions number of repetitions
+ * @param function benchmarked function returning a checksum
+ * @return time per call [ns]
+ */
+template <typename Function>
+double RunBenchmark(const std::string &name, long number_of_calls, int repetitions, Function function) {
+  long checksum = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for ( int irepetition = 0; irepetition < repetitions; irepetition++ )
+    checksum += function();
+  const double time = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+    / number_of_calls / repetitions;
+  BOOST_LOG_TRIVIAL(info) << name << " : " << time << " ns/call (checksum " << checksum << ")";
+  return time;
+}
+
+int main(int argc, char *argv[]) {
+
+  logging::core::get()->set_filter
+    (
+     logging::trivial::severity >= logging::trivial::info
+     );
+
+  const int repetitions = argc > 1 ? std::stoi(argv[1]) : 200;
+
+  // the timings depend on the geometry the kernels look up, report it with them
+#ifdef NTBM_STANDALONE_GEOMETRY
+  BOOST_LOG_TRIVIAL(info) << "Geometry : table " << GetNinjaGeometryTablePath();
+#else
+  BOOST_LOG_TRIVIAL(info) << "Geometry : B2Dimension";
+#endif
+  BOOST_LOG_TRIVIAL(info) << "Repetitions : " << repetitions;
+
+  std::mt19937 generator(20211);
+  std::uniform_real_distribution<double> position_distribution(-400., 400.);
+  std::uniform_real_distribution<double> width_distribution(0., 40.);
+  std::uniform_real_distribution<double> tangent_distribution(-1., 1.);
+  std::uniform_int_distribution<int> plane_distribution(0, NINJA_TRACKER_NUM_PLANES - 1);
+  std::uniform_int_distribution<int> slot_distribution(0, NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE - 1);
+
+  std::vector<double> area_min(NUMBER_OF_AREAS), area_max(NUMBER_OF_AREAS);
+  for ( int iarea = 0; iarea < NUMBER_OF_AREAS; iarea++ ) {
+    area_min.at(iarea) = position_distribution(generator);
+    area_max.at(iarea) = area_min.at(iarea) + width_distribution(generator);
+  }
+
+  for ( int view = 0; view < 2; view++ ) {
+    const int plane = 2;
+    const int slot = 15;
+    TVector3 bar;
+    GetNinjaTrackerPosition(view, plane, slot, bar);
+    const double position_xy = view == B2View::kTopView ? bar.X() : bar.Y();
+    BOOST_LOG_TRIVIAL(info) << "----- View " << view << " -----";
+
+    const double make_hit_runtime = RunBenchmark
+      ("IsMakeHitAtPosition (runtime view)", NUMBER_OF_AREAS, repetitions, [&]() {
+	long count = 0;
+	for ( int iarea = 0; iarea < NUMBER_OF_AREAS; iarea++ )
+	  count += IsMakeHitAtPosition(area_min[iarea], area_max[iarea], view, slot, position_xy);
+	return count;
+      });
+    const double make_hit_template = RunBenchmark
+      ("IsMakeHitAtPosition<View>", NUMBER_OF_AREAS, repetitions, [&]() {
+	long count = 0;
+	if ( view == B2View::kSideView )
+	  for ( int iarea = 0; iarea < NUMBER_OF_AREAS; iarea++ )
+	    count += IsMakeHitAtPosition<B2View::kSideView>(area_min[iarea], area_max[iarea], slot, position_xy);
+	else
+	  for ( int iarea = 0; iarea < NUMBER_OF_AREAS; iarea++ )
+	    count += IsMakeHitAtPosition<B2View::kTopView>(area_min[iarea], area_max[iarea], slot, position_xy);
+	return count;
+      });
+
+    const double gap_runtime = RunBenchmark
+      ("IsInGap over slots (runtime view)", NUMBER_OF_AREAS, repetitions, [&]() {
+	long count = 0;
+	for ( int iarea = 0; iarea < NUMBER_OF_AREAS; iarea++ ) {
+	  bool in_gap = false;
+	  for ( int jslot = -1; jslot < NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE; jslot++ )
+	    in_gap = in_gap || IsInGap(area_min[iarea], area_max[iarea], view, plane, jslot);
+	  count += in_gap;
+	}
+	return count;
+      });
+    const double gap_template = RunBenchmark
+      ("IsInGapAtPosition<View> over slots", NUMBER_OF_AREAS, repetitions, [&]() {
+	std::vector<double> bar_position(NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE);
+	for ( int jslot = 0; jslot < NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE; jslot++ ) {
+	  TVector3 position;
+	  GetNinjaTrackerPosition(view, plane, jslot, position);
+	  bar_position.at(jslot) = view == B2View::kTopView ? position.X() : position.Y();
+	}
+	long count = 0;
+	for ( int iarea = 0; iarea < NUMBER_OF_AREAS; iarea++ ) {
+	  bool in_gap = false;
+	  for ( int jslot = -1; jslot < NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE; jslot++ ) {
+	    const double position_xy = bar_position[jslot < 0 ? 0 : jslot];
+	    in_gap = in_gap || ( view == B2View::kSideView ?
+				 IsInGapAtPosition<B2View::kSideView>(area_min[iarea], area_max[iarea],
+								      plane, jslot, position_xy) :
+				 IsInGapAtPosition<B2View::kTopView>(area_min[iarea], area_max[iarea],
+								     plane, jslot, position_xy) );
+	  }
+	  count += in_gap;
+	}
+	return count;
+      });
+
+    PlanePositionList plane_positions(2);
+    for ( int ihit = 0; ihit < 3; ihit++ ) {
+      plane_positions.at(0).push_back(position_distribution(generator));
+      plane_positions.at(1).push_back(position_distribution(generator));
+    }
+    const double merge_runtime = RunBenchmark
+      ("CalcMergedOnePlanePositionAndError (runtime view)", 1000, repetitions, [&]() {
+	long count = 0;
+	for ( int icall = 0; icall < 1000; icall++ )
+	  count += CalcMergedOnePlanePositionAndError(plane_positions, view).at(1).at(0) > 0.;
+	return count;
+      });
+    const double merge_template = RunBenchmark
+      ("CalcMergedOnePlanePositionAndError<View>", 1000, repetitions, [&]() {
+	long count = 0;
+	for ( int icall = 0; icall < 1000; icall++ )
+	  count += ( view == B2View::kSideView ?
+		     CalcMergedOnePlanePositionAndError<B2View::kSideView>(plane_positions) :
+		     CalcMergedOnePlanePositionAndError<B2View::kTopView>(plane_positions) ).at(1).at(0) > 0.;
+	return count;
+      });
+
+    BOOST_LOG_TRIVIAL(info) << "Speed up : IsMakeHit x" << make_hit_runtime / make_hit_template
+			    << ", IsInGap x" << gap_runtime / gap_template
+			    << ", CalcMergedOnePlanePositionAndError x" << merge_runtime / merge_template;
+  }
+
+  // Whole position reconstruction of 1D clusters
+  BOOST_LOG_TRIVIAL(info) << "----- Position reconstruction -----";
+  const int number_of_clusters = 64;
+  NTBMSummary ntbm;
+  ntbm.SetNumberOfNinjaClusters(number_of_clusters);
+  for ( int icluster = 0; icluster < number_of_clusters; icluster++ ) {
+    const int view = icluster % 2;
+    std::vector<int> number_of_hits(2, 0);
+    std::vector<std::vector<int> > plane(2), slot(2);
+    std::vector<std::vector<double> > pe(2);
+    const int first_slot = slot_distribution(generator);
+    for ( int iplane = 0; iplane < NINJA_TRACKER_NUM_PLANES; iplane++ ) {
+      number_of_hits.at(view)++;
+      plane.at(view).push_back(iplane);
+      slot.at(view).push_back(first_slot);
+      pe.at(view).push_back(10.);
+    }
+    ntbm.SetNumberOfHits(icluster, number_of_hits);
+    ntbm.SetPlane(icluster, plane);
+    ntbm.SetSlot(icluster, slot);
+    ntbm.SetPe(icluster, pe);
+    std::vector<double> tangent = {tangent_distribution(generator), tangent_distribution(generator)};
+    ntbm.SetNinjaTangent(icluster, tangent);
+  }
+  RunBenchmark("ReconstructNinjaPosition (per cluster)", number_of_clusters, repetitions / 10 + 1, [&]() {
+      ReconstructNinjaPosition(&ntbm);
+      return (long)(ntbm.GetNinjaPosition(0, 0) > 0.);
+    });
+
+  // Track matching of synthetic spills : Baby MIND tracks and a few 1D clusters
+  // with a handful of hits, refilled in one reused object as in TrackMatch
+  BOOST_LOG_TRIVIAL(info) << "----- Track matching -----";
+  std::vector<NTBMSummary> matching_spills(NUMBER_OF_MATCHING_SPILLS);
+  std::uniform_int_distribution<int> track_distribution(1, 4);
+  std::uniform_int_distribution<int> cluster_distribution(4, 16);
+  std::uniform_int_distribution<int> hit_distribution(1, NINJA_TRACKER_NUM_PLANES);
+  std::uniform_int_distribution<int> bunch_distribution(2, 4);
+  for ( auto &spill : matching_spills ) {
+    const int number_of_tracks = track_distribution(generator);
+    for ( int itrack = 0; itrack < number_of_tracks; itrack++ ) {
+      NTBMSummary::BabyMindTrack track;
+      for ( int view = 0; view < 2; view++ ) {
+	track.baby_mind_position[view] = position_distribution(generator);
+	track.baby_mind_tangent[view] = 0.3 * tangent_distribution(generator);
+      }
+      track.bunch = bunch_distribution(generator);
+      spill.AddBabyMindTrack(track);
+    }
+    const int number_of_1d_clusters = cluster_distribution(generator);
+    NTBMSummary::NinjaCluster cluster;
+    for ( int icluster = 0; icluster < number_of_1d_clusters; icluster++ ) {
+      cluster.Clear();
+      const int view = icluster % 2;
+      const int number_of_hits = hit_distribution(generator);
+      for ( int ihit = 0; ihit < number_of_hits; ihit++ ) {
+	cluster.plane[view].push_back(ihit);
+	cluster.slot[view].push_back(slot_distribution(generator));
+	cluster.pe[view].push_back(10.);
+      }
+      cluster.bunch_difference = icluster % 3 == 0;
+      cluster.ninja_position[view] = position_distribution(generator);
+      spill.AddNinjaCluster(cluster);
+    }
+  }
+
+  NTBMSummary matching_ntbm;
+  CacheMissCounter cache_misses;
+  long long number_of_cache_misses = 0;
+  std::size_t number_of_allocations = 0;
+  for ( int irepetition = 0; irepetition < 2; irepetition++ ) {
+    // the first repetition warms up the reused object
+    const std::size_t allocations_before = GetNumberOfAllocations();
+    cache_misses.Start();
+    RunBenchmark("MatchNinjaClusters (per spill)", NUMBER_OF_MATCHING_SPILLS, 1, [&]() {
+	long count = 0;
+	for ( const auto &spill : matching_spills ) {
+	  matching_ntbm = spill;
+	  MatchNinjaClusters(&matching_ntbm, 0.);
+	  count += matching_ntbm.GetNumberOfNinjaClusters();
+	  matching_ntbm.Clear("R");
+	  SpillArena::GetThreadArena().Reset();
+	}
+	return count;
+      });
+    number_of_cache_misses = cache_misses.Stop();
+    number_of_allocations = GetNumberOfAllocations() - allocations_before;
+  }
+  BOOST_LOG_TRIVIAL(info) << "MatchNinjaClusters : "
+			  << (double)number_of_allocations / NUMBER_OF_MATCHING_SPILLS << " heap allocations/spill";
+  if ( cache_misses.IsAvailable() )
+    BOOST_LOG_TRIVIAL(info) << "MatchNinjaClusters : "
+			    << (double)number_of_cache_misses / NUMBER_OF_MATCHING_SPILLS << " cache misses/spill";
+  else
+    BOOST_LOG_TRIVIAL(info) << "MatchNinjaClusters : cache misses not available (perf events not allowed)";
+
+  std::exit(0);
+
+}
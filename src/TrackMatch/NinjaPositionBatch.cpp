@@ -0,0 +1,351 @@
+#include "NinjaPositionBatch.hpp"
+
+#include <chrono>
+
+// B2 includes
+#include <B2Enum.hh>
+#include <B2Const.hh>
+#include "NinjaGeometry.hh"
+
+#include "TrackMatch.hpp"
+#include "TrackMatchKernels.hpp"
+
+namespace {
+
+///> Number of lines drawn from each vertex of each scintillator bar in one view
+const int NUMBER_OF_LINES = NINJA_TRACKER_NUM_PLANES * NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE * 4;
+
+/**
+ * NINJA tracker geometry used in the position reconstruction kernels
+ */
+struct NinjaTrackerGeometry {
+
+  ///> scintillator bar position in the tracker box coordinate
+  double bar_position[2][NINJA_TRACKER_NUM_PLANES][NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE];
+  ///> start position of each line
+  double line_start[2][NUMBER_OF_LINES];
+  ///> z distance factors of GetTrackAreaMin/Max for positive [1] and non-positive [0] tangent
+  double line_area_min_z[2][NINJA_TRACKER_NUM_PLANES][NUMBER_OF_LINES];
+  double line_area_max_z[2][NINJA_TRACKER_NUM_PLANES][NUMBER_OF_LINES];
+  ///> z distance factor from the start of each line to the 3rd plane
+  double line_position_z[NUMBER_OF_LINES];
+
+  NinjaTrackerGeometry() {
+    for ( int iview = 0; iview < 2; iview++ ) {
+      for ( int iplane = 0; iplane < NINJA_TRACKER_NUM_PLANES; iplane++ ) {
+	for ( int islot = 0; islot < NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE; islot++ ) {
+	  TVector3 position;
+	  GetNinjaTrackerPosition(iview, iplane, islot, position);
+	  bar_position[iview][iplane][islot] = iview == B2View::kTopView ? position.X() : position.Y();
+	}
+      }
+    }
+
+    // Same line order and arithmetic as the cluster by cluster reconstruction
+    for ( int iplane = 0; iplane < NINJA_TRACKER_NUM_PLANES; iplane++ ) {
+      for ( int islot = 0; islot < NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE; islot++ ) {
+	for ( int ivertex = 0; ivertex < 4; ivertex++ ) {
+	  const int iline = (iplane * NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE + islot) * 4 + ivertex;
+	  for ( int iview = 0; iview < 2; iview++ )
+	    line_start[iview][iline] = bar_position[iview][iplane][islot]
+	      + NINJA_SCI_WIDTH / 2. * ( -1 + 2 * (ivertex/2) );
+	  for ( int jplane = 0; jplane < NINJA_TRACKER_NUM_PLANES; jplane++ ) {
+	    line_area_min_z[1][jplane][iline] = NINJA_TRACKER_OFFSET_Z[jplane] - NINJA_TRACKER_OFFSET_Z[iplane]
+	      + NINJA_SCI_THICK * (0 - ivertex % 2);
+	    line_area_max_z[1][jplane][iline] = NINJA_TRACKER_OFFSET_Z[jplane] - NINJA_TRACKER_OFFSET_Z[iplane]
+	      + NINJA_SCI_THICK * (1 - ivertex % 2);
+	    line_area_min_z[0][jplane][iline] = line_area_max_z[1][jplane][iline];
+	    line_area_max_z[0][jplane][iline] = line_area_min_z[1][jplane][iline];
+	  }
+	  line_position_z[iline] = - NINJA_SCI_THICK * (ivertex % 2)
+	    - NINJA_TRACKER_OFFSET_Z[iplane] + NINJA_TRACKER_OFFSET_Z[2];
+	}
+      }
+    }
+  }
+
+};
+
+const NinjaTrackerGeometry &GetNinjaTrackerGeometry() {
+  static const NinjaTrackerGeometry geometry;
+  return geometry;
+}
+
+/**
+ * Average of all scintillator bar positions of one (cluster, view) item.
+ * Used when no line makes the hit pattern and for spills over the budget.
+ * @param hit_plane hit_slot number_of_hits hit list of the view
+ * @return average position
+ */
+template <int View>
+double AverageBarPosition(const int *hit_plane, const int *hit_slot, int number_of_hits) {
+  const NinjaTrackerGeometry &geometry = GetNinjaTrackerGeometry();
+  double position = 0.;
+  for ( int ihit = 0; ihit < number_of_hits; ihit++ )
+    position += geometry.bar_position[View][hit_plane[ihit]][hit_slot[ihit]];
+  position /= number_of_hits;
+  return position;
+}
+
+/**
+ * Reconstruct position of one (cluster, view) item.
+ * Specialized on the view so that the line loops have no view branch.
+ * @param tangent reconstructed tangent of the view
+ * @param plane_slot slot of the last hit in each plane (-1 when no hit)
+ * @param hit_plane hit_slot number_of_hits hit list of the view
+ * @return reconstructed position
+ */
+template <int View>
+double ReconstructNinjaPositionOneView(double tangent, const int *plane_slot,
+				       const int *hit_plane, const int *hit_slot, int number_of_hits) {
+
+  const NinjaTrackerGeometry &geometry = GetNinjaTrackerGeometry();
+  const double *line_start = geometry.line_start[View];
+  const int tangent_sign = tangent > 0 ? 1 : 0;
+
+  bool good_line[NUMBER_OF_LINES];
+  bool plane_condition[NUMBER_OF_LINES];
+  double track_area_min[NUMBER_OF_LINES];
+  double track_area_max[NUMBER_OF_LINES];
+
+  for ( int iline = 0; iline < NUMBER_OF_LINES; iline++ )
+    good_line[iline] = true;
+
+  // Check every line can make the hit pattern plane by plane
+  for ( int jplane = 0; jplane < NINJA_TRACKER_NUM_PLANES; jplane++ ) {
+
+    const double *area_min_z = geometry.line_area_min_z[tangent_sign][jplane];
+    const double *area_max_z = geometry.line_area_max_z[tangent_sign][jplane];
+    for ( int iline = 0; iline < NUMBER_OF_LINES; iline++ ) {
+      track_area_min[iline] = line_start[iline] + tangent * area_min_z[iline];
+      track_area_max[iline] = line_start[iline] + tangent * area_max_z[iline];
+    }
+
+    const int slot = plane_slot[jplane];
+    if ( slot >= 0 ) { // When there is a hit in the plane, check the track penetrates the slot
+      const double position_xy = geometry.bar_position[View][jplane][slot];
+      for ( int iline = 0; iline < NUMBER_OF_LINES; iline++ )
+	plane_condition[iline] = IsMakeHitAtPosition<View>(track_area_min[iline], track_area_max[iline],
+							   slot, position_xy);
+    } else { // When there are no hits in the plane, check the track penetrates some gap
+      for ( int iline = 0; iline < NUMBER_OF_LINES; iline++ )
+	plane_condition[iline] = false;
+      for ( int jslot = -1; jslot < NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE; jslot++ ) {
+	const double position_xy = geometry.bar_position[View][jplane][jslot < 0 ? 0 : jslot];
+	for ( int iline = 0; iline < NUMBER_OF_LINES; iline++ )
+	  plane_condition[iline] = plane_condition[iline] ||
+	    IsInGapAtPosition<View>(track_area_min[iline], track_area_max[iline], jplane, jslot, position_xy);
+      } // jslot
+    }
+
+    for ( int iline = 0; iline < NUMBER_OF_LINES; iline++ )
+      good_line[iline] = good_line[iline] && plane_condition[iline];
+
+  } // jplane
+
+  // Use lines with good plane condition and reconstruct position
+  bool has_good_line = false;
+  double position_min = 0.;
+  double position_max = 0.;
+  for ( int iline = 0; iline < NUMBER_OF_LINES; iline++ ) {
+    if ( !good_line[iline] ) continue;
+    const double position = line_start[iline] + tangent * geometry.line_position_z[iline];
+    if ( !has_good_line || position < position_min ) position_min = position;
+    if ( !has_good_line || position > position_max ) position_max = position;
+    has_good_line = true;
+  }
+  if ( has_good_line )
+    return (position_min + position_max) / 2.;
+
+  return AverageBarPosition<View>(hit_plane, hit_slot, number_of_hits);
+
+}
+
+/**
+ * Reconstruct position of one item dispatching on the view
+ * @param view view of the item
+ * @param fallback use the bar average instead of the line reconstruction
+ * @return reconstructed position
+ */
+double ReconstructNinjaPositionItem(int view, bool fallback, double tangent, const int *plane_slot,
+				    const int *hit_plane, const int *hit_slot, int number_of_hits) {
+  if ( view == B2View::kSideView )
+    return fallback ?
+      AverageBarPosition<B2View::kSideView>(hit_plane, hit_slot, number_of_hits) :
+      ReconstructNinjaPositionOneView<B2View::kSideView>(tangent, plane_slot, hit_plane, hit_slot,
+							  number_of_hits);
+  else
+    return fallback ?
+      AverageBarPosition<B2View::kTopView>(hit_plane, hit_slot, number_of_hits) :
+      ReconstructNinjaPositionOneView<B2View::kTopView>(tangent, plane_slot, hit_plane, hit_slot,
+							 number_of_hits);
+}
+
+} // namespace
+
+void NinjaPositionBatch::AddSpill(NTBMSummary *ntbm, Long64_t entry) {
+
+  if ( spill_item_begin_.empty() ) {
+    spill_item_begin_.push_back(0);
+    spill_cluster_begin_.push_back(0);
+  }
+  long work = 0;
+
+  for ( int icluster = 0; icluster < ntbm->GetNumberOfNinjaClusters(); icluster++ ) {
+    const std::vector<double> &tangent = ntbm->GetNinjaTangent(icluster);
+    cluster_spill_.push_back(ntbm);
+    cluster_id_.push_back(icluster);
+    for ( int iview = 0; iview < 2; iview++ ) {
+      const int number_of_hits = ntbm->GetNumberOfHits(icluster, iview);
+      // skip invalid view for 1d cluster
+      if ( number_of_hits == 0 ) {
+	cluster_item_[iview].push_back(-1);
+	continue;
+      }
+      cluster_item_[iview].push_back(item_view_.size());
+      item_view_.push_back(iview);
+      item_tangent_.push_back(tangent.at(iview));
+      if ( item_hit_begin_.empty() )
+	item_hit_begin_.push_back(0);
+      const std::size_t plane_slot_begin = item_plane_slot_.size();
+      item_plane_slot_.resize(plane_slot_begin + NINJA_TRACKER_NUM_PLANES, -1);
+      const NTBMArrayView<UChar_t> plane_view = ntbm->GetPlaneView(icluster, iview);
+      const NTBMArrayView<UChar_t> slot_view = ntbm->GetSlotView(icluster, iview);
+      for ( int ihit = 0; ihit < number_of_hits; ihit++ ) {
+	const int plane = plane_view[ihit];
+	const int slot = slot_view[ihit];
+	hit_plane_.push_back(plane);
+	hit_slot_.push_back(slot);
+	// only the last hit in the plane is used for the plane condition
+	item_plane_slot_.at(plane_slot_begin + plane) = slot;
+      }
+      item_hit_begin_.push_back(hit_plane_.size());
+      // planes without hits scan the gaps of all the slots
+      for ( int iplane = 0; iplane < NINJA_TRACKER_NUM_PLANES; iplane++ )
+	work += item_plane_slot_.at(plane_slot_begin + iplane) >= 0 ?
+	  NUMBER_OF_LINES : NUMBER_OF_LINES * (NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE + 1);
+    } // iview
+  } // icluster
+
+  spill_item_begin_.push_back(item_view_.size());
+  spill_cluster_begin_.push_back(cluster_id_.size());
+  spill_work_.push_back(work);
+  spill_entry_.push_back(entry);
+
+}
+
+void NinjaPositionBatch::Reconstruct() {
+
+  const std::size_t number_of_items = item_view_.size();
+  item_position_.resize(number_of_items);
+  item_fallback_.assign(number_of_items, 0);
+  for ( std::size_t ispill = 0; ispill < spill_work_.size(); ispill++ ) {
+    // all the spills of an input entry are charged to the budget of the entry
+    EntryBudget spill_budget;
+    EntryBudget &budget = spill_entry_.at(ispill) >= 0 ? entry_budgets_[spill_entry_.at(ispill)] : spill_budget;
+    const auto start = std::chrono::steady_clock::now();
+    budget.work += spill_work_.at(ispill);
+    bool over_budget = budget.over_budget || ( max_work_ > 0 && budget.work > max_work_ );
+    for ( int iitem = spill_item_begin_.at(ispill); iitem < spill_item_begin_.at(ispill + 1); iitem++ ) {
+      // the remaining items of the spill fall back once the time budget is used up
+      if ( !over_budget && max_time_ > 0. &&
+	   budget.time + std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > max_time_ )
+	over_budget = true;
+      const int hit_begin = item_hit_begin_.at(iitem);
+      const int number_of_hits = item_hit_begin_.at(iitem + 1) - hit_begin;
+      const int *plane_slot = &item_plane_slot_.at(iitem * NINJA_TRACKER_NUM_PLANES);
+      item_position_.at(iitem) = ReconstructNinjaPositionItem
+	(item_view_.at(iitem), over_budget, item_tangent_.at(iitem), plane_slot,
+	 hit_plane_.data() + hit_begin, hit_slot_.data() + hit_begin, number_of_hits);
+      item_fallback_.at(iitem) = over_budget;
+    }
+    budget.time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if ( over_budget && !budget.over_budget ) {
+      budget.over_budget = true;
+      number_of_fallback_spills_++;
+    }
+  }
+
+  // Scatter back to each cluster
+  std::vector<double> position(2);
+  for ( std::size_t icluster = 0; icluster < cluster_spill_.size(); icluster++ ) {
+    int fallback = 0;
+    for ( int iview = 0; iview < 2; iview++ ) {
+      const int iitem = cluster_item_[iview].at(icluster);
+      if ( iitem >= 0 ) {
+	position.at(iview) = item_position_.at(iitem);
+	fallback = fallback || item_fallback_.at(iitem);
+      } else { // view without hits gives the average of no hit as before
+	const int number_of_hits = cluster_spill_.at(icluster)->GetNumberOfHits(cluster_id_.at(icluster), iview);
+	position.at(iview) = 0.;
+	position.at(iview) /= number_of_hits;
+      }
+    }
+    cluster_spill_.at(icluster)->SetNinjaPosition(cluster_id_.at(icluster), position);
+    cluster_spill_.at(icluster)->SetNinjaPositionFallback(cluster_id_.at(icluster), fallback);
+  }
+
+  // Fallback clusters of the spills of the same entry are counted once
+  for ( std::size_t ispill = 0; ispill < spill_work_.size(); ispill++ ) {
+    std::size_t number_of_fallback_clusters = 0;
+    for ( int icluster = spill_cluster_begin_.at(ispill); icluster < spill_cluster_begin_.at(ispill + 1); icluster++ )
+      number_of_fallback_clusters += cluster_spill_.at(icluster)->GetNinjaPositionFallback(cluster_id_.at(icluster));
+    if ( spill_entry_.at(ispill) < 0 ) {
+      number_of_fallback_clusters_ += number_of_fallback_clusters;
+      continue;
+    }
+    EntryBudget &budget = entry_budgets_[spill_entry_.at(ispill)];
+    if ( number_of_fallback_clusters > budget.number_of_fallback_clusters ) {
+      number_of_fallback_clusters_ += number_of_fallback_clusters - budget.number_of_fallback_clusters;
+      budget.number_of_fallback_clusters = number_of_fallback_clusters;
+    }
+  }
+
+  Clear();
+
+}
+
+void NinjaPositionBatch::SetSpillBudget(long max_work, double max_time) {
+  max_work_ = max_work;
+  max_time_ = max_time;
+}
+
+void NinjaPositionBatch::ClearBudgets() {
+  entry_budgets_.clear();
+}
+
+std::size_t NinjaPositionBatch::GetNumberOfFallbackSpills() const {
+  return number_of_fallback_spills_;
+}
+
+std::size_t NinjaPositionBatch::GetNumberOfFallbackClusters() const {
+  return number_of_fallback_clusters_;
+}
+
+void NinjaPositionBatch::ResetStatistics() {
+  number_of_fallback_spills_ = 0;
+  number_of_fallback_clusters_ = 0;
+}
+
+std::size_t NinjaPositionBatch::GetNumberOfItems() const {
+  return item_view_.size();
+}
+
+void NinjaPositionBatch::Clear() {
+  spill_item_begin_.clear();
+  spill_cluster_begin_.clear();
+  spill_work_.clear();
+  spill_entry_.clear();
+  cluster_spill_.clear();
+  cluster_id_.clear();
+  for ( int iview = 0; iview < 2; iview++ )
+    cluster_item_[iview].clear();
+  item_view_.clear();
+  item_tangent_.clear();
+  item_plane_slot_.clear();
+  item_hit_begin_.clear();
+  hit_plane_.clear();
+  hit_slot_.clear();
+  item_position_.clear();
+  item_fallback_.clear();
+}
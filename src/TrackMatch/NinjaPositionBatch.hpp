@@ -0,0 +1,126 @@
+#ifndef NINJARECON_NINJAPOSITIONBATCH_HPP
+#define NINJARECON_NINJAPOSITIONBATCH_HPP
+
+#include <vector>
+#include <map>
+
+#include "NTBMSummary.hh"
+
+/**
+ * Batched NINJA tracker cluster position reconstruction.
+ * Clusters of many spills are gathered into a structure-of-arrays batch of
+ * (cluster, view) items holding the tangent and the hit pattern. Each item
+ * is reconstructed by kernels running over all the candidate lines drawn from
+ * the scintillator vertices at once, using a precomputed geometry table.
+ * Results are scattered back to the NTBMSummary objects, identical to the
+ * cluster by cluster reconstruction.
+ */
+class NinjaPositionBatch {
+
+public :
+
+  /**
+   * Gather all the clusters of the spill. The object must be alive
+   * and its clusters must not change until Reconstruct is called.
+   * Spills added with the same input entry (e.g. the reconstruction without tangent
+   * and the z shift copies) share one budget until ClearBudgets is called.
+   * @param ntbm NTBMSummary object with tangent information
+   * @param entry input entry of the spill (negative : own budget for this spill only)
+   */
+  void AddSpill(NTBMSummary *ntbm, Long64_t entry = -1);
+
+  /**
+   * Reconstruct positions of all the gathered clusters, set them
+   * to the NTBMSummary objects and clear the batch
+   */
+  void Reconstruct();
+
+  /**
+   * Set the per-spill budget of the reconstruction so that noisy spills do not dominate
+   * the run time. Clusters of a spill exceeding the budget get the average position of
+   * their hit bars and are flagged with NTBMSummary::SetNinjaPositionFallback.
+   * @param max_work maximum number of (line, plane, slot) evaluations in one spill (0 : no limit)
+   * @param max_time maximum reconstruction time of one spill [s] (0 : no limit)
+   */
+  void SetSpillBudget(long max_work, double max_time);
+
+  /**
+   * Forget the budgets used by the input entries, called once all the
+   * spills of the entries are reconstructed
+   */
+  void ClearBudgets();
+
+  /**
+   * @return number of input entries (or spills without entry) which exceeded
+   * the budget since the last ResetStatistics
+   */
+  std::size_t GetNumberOfFallbackSpills() const;
+
+  /**
+   * @return number of clusters with the fallback position since the last ResetStatistics,
+   * the spills of the same input entry count the clusters of the entry once (the largest number)
+   */
+  std::size_t GetNumberOfFallbackClusters() const;
+
+  /**
+   * Reset fallback spill and cluster counters
+   */
+  void ResetStatistics();
+
+  /**
+   * @return number of (cluster, view) items in the batch
+   */
+  std::size_t GetNumberOfItems() const;
+
+  /**
+   * Clear the batch keeping the capacity
+   */
+  void Clear();
+
+private :
+
+  /**
+   * Budget used by one input entry
+   */
+  struct EntryBudget {
+    long work = 0;
+    double time = 0.;
+    bool over_budget = false;
+    std::size_t number_of_fallback_clusters = 0;
+  };
+
+  // per-spill budget
+  long max_work_ = 0;
+  double max_time_ = 0.;
+  std::size_t number_of_fallback_spills_ = 0;
+  std::size_t number_of_fallback_clusters_ = 0;
+  std::map<Long64_t, EntryBudget> entry_budgets_;
+
+  // gathered spills, items of the spill are [spill_item_begin_[i], spill_item_begin_[i + 1])
+  // and clusters are [spill_cluster_begin_[i], spill_cluster_begin_[i + 1])
+  std::vector<int> spill_item_begin_;
+  std::vector<int> spill_cluster_begin_;
+  std::vector<long> spill_work_;
+  std::vector<Long64_t> spill_entry_;
+
+  // gathered clusters
+  std::vector<NTBMSummary*> cluster_spill_;
+  std::vector<int> cluster_id_;
+  // item id for each cluster and view (-1 when the view has no hit)
+  std::vector<int> cluster_item_[2];
+
+  // (cluster, view) items
+  std::vector<int> item_view_;
+  std::vector<double> item_tangent_;
+  // slot of the last hit in each plane (-1 when the plane has no hit)
+  std::vector<int> item_plane_slot_;
+  // hits of the item are [item_hit_begin_[i], item_hit_begin_[i + 1])
+  std::vector<int> item_hit_begin_;
+  std::vector<int> hit_plane_;
+  std::vector<int> hit_slot_;
+  std::vector<double> item_position_;
+  std::vector<char> item_fallback_;
+
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "SpillArena.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+
+SpillArena::SpillArena(std::size_t block_size) :
+  block_size_(block_size), current_block_(0), offset_(0), used_bytes_(0), peak_bytes_(0) {}
+
+SpillArena::~SpillArena() {
+  for ( auto &block : blocks_ )
+    std::free(block.data);
+}
+
+void *SpillArena::Allocate(std::size_t size, std::size_t alignment) {
+  if ( size == 0 ) size = 1;
+  // first block with enough space from the current one
+  for ( ; current_block_ < blocks_.size(); current_block_++, offset_ = 0 ) {
+    const Block &block = blocks_.at(current_block_);
+    const std::size_t begin = ( offset_ + alignment - 1 ) & ~( alignment - 1 );
+    if ( begin + size <= block.size ) {
+      offset_ = begin + size;
+      used_bytes_ += size;
+      peak_bytes_ = std::max(peak_bytes_, used_bytes_);
+      return block.data + begin;
+    }
+  }
+  // new block (larger than the default one for a large request)
+  // malloc memory is aligned for any fundamental type
+  Block block;
+  block.size = std::max(block_size_, size);
+  block.data = static_cast<char*>(std::malloc(block.size));
+  if ( block.data == nullptr )
+    throw std::bad_alloc();
+  blocks_.push_back(block);
+  current_block_ = blocks_.size() - 1;
+  offset_ = size;
+  used_bytes_ += size;
+  peak_bytes_ = std::max(peak_bytes_, used_bytes_);
+  return block.data;
+}
+
+void SpillArena::Reset() {
+  current_block_ = 0;
+  offset_ = 0;
+  used_bytes_ = 0;
+}
+
+std::size_t SpillArena::GetUsedBytes() const {
+  return used_bytes_;
+}
+
+std::size_t SpillArena::GetPeakBytes() const {
+  return peak_bytes_;
+}
+
+std::size_t SpillArena::GetNumberOfBlocks() const {
+  return blocks_.size();
+}
+
+SpillArena &SpillArena::GetThreadArena() {
+  static thread_local SpillArena arena;
+  return arena;
+}
@@ -0,0 +1,129 @@
+#ifndef NINJARECON_SPILLARENA_HPP
+#define NINJARECON_SPILLARENA_HPP
+
+#include <cstddef>
+#include <vector>
+#include <map>
+#include <functional>
+
+/**
+ * Bump allocator for the scratch data of one spill. Allocations are taken from
+ * large blocks and are released all at once by Reset at the end of the spill.
+ * The blocks are kept, so that after the first spills no heap allocation is done.
+ * Each thread has its own arena (GetThreadArena), so no locking is needed.
+ */
+class SpillArena {
+
+public :
+
+  ///> Default block size [bytes]
+  static const std::size_t DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+  explicit SpillArena(std::size_t block_size = DEFAULT_BLOCK_SIZE);
+
+  ~SpillArena();
+
+  SpillArena(const SpillArena&) = delete;
+  SpillArena &operator=(const SpillArena&) = delete;
+
+  /**
+   * Allocate memory valid until the next Reset
+   * @param size size [bytes]
+   * @param alignment alignment [bytes] (power of two)
+   * @return pointer to the memory
+   */
+  void *Allocate(std::size_t size, std::size_t alignment);
+
+  /**
+   * Release all the allocations at once. The blocks are kept for the next spill.
+   * Objects allocated from the arena must not be used after Reset.
+   */
+  void Reset();
+
+  /**
+   * @return number of bytes allocated since the last Reset
+   */
+  std::size_t GetUsedBytes() const;
+
+  /**
+   * @return largest number of bytes allocated between two Resets
+   */
+  std::size_t GetPeakBytes() const;
+
+  /**
+   * @return number of blocks taken from the heap
+   */
+  std::size_t GetNumberOfBlocks() const;
+
+  /**
+   * @return arena of the calling thread
+   */
+  static SpillArena &GetThreadArena();
+
+private :
+
+  struct Block {
+    char *data;
+    std::size_t size;
+  };
+
+  std::vector<Block> blocks_;
+  std::size_t block_size_;
+  std::size_t current_block_;
+  std::size_t offset_;
+  std::size_t used_bytes_;
+  std::size_t peak_bytes_;
+
+};
+
+/**
+ * Standard allocator taking the memory from the spill arena of the calling thread.
+ * Deallocation does nothing, the memory is released by SpillArena::Reset.
+ */
+template < typename T >
+class SpillArenaAllocator {
+
+public :
+
+  typedef T value_type;
+
+  SpillArenaAllocator() : arena_(&SpillArena::GetThreadArena()) {}
+
+  explicit SpillArenaAllocator(SpillArena &arena) : arena_(&arena) {}
+
+  template < typename U >
+  SpillArenaAllocator(const SpillArenaAllocator<U> &other) : arena_(other.GetArena()) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T*, std::size_t) {}
+
+  SpillArena *GetArena() const { return arena_; }
+
+private :
+
+  SpillArena *arena_;
+
+};
+
+template < typename T, typename U >
+bool operator==(const SpillArenaAllocator<T> &lhs, const SpillArenaAllocator<U> &rhs) {
+  return lhs.GetArena() == rhs.GetArena();
+}
+
+template < typename T, typename U >
+bool operator!=(const SpillArenaAllocator<T> &lhs, const SpillArenaAllocator<U> &rhs) {
+  return !( lhs == rhs );
+}
+
+///> List allocated from the spill arena (valid until the end of the spill)
+template < typename T >
+using ScratchVector = std::vector<T, SpillArenaAllocator<T> >;
+
+///> Map allocated from the spill arena (valid until the end of the spill)
+template < typename Key, typename T >
+using ScratchMap = std::map<Key, T, std::less<Key>, SpillArenaAllocator<std::pair<const Key, T> > >;
+
+#endif
@@ -2,6 +2,8 @@
 #define NINJARECON_TRACKMATCH_HPP
 
 #include <vector>
+#include <array>
+#include <string>
 
 #include <TCanvas.h>
 
@@ -10,6 +12,29 @@
 #include "B2BeamSummary.hh"
 #include "B2TrackSummary.hh"
 #include "NTBMSummary.hh"
+#include "NTBMSmallVector.hh"
+#include "SpillArena.hpp"
+
+///> 1D cluster ids of one bunch difference (inline up to the usual number of clusters)
+typedef NTBMSmallVector<int, 32> NinjaClusterIdList;
+
+///> Hits of a spill or a track (spill arena)
+typedef ScratchVector<const B2HitSummary*> HitList;
+
+///> Hit positions of one Baby MIND plane .at(xy/z).at(hit) (spill arena)
+typedef ScratchVector<ScratchVector<double> > PlanePositionList;
+
+///> No offset of the Baby MIND extrapolation at the NINJA tracker .at(y/x) [mm]
+static const std::array<double, 2> NO_TRANSVERSE_OFFSET = {{0., 0.}};
+
+///> Nominal allowance of the Baby MIND extrapolation and NINJA cluster position difference .at(y/x) [mm]
+static const std::array<double, 2> NOMINAL_ALLOWANCE = {{TEMPORAL_ALLOWANCE[0], TEMPORAL_ALLOWANCE[1]}};
+
+///> Merged position and error of one Baby MIND plane .at(pos/higherr/lowerr).at(xy/z)
+typedef std::array<std::array<double, 2>, 3> PlanePositionAndError;
+
+///> Merged positions and errors of a track .at(view).at(pos/higherr/lowerr).at(xy/z).at(plane) (spill arena)
+typedef ScratchVector<ScratchVector<ScratchVector<ScratchVector<double> > > > MergedPositionAndErrors;
 
 /**
  * Comparator for B2HitSummary vector sort
@@ -19,20 +44,45 @@
  */
 bool CompareNinjaHits(const B2HitSummary* lhs, const B2HitSummary* rhs);
 
+/**
+ * Sort key of a NINJA hit with the view dependent position taken once
+ */
+struct NinjaHitSortKey {
+  int bunch;
+  int view;
+  double position;
+  const B2HitSummary *hit;
+};
+
+/**
+ * Create sort key of a NINJA hit
+ * @param hit NINJA hit
+ * @return sort key
+ */
+NinjaHitSortKey MakeNinjaHitSortKey(const B2HitSummary *hit);
+
+/**
+ * Comparator for NINJA hit sort keys (same order as CompareNinjaHits)
+ * @param lhs left hand side object
+ * @param rhs right hand side object
+ * @return true if the objects should not be swapped
+ */
+bool CompareNinjaHitSortKeys(const NinjaHitSortKey &lhs, const NinjaHitSortKey &rhs);
+
 /**
  * Comparator for B2HitSummary vector sort in one Baby MIND B2TrackSummary
  * @param lhs left hand side object
  * @param rhs right hand side object
  * @return true if the objects should not be swapped
  */
-bool CompareBabyMindHitInOneTrack(const B2HitSummary* lhs, const B2HitSummary *rhs);
+bool CompareBabyMindHitsInOneTrack(const B2HitSummary* lhs, const B2HitSummary *rhs);
 
 /**
  * Create NINJA tracker clusters
  * @param ninja_hits NINJA Hit summary vector
  * @param ninja_clusters NTBMSummary for the spill (x/y separated and only NINJA tracker data)
  */
-void CreateNinjaCluster(std::vector<const B2HitSummary*> ninja_hits, NTBMSummary* ninja_clusters);
+void CreateNinjaCluster(const HitList &ninja_hits, NTBMSummary* ninja_clusters);
 
 
 /**
@@ -41,7 +91,15 @@ void CreateNinjaCluster(std::vector<const B2HitSummary*> ninja_hits, NTBMSummary
  * @param view view
  * @return position and error for one Baby MIND plane
  */
-std::vector<std::vector<double> > CalcMergedOnePlanePositionAndError(std::vector<std::vector<double> > position, int view);
+PlanePositionAndError CalcMergedOnePlanePositionAndError(const PlanePositionList &position, int view);
+
+/**
+ * Same as above specialized on the view
+ * @param position position list of Baby MIND hits
+ * @return position and error for one Baby MIND plane
+ */
+template <int View>
+PlanePositionAndError CalcMergedOnePlanePositionAndError(const PlanePositionList &position);
 
 /**
  * Get position and error for Baby MIND planes
@@ -49,7 +107,15 @@ std::vector<std::vector<double> > CalcMergedOnePlanePositionAndError(std::vector
  * @param datatype MC or real data
  * @return Baby MIND position and errors
  */
-std::vector<std::vector<std::vector<std::vector<double> > > > GenerateMergedPositionAndErrors(std::vector<const B2HitSummary* > hits, int datatype);
+MergedPositionAndErrors GenerateMergedPositionAndErrors(HitList hits, int datatype);
+
+/**
+ * Same as above specialized on the data type
+ * @param hits vector of Baby MIND B2HitSummary objects
+ * @return Baby MIND position and errors
+ */
+template <int DataType>
+MergedPositionAndErrors GenerateMergedPositionAndErrors(HitList hits);
 
 /**
  * Fit Baby MIND
@@ -62,19 +128,22 @@ std::vector<std::vector<double> > FitBabyMind(const B2TrackSummary *track, int d
 /**
  * Get Baby MIND initial direction
  * @param track reconstructed B2TrackSummary object
+ * @param datatype MC or real data
  * @return at(0) means y and at(1) does x directions 
  * at(2) means y and at(3) does x positions
  */
-std::vector<double> GetBabyMindInitialDirectionAndPosition(const B2TrackSummary *track);
+std::vector<double> GetBabyMindInitialDirectionAndPosition(const B2TrackSummary *track, int datatype);
 
 /**
  * Calculate hit expected position on the NINJA tracker position
  * @param ntbm NTBMSummary object of the spill in interest
  * @param itrack Baby MIND track id (incremented from 0 NINJA internally)
  * @param z_shift Difference of z distance from nominal
+ * @param transverse_offset y/x offset added to the extrapolated position (alignment scan)
  * @return at(0) means y and at(1) means x
  */
-std::vector<double> CalculateExpectedPosition(NTBMSummary *ntbm, int itrack, double z_shift);
+std::array<double, 2> CalculateExpectedPosition(const NTBMSummary *ntbm, int itrack, double z_shift,
+						const std::array<double, 2> &transverse_offset = NO_TRANSVERSE_OFFSET);
 
 /**
  * Check if the Baby MIND reconstructed track expected to have hits
@@ -82,9 +151,38 @@ std::vector<double> CalculateExpectedPosition(NTBMSummary *ntbm, int itrack, dou
  * @param ntbm NTBMSummary object of the spill in interest
  * @param itrack Baby MIND track id (incremented from 0 NINJA internally)
  * @param z_shift Difference of z distance from nominal
+ * @param transverse_offset y/x offset added to the extrapolated position (alignment scan)
+ * @param allowance y/x allowance outside the tracker area
  * @return true if the track expected to have hits else false
  */
-bool NinjaHitExpected(NTBMSummary *ntbm, int itrack, double z_shift);
+bool NinjaHitExpected(NTBMSummary *ntbm, int itrack, double z_shift,
+		      const std::array<double, 2> &transverse_offset = NO_TRANSVERSE_OFFSET,
+		      const std::array<double, 2> &allowance = NOMINAL_ALLOWANCE);
+
+/**
+ * Find the closest 1D NINJA cluster in each view to the Baby MIND extrapolation.
+ * The NTBMSummary object is not modified.
+ * @param ntbm NTBMSummary object created in the CreateNinjaCluster function
+ * @param hit_expected_position expected position calculated in CalculateExpectedPosition
+ * @param cluster_ids 1D cluster ids to be searched (usually the clusters of one bunch difference)
+ * @param matched_cluster at(0) means y and at(1) means x cluster id (updated only if found)
+ * @param allowance y/x allowance of the position difference
+ * @return true if clusters within the allowance are found in both views
+ */
+bool FindMatchedNinjaClusters(const NTBMSummary *ntbm, const std::array<double, 2> &hit_expected_position,
+			      const NinjaClusterIdList &cluster_ids, std::array<int, 2> &matched_cluster,
+			      const std::array<double, 2> &allowance = NOMINAL_ALLOWANCE);
+
+/**
+ * Merge the matched 1D clusters into a new 2D cluster and add it to the NTBMSummary.
+ * The 2D cluster refers to the hits of the 1D clusters instead of copying them.
+ * @param ntbm NTBMSummary object of the spill in interest
+ * @param itrack Baby MIND track id (incremented from 0 NINJA internally)
+ * @param bunch_difference Bunch difference b/w NINJA and Baby MIND
+ * @param matched_cluster y/x 1D cluster ids found in FindMatchedNinjaClusters
+ */
+void AddMatchedNinjaCluster(NTBMSummary *ntbm, int itrack, int bunch_difference,
+			    const std::array<int, 2> &matched_cluster);
 
 /**
  * Track matching between Baby MIND and NINJA tracker using x/y separated NTBMSummary
@@ -97,6 +195,46 @@ bool NinjaHitExpected(NTBMSummary *ntbm, int itrack, double z_shift);
  */
 bool MatchBabyMindTrack(NTBMSummary *ntbm, int itrack, int &bunch_diff, double z_shift);
 
+/**
+ * Match all Baby MIND tracks in the spill to NINJA 1D clusters and reconstruct
+ * tangent of the matched 2D clusters (position is not reconstructed).
+ * The scratch data are taken from the spill arena of the calling thread,
+ * the caller resets it (SpillArena::Reset) after each spill.
+ * @param ntbm NTBMSummary object after the CreateNinjaCluster and TransferBabyMindTrackInfo functions
+ * @param z_shift Difference of z distance from nominal
+ * @param transverse_offset y/x offset added to the Baby MIND extrapolation (alignment scan)
+ * @param allowance y/x allowance of the bunch candidate search (alignment scan)
+ */
+void MatchNinjaClusters(NTBMSummary *ntbm, double z_shift,
+			const std::array<double, 2> &transverse_offset = NO_TRANSVERSE_OFFSET,
+			const std::array<double, 2> &allowance = NOMINAL_ALLOWANCE);
+
+/**
+ * Match all Baby MIND tracks in the spill to NINJA 1D clusters and reconstruct
+ * tangent/position of the matched 2D clusters. Only this step depends on z shift.
+ * The start bunch of the spill is first decided by a vote over all the track/cluster
+ * candidates, then each track is matched independently, so the result does not
+ * depend on the order of the tracks.
+ * @param ntbm NTBMSummary object after the CreateNinjaCluster and TransferBabyMindTrackInfo functions
+ * @param z_shift Difference of z distance from nominal
+ */
+void MatchAndReconstructNinjaClusters(NTBMSummary *ntbm, double z_shift);
+
+/**
+ * Parse scan argument
+ * @param scan_string single value, comma separated list or <start>:<stop>:<step> (stop included)
+ * @param name name of the scanned value used in the error messages
+ * @return list of values
+ */
+std::vector<double> ParseScanValues(const std::string &scan_string, const std::string &name);
+
+/**
+ * Parse z shift argument
+ * @param z_shift_string single value, comma separated list or <start>:<stop>:<step> (stop included)
+ * @return list of z shifts
+ */
+std::vector<double> ParseZShifts(const std::string &z_shift_string);
+
 /**
  * Get boolean if the value is in range [min, max]
  * @param pos position to be evaluated
@@ -113,6 +251,15 @@ bool IsInRange(double pos, double min, double max);
  */
 bool IsMakeHit(double min, double max, int view, int plane, int slot);
 
+/**
+ * Same as IsMakeHit with the scintillator bar position already known
+ * @param min minimum value of the range
+ * @param max maximum value of the range
+ * @param view slot detector ids of the scintillator bar
+ * @param position_xy scintillator bar position in the tracker box coordinate
+ */
+bool IsMakeHitAtPosition(double min, double max, int view, int slot, double position_xy);
+
 /**
  * Get boolean if range [min, max] is between i and i+1-th scintillator bars
  * @param min minimum value of the range
@@ -121,6 +268,15 @@ bool IsMakeHit(double min, double max, int view, int plane, int slot);
  */
 bool IsInGap(double min, double max, int view, int plane, int slot);
 
+/**
+ * Same as IsInGap with the scintillator bar position already known
+ * @param min minimum value of the range
+ * @param max maximum value of the range
+ * @param view pln slot detector ids of the scintillator bar including slot = -1
+ * @param position_xy scintillator bar position in the tracker box coordinate (slot 0 for slot = -1)
+ */
+bool IsInGapAtPosition(double min, double max, int view, int plane, int slot, double position_xy);
+
 /**
  * Get the minimum value of the position where the line intercepts
  * @param pos track start position
@@ -139,7 +295,7 @@ double GetTrackAreaMin(double pos, double tangent, int iplane, int jplane, int v
  * @param jplane plane id of the intercept evaluated scintillator bar
  * @param vertex vertex position of the track starting point
  */
-double GetTrackAreMax(double pos, double tangent, int iplane, int jplane, int vertex);
+double GetTrackAreaMax(double pos, double tangent, int iplane, int jplane, int vertex);
 
 /**
  * Get boolean if the normal track analysis is possible
@@ -164,7 +320,8 @@ void ReconstructNinjaTangent(NTBMSummary* ntbm);
 
 /**
  * Use Baby MIND information, reconstruct position for matching
- * between NINJA tracker and Emulsion shifter
+ * between NINJA tracker and Emulsion shifter.
+ * Use NinjaPositionBatch to reconstruct clusters of many spills at once.
  * @param ntbm NTBMSummary object after the MatchBabyMindTrack function
  */
 void ReconstructNinjaPosition(NTBMSummary* ntbm);
@@ -177,26 +334,47 @@ void ReconstructNinjaPosition(NTBMSummary* ntbm);
  */
 void SetTruePositionAngle(const B2SpillSummary& spill_summary, NTBMSummary* ntbm_summary);
 
+/**
+ * Find the true muon at the TSS downstream film extrapolated to the NINJA tracker
+ * @param spill_summary B2SpillSummary object
+ * @param true_position at(0) means y and at(1) means x position
+ * @param true_tangent at(0) means y and at(1) means x tangent
+ * @return true if the true muon is found
+ */
+bool FindTrueNinjaMuon(const B2SpillSummary& spill_summary,
+		       std::array<double, 2> &true_position, std::array<double, 2> &true_tangent);
+
+/**
+ * Set the true muon found by FindTrueNinjaMuon to the 2D clusters, so that the
+ * B2SpillSummary object is not needed after the matching
+ * @param true_position at(0) means y and at(1) means x position
+ * @param true_tangent at(0) means y and at(1) means x tangent
+ * @param ntbm_summary NTBMSummary object
+ */
+void SetTruePositionAngle(const std::array<double, 2> &true_position,
+			  const std::array<double, 2> &true_tangent, NTBMSummary* ntbm_summary);
+
 /**
  * Transfer Beam information from B2BeamSummary to NTBMSummary
  * @param spill_summary B2SpillSummary object
  * @param ntbm_summary NTBMSummary object
- * @param datatype MC or real data
  */
-void TransferBeamInfo(const B2SpillSummary& spill_summary, NTBMSummary* ntbm_summary, int datatype);
+void TransferBeamInfo(const B2SpillSummary& spill_summary, NTBMSummary* ntbm_summary);
 
 /**
  * Transfer Baby MIND track info from B2TrackSummary to NTBMSummary
+ * (tracks are appended to the ones already in the NTBMSummary)
  * @param spill_summary B2SpillSummary object
  * @param ntbm_summary NTBMSummary object
+ * @param datatype MC or real data
  */
-void TransferBabyMindTrackInfo(const B2SpillSummary& spill_summary, NTBMSummary ntbm_summary);
+void TransferBabyMindTrackInfo(const B2SpillSummary& spill_summary, NTBMSummary* ntbm_summary, int datatype);
 
 /**
  * Transfer MC normalization info from B2EventSummary to NTBMSummary
  * @param spill_summary B2SpillSummary object
  * @param ntbmsummary NTBMSummary object
  */
-void TransferMCInfo(const B2SpillSummary& spill_summary, NTBMSummary ntbm_summary);
+void TransferMCInfo(const B2SpillSummary& spill_summary, NTBMSummary* ntbm_summary);
 
 #endif
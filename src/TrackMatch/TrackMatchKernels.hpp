@@ -0,0 +1,130 @@
+#ifndef NINJARECON_TRACKMATCHKERNELS_HPP
+#define NINJARECON_TRACKMATCHKERNELS_HPP
+
+#include <TVector3.h>
+
+#include <B2Enum.hh>
+#include <B2Const.hh>
+
+#include "NTBMConst.hh"
+
+/*
+ * Kernels specialized on the view at compile time.
+ * The runtime view versions in TrackMatch.hpp dispatch to these once,
+ * so that loops calling them with a fixed view can be inlined and
+ * vectorized without branching on the view for each element.
+ */
+
+/**
+ * Get position of the view from a 3D position
+ * @param position 3D position
+ * @return y for side view and x for top view
+ */
+template <int View>
+inline double GetViewPosition(const TVector3 &position);
+
+template <>
+inline double GetViewPosition<B2View::kSideView>(const TVector3 &position) {
+  return position.Y();
+}
+
+template <>
+inline double GetViewPosition<B2View::kTopView>(const TVector3 &position) {
+  return position.X();
+}
+
+/**
+ * Same as IsInRange without the range check (the ranges used in the kernels
+ * are ordered by construction)
+ * @param pos position to be evaluated
+ * @param min minimum value of the range
+ * @param max maximum value of the range
+ */
+inline bool IsInOrderedRange(double pos, double min, double max) {
+  return min <= pos && pos <= max;
+}
+
+/**
+ * Get boolean if range [min, max] makes hit in a scintillator bar
+ * @param min minimum value of the range
+ * @param max maximum value of the range
+ * @param slot slot id of the scintillator bar
+ * @param position_xy scintillator bar position in the tracker box coordinate
+ */
+template <int View>
+inline bool IsMakeHitAtPosition(double min, double max, int slot, double position_xy) {
+
+  const double bar_low = position_xy - NINJA_SCI_WIDTH / 2.;
+  const double bar_high = position_xy + NINJA_SCI_WIDTH / 2.;
+
+  // Edge channels
+  // The side view slot 0 and the top view last slot are at the high end of the plane
+  const bool is_high_edge = View == B2View::kSideView ?
+    slot == 0 : slot == NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE - 1;
+  const bool is_low_edge = View == B2View::kSideView ?
+    slot == NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE - 1 : slot == 0;
+  if ( is_high_edge )
+    return IsInOrderedRange(max, bar_low, bar_high) ||
+      ( IsInOrderedRange(max, bar_high, bar_high + NINJA_TRACKER_GAP) &&
+	IsInOrderedRange(min, bar_low, bar_high) );
+  if ( is_low_edge )
+    return IsInOrderedRange(min, bar_low, bar_high) ||
+      ( IsInOrderedRange(min, bar_low - NINJA_TRACKER_GAP, bar_low) &&
+	IsInOrderedRange(max, bar_low, bar_high) );
+
+  // The other channels
+  return IsInOrderedRange(min, bar_low - NINJA_TRACKER_GAP, bar_high)
+    && IsInOrderedRange(max, bar_low, bar_high + NINJA_TRACKER_GAP);
+
+}
+
+/**
+ * Get boolean if range [min, max] is between i and i+1-th scintillator bars
+ * @param min minimum value of the range
+ * @param max maximum value of the range
+ * @param plane slot detector ids of the scintillator bar including slot = -1
+ * @param position_xy scintillator bar position in the tracker box coordinate (slot 0 for slot = -1)
+ */
+template <int View>
+inline bool IsInGapAtPosition(double min, double max, int plane, int slot, double position_xy) {
+
+  // Dead channels
+  if ( View == B2View::kSideView && plane == 2 ) {
+    if ( slot == 29 ) return position_xy + NINJA_SCI_WIDTH / 2. <= min;
+    else if ( slot == 30 ) return false;
+  }
+  if ( View == B2View::kTopView && plane == 1 ) {
+    if ( slot == -1 || slot == 0 ) return false;
+    else if ( slot == 1 ) return position_xy - NINJA_SCI_WIDTH / 2. - NINJA_TRACKER_GAP <= min;
+    else if ( slot == 6 ) return position_xy - NINJA_SCI_WIDTH * 3 / 2. - 2 * NINJA_TRACKER_GAP <= min &&
+			    max <= position_xy - NINJA_SCI_WIDTH / 2.;
+    else if ( slot == 7 ) return false;
+  }
+  if ( View == B2View::kTopView && plane == 2 ) {
+    if ( slot == 19 ) return position_xy - NINJA_SCI_WIDTH * 3 / 2. - 2 * NINJA_TRACKER_GAP <= min &&
+			max <= position_xy - NINJA_SCI_WIDTH / 2.;
+    else if ( slot == 20 ) return false;
+  }
+
+  // The other channels
+  if ( View == B2View::kSideView ) {
+    if ( slot == -1 )
+      return max <= position_xy - NINJA_SCI_WIDTH / 2.;
+    else if ( slot == NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE - 1 )
+      return position_xy + NINJA_SCI_WIDTH / 2. <= min;
+    else
+      return position_xy + NINJA_SCI_WIDTH / 2. <= min &&
+	max <= position_xy + NINJA_SCI_WIDTH / 2. + NINJA_TRACKER_GAP;
+  } else {
+    if ( slot == -1 )
+      return position_xy + NINJA_SCI_WIDTH / 2. <= min;
+    else if ( slot == NINJA_TRACKER_NUM_CHANNELS_ONE_PLANE - 1 )
+      return max <= position_xy - NINJA_SCI_WIDTH / 2.;
+    else
+      return position_xy - NINJA_SCI_WIDTH / 2. - NINJA_TRACKER_GAP <= min &&
+	max <= position_xy - NINJA_SCI_WIDTH / 2.;
+  }
+
+}
+
+#endif
@@ -0,0 +1,545 @@
+// system includes
+#include <vector>
+#include <string>
+#include <fstream>
+#include <memory>
+#include <array>
+
+// boost includes
+#include <boost/program_options.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+
+// root includes
+#include <TFile.h>
+#include <TTree.h>
+#include <TParameter.h>
+#include <TROOT.h>
+#include <TEnv.h>
+
+// B2 includes
+#include <B2Reader.hh>
+#include <B2Enum.hh>
+#include <B2Const.hh>
+#include <B2SpillSummary.hh>
+#include <B2HitSummary.hh>
+#include <B2VertexSummary.hh>
+#include <B2TrackSummary.hh>
+#include "NTBMSummary.hh"
+#include "NTBMSummaryPool.hh"
+#include "NTBMNTuple.hh"
+#include "NTBMSkim.hh"
+#include "NinjaGeometry.hh"
+
+#include "TrackMatch.hpp"
+#include "AlignmentCache.hpp"
+#include "B2ReadAhead.hpp"
+#include "NinjaPositionBatch.hpp"
+#include "SpillArena.hpp"
+#ifdef NTBM_COUNT_ALLOCATIONS
+#include "AllocationCounter.hpp"
+#endif
+#include "WorkerQueue.hh"
+#include "NTBMStartupMarker.hh"
+
+namespace logging = boost::log;
+namespace po = boost::program_options;
+
+/**
+ * Settings shared by all the files processed by one TrackMatch process
+ */
+struct TrackMatchSettings {
+  ///> z shifts from nominal [mm]
+  std::vector<double> z_shifts;
+  ///> MC(0)/data(1)
+  int datatype;
+  ///> first entry of the input file to be processed
+  Long64_t first_entry;
+  ///> last entry of the input file to be processed (-1 : until the end of the file)
+  Long64_t last_entry;
+  ///> number of spills decoded ahead in a background thread
+  unsigned int read_ahead_depth;
+  ///> maximum position reconstruction work in one spill (0 : no limit)
+  long spill_work_budget;
+  ///> maximum position reconstruction time of one spill [s] (0 : no limit)
+  double spill_time_budget;
+  ///> write the NTBMSummary objects in RNTuples instead of TTrees
+  bool rntuple;
+  ///> number of spills matched and reconstructed together
+  std::size_t batch_spills;
+};
+
+/**
+ * Spill waiting in the batch for the matching and the position reconstruction
+ */
+struct BatchSpill {
+  ///> entry in the input file
+  Long64_t entry;
+  ///> number of Baby MIND tracks
+  int number_of_tracks;
+  ///> true muon found at the TSS (MC)
+  bool has_true_muon;
+  std::array<double, 2> true_position;
+  std::array<double, 2> true_tangent;
+  ///> NTBMSummary objects of all the z shifts (the first one holds the z shift independent part)
+  std::vector<NTBMSummaryPool::Pointer> ntbms;
+};
+
+/**
+ * Match tracks of one input file
+ * @param input input B2 file path
+ * @param output output NTBM file path
+ * @param alignment_cache_path output alignment cache file path (empty : not written)
+ * @param settings settings shared by all the files
+ * @param position_batch position reconstruction batch reused between files
+ */
+void MatchFile(const std::string &input, const std::string &output, const std::string &alignment_cache_path,
+	       const TrackMatchSettings &settings, NinjaPositionBatch &position_batch) {
+
+  BOOST_LOG_TRIVIAL(info) << "Input  file : " << input;
+  BOOST_LOG_TRIVIAL(info) << "Output file : " << output;
+
+  B2ReadAhead read_ahead(input, settings.read_ahead_depth);
+  position_batch.SetSpillBudget(settings.spill_work_budget, settings.spill_time_budget);
+  position_batch.ResetStatistics();
+  position_batch.ClearBudgets();
+
+  // Entry range to be processed (both ends included)
+  // One daily file can be split into shards and merged with ShardMerger
+  const Long64_t number_of_entries = read_ahead.GetEntries();
+  const Long64_t first_entry = settings.first_entry;
+  Long64_t last_entry = settings.last_entry;
+  if ( last_entry < 0 || last_entry >= number_of_entries )
+    last_entry = number_of_entries - 1;
+  if ( first_entry < 0 || first_entry > last_entry )
+    throw std::invalid_argument("Entry range not valid : " + std::to_string(first_entry)
+				+ " - " + std::to_string(last_entry));
+  BOOST_LOG_TRIVIAL(info) << "Entry range : " << first_entry << " - " << last_entry
+			  << " (" << number_of_entries << " entries in the file)";
+
+  const std::vector<double> &z_shifts = settings.z_shifts;
+  const int number_of_z_shifts = z_shifts.size();
+  const int datatype = settings.datatype;
+
+  // Spills of one batch, each with the NTBMSummary objects of all the z shifts.
+  // NTBMSummary objects (and their list capacity) are reused by all the files of the thread.
+  // They are returned to the pool after the output file (and its trees) is deleted.
+  NTBMSummaryPool &ntbm_pool = NTBMSummaryPool::GetThreadPool();
+  std::vector<BatchSpill> batch(settings.batch_spills);
+  for ( auto &spill : batch )
+    for ( int ishift = 0; ishift < number_of_z_shifts; ishift++ )
+      spill.ntbms.push_back(ntbm_pool.Acquire());
+  // objects of the output branches, pointed to the spill being filled
+  std::vector<NTBMSummary*> ntbms(number_of_z_shifts, nullptr);
+  for ( int ishift = 0; ishift < number_of_z_shifts; ishift++ )
+    ntbms.at(ishift) = batch.front().ntbms.at(ishift).get();
+
+  // One output tree (or RNTuple) for each z shift
+  // "tree" for a single z shift and "tree_zshift<i>" for a z shift sweep
+  // the file is also closed when a job of the worker mode fails
+  std::unique_ptr<TFile> ntbm_file(new TFile(output.c_str(), "recreate"));
+  std::vector<TTree*> ntbm_trees;
+  std::vector<std::unique_ptr<NTBMNTupleWriter>> ntbm_ntuples;
+  // Entries with matched 2d clusters of each tree, written alongside the trees
+  std::vector<NTBMSkim> ntbm_skims;
+  for ( int ishift = 0; ishift < number_of_z_shifts; ishift++ ) {
+    const std::string name = number_of_z_shifts == 1 ? "tree" : Form("tree_zshift%d", ishift);
+    ntbm_skims.emplace_back(name);
+    if ( settings.rntuple ) {
+      ntbm_ntuples.emplace_back(new NTBMNTupleWriter(*ntbm_file, name));
+    } else if ( number_of_z_shifts == 1 ) {
+      ntbm_trees.push_back(new TTree(name.c_str(), "NINJA BabyMIND Original Summary"));
+      NTBMSummary::CreateBranch(ntbm_trees.back(), &ntbms.at(ishift));
+    } else {
+      ntbm_trees.push_back(new TTree(name.c_str(),
+				     Form("NINJA BabyMIND Original Summary (z shift = %.1f mm)",
+					  z_shifts.at(ishift))));
+      NTBMSummary::CreateBranch(ntbm_trees.back(), &ntbms.at(ishift));
+    }
+  }
+  // z shift independent information dumped for fast offline re-matching
+  std::unique_ptr<std::ofstream> alignment_cache;
+  if ( !alignment_cache_path.empty() ) {
+    alignment_cache.reset(new std::ofstream(alignment_cache_path, std::ios::binary | std::ios::trunc));
+    if ( !alignment_cache->is_open() )
+      throw std::runtime_error("Cannot open alignment cache : " + alignment_cache_path);
+    WriteAlignmentCacheHeader(*alignment_cache, datatype);
+  }
+
+  int nspill = 0;
+#ifdef NTBM_COUNT_ALLOCATIONS
+  // heap allocations of this thread from the end of the first spill (steady state)
+  std::size_t number_of_allocations_after_first_spill = 0;
+#endif
+
+  // Matching and position reconstruction of the spills in the batch. The positions of all
+  // the spills (and z shifts) are reconstructed in one NinjaPositionBatch for each pass.
+  std::size_t batch_size = 0;
+  auto match_batch = [&]() {
+    // Positions without tangent of the 1D clusters
+    position_batch.Reconstruct();
+
+    for ( std::size_t ispill = 0; ispill < batch_size; ispill++ ) {
+      BatchSpill &spill = batch.at(ispill);
+      NTBMSummary *my_ntbm = spill.ntbms.front().get();
+      if ( alignment_cache )
+	WriteAlignmentCacheSpill(*alignment_cache, *my_ntbm);
+      // Everything above does not depend on z shift and is shared.
+      // The first z shift is processed in place after the others use copies.
+      for ( int ishift = number_of_z_shifts - 1; ishift >= 0; ishift-- ) {
+	NTBMSummary *shift_ntbm = spill.ntbms.at(ishift).get();
+	if ( ishift != 0 ) *shift_ntbm = *my_ntbm;
+	if ( spill.number_of_tracks > 0 ) {
+	  MatchNinjaClusters(shift_ntbm, z_shifts.at(ishift));
+	  position_batch.AddSpill(shift_ntbm, spill.entry);
+	}
+      }
+      SpillArena::GetThreadArena().Reset();
+    }
+    // Positions with tangent of all the z shifts
+    position_batch.Reconstruct();
+    // all the passes of the entries are reconstructed, one budget for each entry
+    position_batch.ClearBudgets();
+
+    for ( std::size_t ispill = 0; ispill < batch_size; ispill++ ) {
+      BatchSpill &spill = batch.at(ispill);
+      for ( int ishift = number_of_z_shifts - 1; ishift >= 0; ishift-- ) {
+	NTBMSummary *shift_ntbm = spill.ntbms.at(ishift).get();
+	if ( spill.has_true_muon )
+	  SetTruePositionAngle(spill.true_position, spill.true_tangent, shift_ntbm);
+	// Create output tree
+	BOOST_LOG_TRIVIAL(debug) << *shift_ntbm;
+	ntbms.at(ishift) = shift_ntbm;
+	if ( settings.rntuple )
+	  ntbm_ntuples.at(ishift)->Fill(*shift_ntbm);
+	else
+	  ntbm_trees.at(ishift)->Fill();
+	ntbm_skims.at(ishift).Fill(*shift_ntbm, nspill);
+	// the inner lists are kept for the next batch
+	shift_ntbm->Clear("R");
+      }
+      if ( nspill++ == 0 ) {
+	MarkFirstSpill();
+#ifdef NTBM_COUNT_ALLOCATIONS
+	number_of_allocations_after_first_spill = GetNumberOfAllocations();
+#endif
+      }
+    }
+    batch_size = 0;
+  };
+
+  read_ahead.Start(first_entry, last_entry);
+
+  while ( B2Reader *reader = read_ahead.Next() ) {
+
+    BatchSpill &spill = batch.at(batch_size++);
+    NTBMSummary *my_ntbm = spill.ntbms.front().get();
+    spill.entry = reader->GetEntryNumber();
+
+    my_ntbm->SetEntryInDailyFile(reader->GetEntryNumber());
+
+    auto &input_spill_summary = reader->GetSpillSummary();
+    int timestamp = input_spill_summary.GetBeamSummary().GetTimestamp();
+    BOOST_LOG_TRIVIAL(debug) << "entry : " << reader->GetEntryNumber();
+    BOOST_LOG_TRIVIAL(debug) << "timestamp : " << timestamp;
+
+    TransferBeamInfo(input_spill_summary, my_ntbm);
+    TransferMCInfo(input_spill_summary, my_ntbm);
+
+    // Collect all NINJA hits
+    auto it_hit = input_spill_summary.BeginHit();
+    HitList ninja_hits;
+    while ( const auto *ninja_hit = it_hit.Next() ) {
+      if ( ninja_hit->GetDetectorId() == B2Detector::kNinja ) {
+	if ( IsNinjaTrackerDeadChannel(ninja_hit->GetView(),
+				       ninja_hit->GetSingleReadout(), ninja_hit->GetPlane(),
+				       ninja_hit->GetSlot().GetValue(ninja_hit->GetSingleReadout())) )
+	  continue;
+
+	if ( ninja_hit->GetView() == B2View::kTopView &&
+	     ninja_hit->GetPlane() == 0 &&
+	     ninja_hit->GetSlot().GetValue(ninja_hit->GetSingleReadout()) == 25 &&
+	     ninja_hit->GetHighGainPeu(ninja_hit->GetSingleReadout()) < 3.5 )
+	  continue; // noisy channel
+	// if ( ninja_hit->GetHighGainPeu(ninja_hit->GetSingleReadout()) < 3.5 )
+	if ( ninja_hit->GetHighGainPeu(ninja_hit->GetSingleReadout()) < 2.5 )
+	  continue;
+
+	ninja_hits.push_back(ninja_hit);
+      }
+    }
+
+    // Create X/Y NINJA clusters
+    if ( ninja_hits.size() > 0 ) {
+      CreateNinjaCluster(ninja_hits, my_ntbm);
+      // Position reconstruction w/o angle info (with the other spills of the batch)
+      position_batch.AddSpill(my_ntbm, spill.entry);
+    }
+
+    // Collect all BM 3d tracks
+    int number_of_tracks = 0;
+
+    auto it_recon_vertex = input_spill_summary.BeginReconVertex();
+    while ( auto *vertex = it_recon_vertex.Next() ) {
+      auto it_outgoing_track = vertex->BeginTrack();
+      while ( auto *track = it_outgoing_track.Next() ) {
+	if ( track->GetTrackType() == B2TrackType::kPrimaryTrack ) {
+	  // not start from the other WAGASCI modules
+	  if ( track->GetPrimaryTrackType() == B2PrimaryTrackType::kBabyMind3DTrack ) {
+	    number_of_tracks++;
+	  // start from the other modules and have hits in Baby MIND
+	  } else if ( track->GetPrimaryTrackType() == B2PrimaryTrackType::kMatchingTrack && 
+		      track->HasDetector(B2Detector::kBabyMind) ) {
+	    if ( track->HasDetector(B2Detector::kProtonModule) ||
+		 track->HasDetector(B2Detector::kWagasciUpstream) ||
+		 track->HasDetector(B2Detector::kWagasciDownstream) ) {
+	      number_of_tracks++;
+	    }
+	  }
+	}
+      } // track
+    } // vertex
+    spill.number_of_tracks = number_of_tracks;
+
+    // the tracks are appended by TransferBabyMindTrackInfo
+    my_ntbm->SetNumberOfTracks(0);
+
+    // Fit BabyMIND tracks to be extrapolated to the NINJA position
+    if ( number_of_tracks > 0 ) {
+      TransferBabyMindTrackInfo(input_spill_summary, my_ntbm, datatype);
+    }
+
+    // The B2 spill is not kept in the batch, the true muon is taken now
+    spill.has_true_muon = number_of_tracks > 0 &&
+      datatype == B2DataType::kMonteCarlo &&
+      my_ntbm->GetNumberOfNinjaClusters() > 0 &&
+      FindTrueNinjaMuon(input_spill_summary, spill.true_position, spill.true_tangent);
+
+    // all the scratch data of the spill are released at once
+    SpillArena::GetThreadArena().Reset();
+
+    // the first spill is processed alone not to delay the start up marker
+    if ( batch_size == batch.size() || nspill == 0 )
+      match_batch();
+  }
+  match_batch();
+
+#ifdef NTBM_COUNT_ALLOCATIONS
+  // the read-ahead thread (B2 decoding) is not counted
+  if ( nspill > 1 ) {
+    const double allocations_per_spill
+      = (double)( GetNumberOfAllocations() - number_of_allocations_after_first_spill ) / ( nspill - 1 );
+    BOOST_LOG_TRIVIAL(info) << "Heap allocations of the matching thread : "
+			    << allocations_per_spill << " per spill after the first spill";
+  }
+#endif
+  BOOST_LOG_TRIVIAL(info) << "Spill arena : " << SpillArena::GetThreadArena().GetPeakBytes() << " bytes at most per spill in "
+			  << SpillArena::GetThreadArena().GetNumberOfBlocks() << " blocks";
+  BOOST_LOG_TRIVIAL(info) << "NTBMSummary pool : " << ntbm_pool.GetNumberOfCreated() << " created, "
+			  << ntbm_pool.GetNumberOfReused() << " reused";
+
+  ntbm_file->cd();
+  for ( auto ntbm_tree : ntbm_trees )
+    ntbm_tree->Write();
+  for ( auto &ntbm_ntuple : ntbm_ntuples )
+    ntbm_ntuple->Close();
+  for ( const auto &ntbm_skim : ntbm_skims )
+    ntbm_skim.Write();
+  // Shard information used by ShardMerger to find gaps or overlaps
+  TParameter<Long64_t>("first_entry", first_entry).Write();
+  TParameter<Long64_t>("last_entry", last_entry).Write();
+  TParameter<Long64_t>("number_of_entries", number_of_entries).Write();
+  TParameter<int>("number_of_z_shifts", number_of_z_shifts).Write();
+  for ( int ishift = 0; ishift < number_of_z_shifts; ishift++ )
+    TParameter<double>(Form("z_shift_%d", ishift), z_shifts.at(ishift)).Write();
+  // Spills with bar average positions as they exceeded the reconstruction budget
+  TParameter<Long64_t>("number_of_fallback_spills", position_batch.GetNumberOfFallbackSpills()).Write();
+  ntbm_file->Close();
+
+  if ( alignment_cache ) {
+    alignment_cache->close();
+    if ( alignment_cache->fail() )
+      throw std::runtime_error("Cannot write alignment cache : " + alignment_cache_path);
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "Spills over the position reconstruction budget : "
+			  << position_batch.GetNumberOfFallbackSpills() << " ("
+			  << position_batch.GetNumberOfFallbackClusters()
+			  << " cluster reconstructions with bar average position)";
+
+  BOOST_LOG_TRIVIAL(info) << "Spills with matched 2d clusters : " << ntbm_skims.front().GetEntries().size()
+			  << " / " << nspill;
+
+  BOOST_LOG_TRIVIAL(info) << "Read-ahead (" << settings.read_ahead_depth << " spills) : "
+			  << read_ahead.GetStatistics();
+
+}
+
+/**
+ * Long-lived worker mode : match the files in the queue with the same initialized state
+ * @param queue job queue, one job is "<input B2 file path> <output NTBM file path> [<alignment cache path>]"
+ * @param settings settings shared by all the files
+ * @return true if all jobs succeeded
+ */
+bool RunWorker(WorkerQueue &queue, const TrackMatchSettings &settings) {
+
+  NinjaPositionBatch position_batch;
+  std::vector<std::string> arguments;
+
+  while ( queue.Next(arguments) ) {
+    BOOST_LOG_TRIVIAL(info) << "-----Job " << queue.GetJobName() << "-----";
+    try {
+      if ( arguments.size() < 2 || arguments.size() > 3 )
+	throw std::invalid_argument("Job should be <input> <output> [<alignment cache>]");
+      MatchFile(arguments.at(0), arguments.at(1), arguments.size() > 2 ? arguments.at(2) : "",
+		settings, position_batch);
+      queue.Finish(true);
+    } catch (const std::exception &error) {
+      // any error of one job must not stop the worker
+      BOOST_LOG_TRIVIAL(error) << "Job " << queue.GetJobName() << " failed : " << error.what();
+      queue.Finish(false);
+    }
+    position_batch.Clear();
+    position_batch.ClearBudgets();
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "Worker jobs : " << queue.GetNumberOfSucceeded() << " succeeded, "
+			  << queue.GetNumberOfFailed() << " failed";
+  return queue.GetNumberOfFailed() == 0;
+}
+
+// main
+
+int main(int argc, char *argv[]) {
+
+  gErrorIgnoreLevel = kError;
+
+  logging::core::get()->set_filter
+    (
+     logging::trivial::severity >= logging::trivial::info
+     //logging::trivial::severity >= logging::trivial::debug
+     //logging::trivial::severity >= logging::trivial::trace
+     );
+
+  BOOST_LOG_TRIVIAL(info) << "==========NINJA Track Matching Start==========";
+
+  po::options_description options("Options");
+  options.add_options()
+    ("input", po::value<std::string>(), "input B2 file path")
+    ("output", po::value<std::string>(), "output NTBM file path")
+    ("z-shift", po::value<std::string>()->required(),
+     "z shift from nominal [mm] : <z shift>, <z shift>,<z shift>,... or <start>:<stop>:<step> (stop included)")
+    ("datatype", po::value<int>()->required(), "MC(0)/data(1)")
+    ("first-entry", po::value<Long64_t>()->default_value(0),
+     "first entry of the input file to be processed")
+    ("last-entry", po::value<Long64_t>()->default_value(-1),
+     "last entry of the input file to be processed (-1 : until the end of the file)")
+    ("alignment-cache", po::value<std::string>(),
+     "output alignment cache file path used by AlignmentReMatch")
+    ("read-ahead", po::value<unsigned int>()->default_value(2),
+     "number of spills decoded ahead in a background thread (0 : read synchronously)")
+    ("tree-cache-factor", po::value<double>(),
+     "TTreeCache size of the input tree relative to the ROOT default (TTreeCache.Size)")
+    ("spill-work-budget", po::value<long>()->default_value(0),
+     "maximum position reconstruction work (line x plane x slot evaluations) in one spill"
+     " including all its z shifts, clusters of spills over the budget get the bar average position (0 : no limit)")
+    ("spill-time-budget", po::value<double>()->default_value(0.),
+     "maximum position reconstruction time of one spill including all its z shifts [ms]"
+     " (0 : no limit, not reproducible)")
+    ("batch-spills", po::value<unsigned int>()->default_value(16),
+     "number of spills matched and reconstructed together (1 : spill by spill)")
+    ("rntuple", po::bool_switch()->default_value(false),
+     "write the output in RNTuples instead of TTrees (needs a build with NINJA_RECON_WITH_RNTUPLE)")
+    ("manifest", po::value<std::string>(),
+     "worker mode : process the jobs \"<input> <output> [<alignment cache>]\" in the manifest file (- : stdin)")
+    ("spool", po::value<std::string>(),
+     "worker mode : process the *.job files in the spool directory")
+    ("spool-idle-timeout", po::value<double>()->default_value(60.),
+     "worker mode : time to wait for new jobs in the spool directory before stopping [s]");
+  po::positional_options_description positional;
+  positional.add("input", 1).add("output", 1).add("z-shift", 1).add("datatype", 1);
+
+  po::variables_map vm;
+  try {
+    // short options are not allowed so that negative z shifts are parsed as positional arguments
+    po::store(po::command_line_parser(argc, argv).options(options).positional(positional)
+	      .style(po::command_line_style::unix_style ^ po::command_line_style::allow_short).run(), vm);
+    po::notify(vm);
+    if ( vm.count("manifest") && vm.count("spool") )
+      throw po::error("--manifest and --spool cannot be used together");
+    if ( ( vm.count("manifest") || vm.count("spool") ) && vm.count("alignment-cache") )
+      throw po::error("--alignment-cache cannot be used in the worker mode (give it in each job line)");
+    if ( vm.count("spool-idle-timeout") && !vm["spool-idle-timeout"].defaulted() && !vm.count("spool") )
+      throw po::error("--spool-idle-timeout needs --spool");
+    if ( !vm.count("manifest") && !vm.count("spool") &&
+	 ( !vm.count("input") || !vm.count("output") ) )
+      throw po::error("input and output file paths are required");
+  } catch (const po::error &error) {
+    BOOST_LOG_TRIVIAL(error) << error.what();
+    BOOST_LOG_TRIVIAL(error) << "Usage : " << argv[0]
+			     << " <input B2 file path> <output NTBM file path> <z shift> <MC(0)/data(1)>"
+			     << " [--first-entry <entry>] [--last-entry <entry>]"
+			     << " [--alignment-cache <output alignment cache file path>]"
+			     << " [--read-ahead <number of spills>] [--tree-cache-factor <factor>]"
+			     << " [--spill-work-budget <work>] [--spill-time-budget <ms>]"
+			     << " [--batch-spills <number of spills>] [--rntuple]";
+    BOOST_LOG_TRIVIAL(error) << "Worker mode : " << argv[0]
+			     << " --manifest <manifest file path (- : stdin)> | --spool <spool directory>"
+			     << " --z-shift=<z shift> --datatype=<MC(0)/data(1)> [options]";
+    std::exit(1);
+  }
+
+  try {
+    // B2Reader does not expose its tree, so the cache size is set through the ROOT environment
+    if ( vm.count("tree-cache-factor") )
+      gEnv->SetValue("TTreeCache.Size", vm["tree-cache-factor"].as<double>());
+
+    TrackMatchSettings settings;
+    settings.z_shifts = ParseZShifts(vm["z-shift"].as<std::string>());
+    settings.datatype = vm["datatype"].as<int>();
+    settings.first_entry = vm["first-entry"].as<Long64_t>();
+    settings.last_entry = vm["last-entry"].as<Long64_t>();
+    settings.read_ahead_depth = vm["read-ahead"].as<unsigned int>();
+    settings.spill_work_budget = vm["spill-work-budget"].as<long>();
+    settings.spill_time_budget = vm["spill-time-budget"].as<double>() * 1e-3;
+    settings.batch_spills = vm["batch-spills"].as<unsigned int>();
+    if ( settings.batch_spills == 0 )
+      throw std::invalid_argument("--batch-spills should be positive");
+    settings.rntuple = vm["rntuple"].as<bool>();
+    if ( settings.rntuple && !NTBMNTupleWriter::IsAvailable() )
+      throw std::invalid_argument("--rntuple needs a build with NINJA_RECON_WITH_RNTUPLE=ON");
+    if ( settings.read_ahead_depth > 0 )
+      ROOT::EnableThreadSafety();
+
+    if ( vm.count("manifest") || vm.count("spool") ) {
+      // ROOT, dictionaries, geometry and buffers are initialized once for all the jobs
+      std::unique_ptr<WorkerQueue> queue;
+      if ( vm.count("manifest") )
+	queue.reset(new WorkerQueue(vm["manifest"].as<std::string>()));
+      else
+	queue.reset(new WorkerQueue(vm["spool"].as<std::string>(), vm["spool-idle-timeout"].as<double>()));
+      if ( !RunWorker(*queue, settings) )
+	std::exit(1);
+    } else {
+      NinjaPositionBatch position_batch;
+      MatchFile(vm["input"].as<std::string>(), vm["output"].as<std::string>(),
+		vm.count("alignment-cache") ? vm["alignment-cache"].as<std::string>() : "",
+		settings, position_batch);
+    }
+    
+  } catch (const std::runtime_error &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Runtime error : " << error.what();
+    std::exit(1);
+  } catch (const std::invalid_argument &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Invalid argument error : " << error.what();
+    std::exit(1);
+  } catch (const std::out_of_range &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Out of range error : " << error.what();
+    std::exit(1);
+  }
+  
+  BOOST_LOG_TRIVIAL(info) << "==========NINJA Track Matching Finish==========";
+  std::exit(0);
+
+}
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+
+# Start up benchmark : time to first spill of the reconstruction executables.
+# Each command is started several times and the time from the process start
+# to the "First spill processed" log line is measured. It includes the dynamic
+# loading and the static initialization, so the full (Geant4) build and the
+# lightweight build (-DNINJA_RECON_WITH_GEANT4=OFF) can be compared. The number
+# of Geant4 libraries loaded at the first spill is also reported, since the
+# B2MC library may still load Geant4 in the lightweight build.
+#
+# Usage :
+#   python3 benchmark_startup.py -n 10 \
+#     -c "./TrackMatch input.root output.root 0 1" \
+#     -c "./HitConverter wagasci.root ninja.root output.root 1"
+
+import argparse
+import os
+import shlex
+import statistics
+import subprocess
+import time
+
+marker = 'First spill processed'
+
+def loaded_geant4_libraries(pid) :
+    # Geant4 libraries mapped by the process (Linux only)
+    libraries = set()
+    try :
+        with open('/proc/%d/maps' % pid) as maps :
+            for line in maps :
+                path = line.split()[-1]
+                if os.path.basename(path).startswith('libG4') :
+                    libraries.add(os.path.basename(path))
+    except (IOError, OSError) :
+        return None
+    return libraries
+
+def measure(command, keep_running) :
+    start = time.perf_counter()
+    process = subprocess.Popen(shlex.split(command), stdout=subprocess.PIPE,
+                               stderr=subprocess.STDOUT, universal_newlines=True)
+    first_spill = None
+    geant4_libraries = None
+    # the output is read until the end, so that the executable is not blocked
+    # (or killed by SIGPIPE) when it writes after the marker
+    for line in process.stdout :
+        if first_spill is None and marker in line :
+            first_spill = time.perf_counter() - start
+            geant4_libraries = loaded_geant4_libraries(process.pid)
+            if not keep_running :
+                process.kill()
+    process.wait()
+    total = time.perf_counter() - start
+    return first_spill, total, geant4_libraries
+
+def main() :
+    parser = argparse.ArgumentParser(description='Time to first spill of the executables')
+    parser.add_argument('-c', '--command', action='append', required=True,
+                        help='command line of one executable (can be repeated)')
+    parser.add_argument('-n', '--repeat', type=int, default=5,
+                        help='number of runs of each command')
+    parser.add_argument('--full', action='store_true',
+                        help='let the executables finish and also report the total time')
+    args = parser.parse_args()
+
+    for command in args.command :
+        first_spills = []
+        totals = []
+        geant4_libraries = None
+        for i in range (0, args.repeat) :
+            first_spill, total, libraries = measure(command, args.full)
+            if first_spill is not None :
+                first_spills.append(first_spill)
+            if libraries is not None :
+                geant4_libraries = libraries
+            totals.append(total)
+        print(command)
+        if first_spills :
+            print('  time to first spill : median %.3f s, min %.3f s, max %.3f s (%d/%d runs)'
+                  % (statistics.median(first_spills), min(first_spills), max(first_spills),
+                     len(first_spills), args.repeat))
+        else :
+            print('  no "%s" line found' % marker)
+        if geant4_libraries is not None :
+            print('  Geant4 libraries loaded at the first spill : %d' % len(geant4_libraries))
+        if args.full or not first_spills :
+            print('  total time : median %.3f s' % statistics.median(totals))
+
+if __name__ == "__main__" :
+    main()
@@ -8,4 +8,5 @@ b2datafile=${b2datadir}/neutrino_b2physics_fullsetup_fullstat_timedifcut0_loose_
 matchdir=${HOME}/data/trackmatch
 matchfile=${matchdir}/neutrino_b2physics_fullsetup_fullstat_timedifcut0_loose_ninjamatch_$1_$2_$3.root
 
-./TrackMatch ${b2datafile} ${matchfile}
+./TrackMatch ${b2datafile} ${matchfile} && \
+    ../SpillIndex/SpillIndex ${matchdir}/spill_index.ntbmidx --add ${matchfile}
@@ -0,0 +1,684 @@
+#include "NTBMAnalysis.hpp"
+
+// system includes
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+// boost includes
+#include <boost/log/trivial.hpp>
+
+// B2 includes
+#include <B2Enum.hh>
+#include <B2Const.hh>
+
+// root includes
+#include <TROOT.h>
+#include <TFile.h>
+#include <TH1D.h>
+#include <TH2D.h>
+#include <TString.h>
+
+#include "NTBMReader.hh"
+#include "NTBMConst.hh"
+#include "NTBMStartupMarker.hh"
+
+double weightcalculator(int detector, int material, double norm, double xsec) {
+  static const double avogadro_constant = 6.0 * std::pow(10, 23);
+  static const double xsec_factor = std::pow(10, -38);
+  double thick;
+  switch (detector) {
+  case B2Detector::kProtonModule :
+    thick = PM_SCIBAR_REGION_THICKNESS + PM_VETO_REGION_THICKNESS;
+    break;
+  case B2Detector::kWagasciUpstream :
+  case B2Detector::kWagasciDownstream :
+    thick = WGS_WATER_BOX_DEPTH;
+    break;
+  case B2Detector::kWallMrdSouth :
+  case B2Detector::kWallMrdNorth :
+    thick = WM_INNER_IRON_PLATE_LARGE;
+    break;
+  case B2Detector::kBabyMind :
+    thick = BM_IRON_PLATE_DEPTH * BM_NUM_IRON_PLANES;
+    break;
+  case B2Detector::kYasuTracker :
+    thick = YASU_NUM_PLANES * WM_SCINTI_THICK;
+    break;
+  case B2Detector::kWall :
+    thick = HALL_RADIUS_THICK;
+    break;
+  case B2Detector::kNinja :
+    switch (material) {
+    case B2Material::kWater :
+      thick = NINJA_WATER_LAYER_THICK * NINJA_ECC_WATER_LAYERS;
+      break;
+    case B2Material::kIron :
+      thick = NINJA_IRON_LAYER_THICK * NINJA_ECC_IRON_LAYERS;
+      break;
+    default :
+      throw std::invalid_argument("NINJA material not recognized");
+    }
+    break;
+  default :
+    throw std::invalid_argument("Detector not recognized");
+  }
+
+  thick *= .1; // convert from mm to cm
+  return avogadro_constant * thick * norm * xsec * xsec_factor;
+
+}
+
+/**
+ * @param tangent tangent
+ * @return tangent slice id (0.1 step of |tangent|)
+ */
+int GetBinId(double tangent) {
+  return std::floor(std::fabs(tangent) * 10);
+}
+
+/**
+ * Check the data type argument
+ * @param datatype 0 (MC) or 1 (Physics data)
+ */
+void CheckDataType(int datatype) {
+  if ( datatype != B2DataType::kMonteCarlo && datatype != B2DataType::kRealData )
+    throw std::invalid_argument("Datatype should be 0 (MC) or 1 (Physics data)!!");
+}
+
+bool Is2dCluster(const NTBMSummary &ntbm, int icluster) {
+  // same selection as the skim
+  return NTBMSkim::Is2dCluster(ntbm, icluster);
+}
+
+// Analysis modules
+// The Position, Tangent and BabyMindTangent studies have always filled with weight 1
+// also for MC (the weight was computed into a shadowing local variable). This is kept
+// so that the histograms do not change : these modules do not use the data type.
+
+/**
+ * NINJA tracker reconstructed position of 2d clusters (TestPosition)
+ */
+class PositionModule : public NTBMAnalysisModule {
+
+public :
+
+  std::unique_ptr<NTBMAnalysisModule> Clone() const override {
+    return std::unique_ptr<NTBMAnalysisModule>(new PositionModule());
+  }
+
+  std::vector<std::string> GetMembers() const override {
+    return {"number_of_ninja_clusters_", "number_of_hits_", "ninja_position_",
+	    "normalization_", "total_cross_section_"};
+  }
+
+  int GetSkim() const override {
+    return NTBMSkim::ANY_TRACK_TYPE;
+  }
+
+  void Book() override {
+    hist_pos_y_ = Register(new TH1D("hist_pos_y", "NINJA Tracker reconstructed Y;Y [mm];Entries", 100, -650, 650));
+    hist_pos_x_ = Register(new TH1D("hist_pos_x", "NINJA Tracker reconstructed X;X [mm];Entries", 100, -650, 650));
+    hist_pos_xy_ = Register(new TH2D("hist_pos_xy", ";x [mm];y [mm]",
+				     25, -630, 470, 25, -470, 630));
+    hist_pos_xy_->GetXaxis()->CenterTitle();
+    hist_pos_xy_->GetYaxis()->CenterTitle();
+  }
+
+  void Fill(const NTBMSummary &ntbm) override {
+    for ( int icluster = 0; icluster < ntbm.GetNumberOfNinjaClusters(); icluster++ ) {
+      // Only 2d matched cluster
+      if ( !Is2dCluster(ntbm, icluster) ) continue;
+      const std::vector<double> &position = ntbm.GetNinjaPosition(icluster);
+      hist_pos_y_->Fill(position.at(B2View::kSideView));
+      hist_pos_x_->Fill(position.at(B2View::kTopView));
+      hist_pos_xy_->Fill(position.at(B2View::kTopView), position.at(B2View::kSideView));
+    }
+  }
+
+private :
+
+  TH1D *hist_pos_y_;
+  TH1D *hist_pos_x_;
+  TH2D *hist_pos_xy_;
+
+};
+
+/**
+ * NINJA tracker reconstructed tangent of 2d clusters (TestTangent)
+ */
+class TangentModule : public NTBMAnalysisModule {
+
+public :
+
+  std::unique_ptr<NTBMAnalysisModule> Clone() const override {
+    return std::unique_ptr<NTBMAnalysisModule>(new TangentModule());
+  }
+
+  std::vector<std::string> GetMembers() const override {
+    return {"number_of_ninja_clusters_", "number_of_hits_", "ninja_tangent_",
+	    "normalization_", "total_cross_section_"};
+  }
+
+  int GetSkim() const override {
+    return NTBMSkim::ANY_TRACK_TYPE;
+  }
+
+  void Book() override {
+    hist_ang_y_ = Register(new TH1D("hist_ang_y", "NINJA Tracker reconstructed Y angle;tan#theta_{Y};Entries",
+				    100, -2, 2));
+    hist_ang_x_ = Register(new TH1D("hist_ang_x", "NINJA Tracker reconstructed X angle;tan#theta_{X};Entries",
+				    100, -2, 2));
+    hist_ang_xy_ = Register(new TH2D("hist_ang_xy", ";tan#theta_{x};tan#theta_{y}",
+				     100, -2, 2, 100, -1.5, 1.5));
+    hist_ang_xy_->GetXaxis()->CenterTitle();
+    hist_ang_xy_->GetYaxis()->CenterTitle();
+    hist_ang_xy_->GetXaxis()->SetTitleOffset(0.95);
+    hist_ang_xy_->GetYaxis()->SetTitleOffset(0.9);
+    hist_ang_xy_->SetTitleSize(0.05, "XY");
+  }
+
+  void Fill(const NTBMSummary &ntbm) override {
+    for ( int icluster = 0; icluster < ntbm.GetNumberOfNinjaClusters(); icluster++ ) {
+      // Only 2d matched cluster
+      if ( !Is2dCluster(ntbm, icluster) ) continue;
+      const std::vector<double> &tangent = ntbm.GetNinjaTangent(icluster);
+      hist_ang_y_->Fill(tangent.at(B2View::kSideView));
+      hist_ang_x_->Fill(tangent.at(B2View::kTopView));
+      hist_ang_xy_->Fill(tangent.at(B2View::kTopView), tangent.at(B2View::kSideView));
+    }
+  }
+
+private :
+
+  TH1D *hist_ang_y_;
+  TH1D *hist_ang_x_;
+  TH2D *hist_ang_xy_;
+
+};
+
+/**
+ * Baby MIND reconstructed tangent of all the tracks (TestBabyMindTangent)
+ */
+class BabyMindTangentModule : public NTBMAnalysisModule {
+
+public :
+
+  std::unique_ptr<NTBMAnalysisModule> Clone() const override {
+    return std::unique_ptr<NTBMAnalysisModule>(new BabyMindTangentModule());
+  }
+
+  std::vector<std::string> GetMembers() const override {
+    return {"number_of_tracks_", "baby_mind_tangent_", "normalization_",
+	    "total_cross_section_"};
+  }
+
+  void Book() override {
+    hist_ang_y_ = Register(new TH1D("hist_ang_y", "NINJA BM reconstructed Y angle;tan#theta_{Y};Entries", 100, -2, 2));
+    hist_ang_x_ = Register(new TH1D("hist_ang_x", "NINJA BM reconstructed X angle;tan#theta_{X};Entries", 100, -2, 2));
+    hist_ang_xy_ = Register(new TH2D("hist_ang_xy", "NINJA BM reconstructed tangent;tan#theta_{X};tan#theta_{Y}",
+				     100, -2, 2, 100, -2, 2));
+  }
+
+  void Fill(const NTBMSummary &ntbm) override {
+    for ( int itrack = 0; itrack < ntbm.GetNumberOfTracks(); itrack++ ) {
+      const std::vector<double> &tangent = ntbm.GetBabyMindTangent(itrack);
+      hist_ang_y_->Fill(tangent.at(B2View::kSideView));
+      hist_ang_x_->Fill(tangent.at(B2View::kTopView));
+      hist_ang_xy_->Fill(tangent.at(B2View::kTopView), tangent.at(B2View::kSideView));
+    }
+  }
+
+private :
+
+  TH1D *hist_ang_y_;
+  TH1D *hist_ang_x_;
+  TH2D *hist_ang_xy_;
+
+};
+
+/**
+ * Difference between the Baby MIND extrapolation and the matched 2d cluster
+ * (TestPositionDifference)
+ */
+class PositionDifferenceModule : public NTBMAnalysisModule {
+
+public :
+
+  explicit PositionDifferenceModule(int datatype) : datatype_(datatype) { CheckDataType(datatype); }
+
+  std::unique_ptr<NTBMAnalysisModule> Clone() const override {
+    return std::unique_ptr<NTBMAnalysisModule>(new PositionDifferenceModule(datatype_));
+  }
+
+  std::vector<std::string> GetMembers() const override {
+    return {"number_of_tracks_", "baby_mind_position_", "baby_mind_tangent_",
+	    "number_of_ninja_clusters_", "baby_mind_track_id_",
+	    "number_of_hits_", "ninja_position_", "ninja_tangent_",
+	    "normalization_", "total_cross_section_"};
+  }
+
+  int GetSkim() const override {
+    return NTBMSkim::ANY_TRACK_TYPE;
+  }
+
+  void Book() override {
+    hist_pos_y_ = Register(new TH1D("hist_pos_y", ";y_{extrapolate} - y_{ST, one} [mm];Entries/4 mm", 250, -500, 500));
+    hist_pos_x_ = Register(new TH1D("hist_pos_x", ";x_{extrapolate} - x_{ST, one} [mm];Entries/4 mm", 250, -500, 500));
+    hist_ang_y_ = Register(new TH1D("hist_ang_y", "tan Y difference;#Deltatan_Y;Entries", 100, -0.25, 0.25));
+    hist_ang_x_ = Register(new TH1D("hist_ang_x", "tan X difference;#Deltatan_X;Entries", 100, -0.25, 0.25));
+    hist_pos_y_->GetXaxis()->CenterTitle();
+    hist_pos_y_->GetYaxis()->CenterTitle();
+    hist_pos_x_->GetXaxis()->CenterTitle();
+    hist_pos_x_->GetYaxis()->CenterTitle();
+    hist_pos_y_->SetTitleSize(0.04,"XY");
+    hist_pos_x_->SetTitleSize(0.04,"XY");
+    for ( int islice = 0; islice < 10; islice++ ) {
+      hist_pos_y_slice_[islice] = Register(new TH1D(Form("hist_pos_y_slice%d", islice),
+						    Form("Y difference ( %.1f < tan#theta_{Y} < %.1f);#DeltaY [mm];Entries",
+							 islice * 0.1, (islice+1) * 0.1),
+						    250, -500, 500));
+      hist_pos_x_slice_[islice] = Register(new TH1D(Form("hist_pos_x_slice%d", islice),
+						    Form("X difference ( %.1f < tan#theta_{X} < %.1f);#DeltaX [mm];Entries",
+							 islice * 0.1, (islice+1) * 0.1),
+						    250, -500, 500));
+    }
+  }
+
+  void Fill(const NTBMSummary &ntbm) override {
+    double weight = 1.;
+    if ( datatype_ == B2DataType::kMonteCarlo )
+      weight = weightcalculator(B2Detector::kWall, B2Material::kWater,
+				ntbm.GetNormalization(), ntbm.GetTotalCrossSection());
+
+    for ( int icluster = 0; icluster < ntbm.GetNumberOfNinjaClusters(); icluster++ ) {
+      // Only 2d matched cluster
+      if ( !Is2dCluster(ntbm, icluster) ) continue;
+      int baby_mind_track_id = ntbm.GetBabyMindTrackId(icluster);
+      const std::vector<double> &baby_mind_position = ntbm.GetBabyMindPosition(baby_mind_track_id);
+      const std::vector<double> &baby_mind_tangent = ntbm.GetBabyMindTangent(baby_mind_track_id);
+      double hit_expected_position[2];
+      for ( int view = 0; view < 2; view++ ) {
+	switch (view) {
+	case B2View::kTopView :
+	  hit_expected_position[view] = baby_mind_position.at(view)
+	    - baby_mind_tangent.at(view) * (BABYMIND_POS_Z + BM_SECOND_LAYER_POS
+					    - NINJA_POS_Z - NINJA_TRACKER_POS_Z - 10.);
+	  hit_expected_position[view] = hit_expected_position[view]
+	    + BABYMIND_POS_X // global coordinate
+	    - NINJA_POS_X // NINJA overall
+	    - NINJA_TRACKER_POS_X; // NINJA tracker
+	  break;
+	case B2View::kSideView :
+	  hit_expected_position[view] = baby_mind_position.at(view)
+	    - baby_mind_tangent.at(view) * (BABYMIND_POS_Z + BM_SECOND_LAYER_POS
+					    - NINJA_POS_Z - NINJA_TRACKER_POS_Z + 10.);
+	  hit_expected_position[view] = hit_expected_position[view]
+	    + BABYMIND_POS_Y // global coordinate
+	    - NINJA_POS_Y // NINJA overall
+	    - NINJA_TRACKER_POS_Y; // NINJA tracker
+	  break;
+	}
+      }
+
+      const std::vector<double> &ninja_position = ntbm.GetNinjaPosition(icluster);
+      const std::vector<double> &ninja_tangent = ntbm.GetNinjaTangent(icluster);
+      const double position_difference[2]
+	= {hit_expected_position[B2View::kSideView] - ninja_position.at(B2View::kSideView),
+	   hit_expected_position[B2View::kTopView] - ninja_position.at(B2View::kTopView)};
+      hist_pos_y_->Fill(position_difference[B2View::kSideView], weight);
+      hist_pos_x_->Fill(position_difference[B2View::kTopView], weight);
+      hist_ang_y_->Fill(baby_mind_tangent.at(B2View::kSideView) - ninja_tangent.at(B2View::kSideView), weight);
+      hist_ang_x_->Fill(baby_mind_tangent.at(B2View::kTopView) - ninja_tangent.at(B2View::kTopView), weight);
+      int side_bin_id = GetBinId(baby_mind_tangent.at(B2View::kSideView));
+      int top_bin_id = GetBinId(baby_mind_tangent.at(B2View::kTopView));
+      if ( side_bin_id < 10 )
+	hist_pos_y_slice_[side_bin_id]->Fill(position_difference[B2View::kSideView], weight);
+      if ( top_bin_id < 10 )
+	hist_pos_x_slice_[top_bin_id]->Fill(position_difference[B2View::kTopView], weight);
+    } // icluster
+  }
+
+private :
+
+  int datatype_;
+  TH1D *hist_pos_y_;
+  TH1D *hist_pos_x_;
+  TH1D *hist_ang_y_;
+  TH1D *hist_ang_x_;
+  TH1D *hist_pos_y_slice_[10];
+  TH1D *hist_pos_x_slice_[10];
+
+};
+
+/**
+ * Difference between the reconstructed and true NINJA positions in MC (TestTruePosition)
+ */
+class TruePositionModule : public NTBMAnalysisModule {
+
+public :
+
+  std::unique_ptr<NTBMAnalysisModule> Clone() const override {
+    return std::unique_ptr<NTBMAnalysisModule>(new TruePositionModule());
+  }
+
+  std::vector<std::string> GetMembers() const override {
+    return {"number_of_tracks_", "number_of_ninja_clusters_",
+	    "number_of_hits_", "ninja_position_", "ninja_tangent_",
+	    "normalization_", "total_cross_section_",
+	    "number_of_true_particles_", "true_particle_offset_",
+	    "true_particle_position_"};
+  }
+
+  int GetSkim() const override {
+    return NTBMSkim::ANY_TRACK_TYPE;
+  }
+
+  void Book() override {
+    hist_pos_y_ = Register(new TH1D("hist_pos_y", "NINJA position difference Y;#Delta Y [mm];Entries", 100,-25, 25));
+    hist_pos_x_ = Register(new TH1D("hist_pos_x", "NINJA position differnece X;#Delta X [mm];Entries", 100, -25 ,25));
+    for ( int islice = 0; islice < 10; islice++ ) {
+      hist_pos_y_slice_[islice] = Register(new TH1D(Form("hist_pos_y_slice%d", islice),
+						    Form("Y difference ( %.1f < tan#theta_{Y} < %.1f);#DeltaY [mm];Entries",
+							 islice * 0.1, (islice+1) * 0.1),
+						    100, -25, 25));
+      hist_pos_x_slice_[islice] = Register(new TH1D(Form("hist_pos_x_slice%d", islice),
+						    Form("X difference ( %.1f < tan#theta_{X} < %.1f);#DeltaX [mm];Entries",
+							 islice * 0.1, (islice+1) * 0.1),
+						    100, -25, 25));
+    }
+  }
+
+  void Fill(const NTBMSummary &ntbm) override {
+    if ( ntbm.GetNumberOfTracks() != 1 ) return;
+    double weight = weightcalculator(B2Detector::kNinja, B2Material::kWater,
+				     ntbm.GetNormalization(), ntbm.GetTotalCrossSection());
+
+    for ( int icluster = 0; icluster < ntbm.GetNumberOfNinjaClusters(); icluster++ ) {
+      // Only 2d matched cluster
+      if ( !Is2dCluster(ntbm, icluster) ) continue;
+      if ( ntbm.GetNumberOfTrueParticles(icluster) == 0 ) continue;
+      const std::vector<double> &ninja_recon_position = ntbm.GetNinjaPosition(icluster);
+      const std::vector<double> &ninja_recon_tangent = ntbm.GetNinjaTangent(icluster);
+      const double ninja_true_position[2] = { ntbm.GetTruePosition(icluster, 0, B2View::kSideView),
+					      ntbm.GetTruePosition(icluster, 0, B2View::kTopView) };
+
+      hist_pos_y_->Fill(ninja_recon_position.at(B2View::kSideView) - ninja_true_position[B2View::kSideView], weight);
+      hist_pos_x_->Fill(ninja_recon_position.at(B2View::kTopView) - ninja_true_position[B2View::kTopView], weight);
+      int side_bin_id = GetBinId(ninja_recon_tangent.at(B2View::kSideView));
+      int top_bin_id = GetBinId(ninja_recon_tangent.at(B2View::kTopView));
+      if ( side_bin_id < 10 )
+	hist_pos_y_slice_[side_bin_id]->Fill(ninja_recon_position.at(B2View::kSideView)
+					     - ninja_true_position[B2View::kSideView], weight);
+      if ( top_bin_id < 10 )
+	hist_pos_x_slice_[top_bin_id]->Fill(ninja_recon_position.at(B2View::kTopView)
+					    - ninja_true_position[B2View::kTopView], weight);
+    } // icluster
+  }
+
+private :
+
+  TH1D *hist_pos_y_;
+  TH1D *hist_pos_x_;
+  TH1D *hist_pos_y_slice_[10];
+  TH1D *hist_pos_x_slice_[10];
+
+};
+
+NTBMAnalysisModule::~NTBMAnalysisModule() {
+  for ( auto histogram : histograms_ )
+    delete histogram;
+}
+
+int NTBMAnalysisModule::GetSkim() const {
+  return NTBMSkim::NO_SKIM;
+}
+
+void NTBMAnalysisModule::Write() {
+  for ( auto histogram : histograms_ )
+    histogram->Write();
+}
+
+void NTBMAnalysisModule::Merge(const NTBMAnalysisModule &other) {
+  if ( other.histograms_.size() != histograms_.size() )
+    throw std::invalid_argument("Analysis modules to be merged have different histograms");
+  for ( std::size_t ihistogram = 0; ihistogram < histograms_.size(); ihistogram++ )
+    histograms_.at(ihistogram)->Add(other.histograms_.at(ihistogram));
+}
+
+std::vector<std::string> GetAnalysisModuleNames() {
+  return {"Position", "Tangent", "BabyMindTangent", "PositionDifference", "TruePosition"};
+}
+
+std::unique_ptr<NTBMAnalysisModule> CreateAnalysisModule(const std::string &name, int datatype) {
+  // these modules do not depend on the data type, it is still checked
+  if ( name == "Position" || name == "Tangent" || name == "BabyMindTangent" )
+    CheckDataType(datatype);
+  if ( name == "Position" )
+    return std::unique_ptr<NTBMAnalysisModule>(new PositionModule());
+  else if ( name == "Tangent" )
+    return std::unique_ptr<NTBMAnalysisModule>(new TangentModule());
+  else if ( name == "BabyMindTangent" )
+    return std::unique_ptr<NTBMAnalysisModule>(new BabyMindTangentModule());
+  else if ( name == "PositionDifference" )
+    return std::unique_ptr<NTBMAnalysisModule>(new PositionDifferenceModule(datatype));
+  else if ( name == "TruePosition" )
+    return std::unique_ptr<NTBMAnalysisModule>(new TruePositionModule());
+  throw std::invalid_argument("Analysis module not recognized : " + name);
+}
+
+/**
+ * Entries of one input file to be read
+ */
+struct NTBMAnalysisInput {
+  ///> all the entries are read (no skim)
+  bool all_entries;
+  ///> number of entries in the file
+  Long64_t number_of_entries;
+  ///> entries of the skim
+  std::vector<Long64_t> skim_entries;
+  ///> @return number of entries to be read
+  Long64_t GetNumberOfSelected() const {
+    return all_entries ? number_of_entries : skim_entries.size();
+  }
+  ///> @return entry of the i-th selected entry
+  Long64_t GetSelectedEntry(Long64_t i) const {
+    return all_entries ? i : skim_entries[i];
+  }
+};
+
+/**
+ * Selected entry range of one input file processed by a thread at a time
+ */
+struct NTBMAnalysisChunk {
+  std::size_t input;
+  Long64_t first_entry;
+  Long64_t last_entry; // not included
+};
+
+unsigned int ParseNumberOfThreads(const std::string &value) {
+  std::size_t size = 0;
+  long number_of_threads = 0;
+  try {
+    number_of_threads = std::stol(value, &size);
+  } catch (const std::logic_error &error) { // invalid_argument or out_of_range
+    size = 0;
+  }
+  if ( size == 0 || size != value.size() || number_of_threads <= 0 ||
+       number_of_threads > std::numeric_limits<int>::max() )
+    throw std::invalid_argument("Number of threads should be a positive integer : " + value);
+  return number_of_threads;
+}
+
+/**
+ * Set the TH1::AddDirectory status and restore the previous one when destroyed,
+ * also when an error is thrown
+ */
+class AddDirectoryGuard {
+public :
+  explicit AddDirectoryGuard(Bool_t status) : previous_status_(TH1::AddDirectoryStatus()) {
+    TH1::AddDirectory(status);
+  }
+  ~AddDirectoryGuard() {
+    TH1::AddDirectory(previous_status_);
+  }
+  AddDirectoryGuard(const AddDirectoryGuard&) = delete;
+  AddDirectoryGuard &operator=(const AddDirectoryGuard&) = delete;
+private :
+  const Bool_t previous_status_;
+};
+
+void RunAnalysis(const std::vector<std::string> &input_paths, std::vector<NTBMAnalysisTask> &tasks,
+		 unsigned int number_of_threads) {
+
+  // Union of the members used by the modules
+  std::vector<std::string> members;
+  bool all_members = false;
+  for ( const auto &task : tasks ) {
+    const std::vector<std::string> task_members = task.module->GetMembers();
+    if ( task_members.empty() ) all_members = true;
+    for ( const auto &member : task_members )
+      if ( std::find(members.begin(), members.end(), member) == members.end() )
+	members.push_back(member);
+  }
+  if ( all_members ) members.clear();
+
+  // Skim shared by the modules : all the spills if a module needs them,
+  // matched 2d clusters of any track type if the modules need different types
+  int skim = tasks.empty() ? NTBMSkim::NO_SKIM : tasks.front().module->GetSkim();
+  for ( const auto &task : tasks ) {
+    const int task_skim = task.module->GetSkim();
+    if ( task_skim == NTBMSkim::NO_SKIM )
+      skim = NTBMSkim::NO_SKIM;
+    else if ( task_skim != skim && skim != NTBMSkim::NO_SKIM )
+      skim = NTBMSkim::ANY_TRACK_TYPE;
+  }
+
+  std::vector<NTBMAnalysisInput> inputs(input_paths.size());
+  Long64_t total_number_of_entries = 0;
+  Long64_t total_number_of_selected = 0;
+  for ( std::size_t iinput = 0; iinput < input_paths.size(); iinput++ ) {
+    NTBMAnalysisInput &input = inputs.at(iinput);
+    {
+      NTBMReader reader(input_paths.at(iinput), members);
+      input.number_of_entries = reader.GetEntries();
+    }
+    input.all_entries = true;
+    if ( skim != NTBMSkim::NO_SKIM ) {
+      TFile file(input_paths.at(iinput).c_str(), "read");
+      NTBMSkim ntbm_skim;
+      if ( ntbm_skim.Read(file) ) {
+	input.skim_entries = ntbm_skim.GetEntries(skim);
+	input.all_entries = false;
+	if ( !input.skim_entries.empty() && input.skim_entries.back() >= input.number_of_entries )
+	  throw std::runtime_error("Skim entries out of the tree in " + input_paths.at(iinput));
+      } else {
+	BOOST_LOG_TRIVIAL(warning) << "No skim in " << input_paths.at(iinput) << ", all the entries are read";
+      }
+      file.Close();
+    }
+    total_number_of_entries += input.number_of_entries;
+    total_number_of_selected += input.GetNumberOfSelected();
+  }
+
+  // A few chunks per thread so that the threads finish at about the same time.
+  // With one thread, the chunks are processed in order.
+  number_of_threads = std::max(1u, number_of_threads);
+  const Long64_t chunk_size = std::max<Long64_t>(1, total_number_of_selected / ( 4 * number_of_threads ));
+  std::vector<NTBMAnalysisChunk> chunks;
+  for ( std::size_t iinput = 0; iinput < inputs.size(); iinput++ ) {
+    const Long64_t number_of_selected = inputs.at(iinput).GetNumberOfSelected();
+    for ( Long64_t first_entry = 0; first_entry < number_of_selected; first_entry += chunk_size )
+      chunks.push_back({iinput, first_entry, std::min(first_entry + chunk_size, number_of_selected)});
+  }
+  number_of_threads = std::max<unsigned int>(1, std::min<std::size_t>(number_of_threads, chunks.size()));
+
+  if ( number_of_threads > 1 )
+    ROOT::EnableThreadSafety();
+  const AddDirectoryGuard add_directory_guard(kFALSE);
+
+  // The output files are opened first not to lose the processing for a wrong path
+  std::vector<std::unique_ptr<TFile> > outputs;
+  for ( auto &task : tasks ) {
+    outputs.emplace_back(new TFile(task.output_path.c_str(), "recreate"));
+    if ( outputs.back()->IsZombie() )
+      throw std::runtime_error("Cannot open output file : " + task.output_path);
+  }
+
+  // The first thread fills the modules of the tasks, the others their clones
+  std::vector<std::vector<NTBMAnalysisModule*> > thread_modules(number_of_threads);
+  std::vector<std::unique_ptr<NTBMAnalysisModule> > clones;
+  for ( unsigned int ithread = 0; ithread < number_of_threads; ithread++ ) {
+    for ( auto &task : tasks ) {
+      if ( ithread == 0 ) {
+	thread_modules.at(ithread).push_back(task.module.get());
+      } else {
+	clones.push_back(task.module->Clone());
+	thread_modules.at(ithread).push_back(clones.back().get());
+      }
+      thread_modules.at(ithread).back()->Book();
+    }
+  }
+
+  std::atomic<std::size_t> next_chunk(0);
+  std::mutex error_mutex;
+  std::string error_message;
+  // marker of the start up benchmark (time to first spill)
+  auto process_chunks = [&](unsigned int ithread) {
+    std::unique_ptr<NTBMReader> reader;
+    std::size_t reader_input = input_paths.size();
+    std::size_t ichunk;
+    while ( (ichunk = next_chunk++) < chunks.size() ) {
+      const NTBMAnalysisChunk &chunk = chunks.at(ichunk);
+      try {
+	if ( chunk.input != reader_input ) {
+	  reader.reset();
+	  reader.reset(new NTBMReader(input_paths.at(chunk.input), members));
+	  reader_input = chunk.input;
+	}
+	const NTBMSummary *ntbm = reader->GetNTBMSummary();
+	const NTBMAnalysisInput &input = inputs.at(chunk.input);
+	for ( Long64_t ientry = chunk.first_entry; ientry < chunk.last_entry; ientry++ ) {
+	  reader->GetEntry(input.GetSelectedEntry(ientry));
+	  for ( auto module : thread_modules.at(ithread) )
+	    module->Fill(*ntbm);
+	  MarkFirstSpill();
+	}
+      } catch (const std::exception &error) {
+	std::lock_guard<std::mutex> lock(error_mutex);
+	error_message = error.what();
+	next_chunk = chunks.size();
+	return;
+      }
+    }
+  };
+
+  if ( number_of_threads == 1 ) {
+    process_chunks(0);
+  } else {
+    std::vector<std::thread> threads;
+    for ( unsigned int ithread = 0; ithread < number_of_threads; ithread++ )
+      threads.emplace_back(process_chunks, ithread);
+    for ( auto &thread : threads )
+      thread.join();
+  }
+  if ( !error_message.empty() )
+    throw std::runtime_error(error_message);
+
+  BOOST_LOG_TRIVIAL(info) << "Input : " << input_paths.size() << " files (" << total_number_of_selected
+			  << " of " << total_number_of_entries << " spills read once for " << tasks.size()
+			  << " modules, " << number_of_threads << " threads)";
+
+  for ( std::size_t itask = 0; itask < tasks.size(); itask++ ) {
+    for ( unsigned int ithread = 1; ithread < number_of_threads; ithread++ )
+      tasks.at(itask).module->Merge(*thread_modules.at(ithread).at(itask));
+    outputs.at(itask)->cd();
+    tasks.at(itask).module->Write();
+    outputs.at(itask)->Close();
+  }
+
+}
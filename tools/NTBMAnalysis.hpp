@@ -0,0 +1,157 @@
+#ifndef NINJARECON_NTBMANALYSIS_HPP
+#define NINJARECON_NTBMANALYSIS_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+
+#include <TH1.h>
+
+#include "NTBMSummary.hh"
+#include "NTBMSkim.hh"
+
+/*
+ * Analysis modules of the test tools. Each study books its histograms, fills them
+ * spill by spill and writes them. Any set of modules runs in one pass over NTBM
+ * files (RunAnalysis), so that the files are read and deserialized only once.
+ * The entries are shared by several threads, each filling its own copy of the
+ * modules. The copies are merged at the end. Modules of the matched 2d clusters
+ * read only the spills listed in the skim written by TrackMatch.
+ */
+
+/**
+ * Interface of the analysis modules
+ */
+class NTBMAnalysisModule {
+
+public :
+
+  NTBMAnalysisModule() = default;
+
+  NTBMAnalysisModule(const NTBMAnalysisModule&) = delete;
+  NTBMAnalysisModule &operator=(const NTBMAnalysisModule&) = delete;
+
+  /**
+   * The registered histograms are deleted
+   */
+  virtual ~NTBMAnalysisModule();
+
+  /**
+   * @return new module with the same settings (histograms not booked), filled by another thread
+   */
+  virtual std::unique_ptr<NTBMAnalysisModule> Clone() const = 0;
+
+  /**
+   * @return NTBMSummary members used by the module (empty : all the members)
+   */
+  virtual std::vector<std::string> GetMembers() const = 0;
+
+  /**
+   * Spills without matched 2d clusters are skipped when the module needs a skim
+   * @return Baby MIND track type of the matched 2d clusters filled by the module
+   * (NTBMSkim::ANY_TRACK_TYPE : any type, NTBMSkim::NO_SKIM : all the spills are needed)
+   */
+  virtual int GetSkim() const;
+
+  /**
+   * Book the histograms and register them (not attached to any directory)
+   */
+  virtual void Book() = 0;
+
+  /**
+   * Fill the histograms with one spill
+   * @param ntbm NTBMSummary object of the spill
+   */
+  virtual void Fill(const NTBMSummary &ntbm) = 0;
+
+  /**
+   * Write the histograms in the current ROOT directory (in the booking order)
+   */
+  virtual void Write();
+
+  /**
+   * Add the histograms of a clone filled by another thread
+   * @param other clone of this module
+   */
+  virtual void Merge(const NTBMAnalysisModule &other);
+
+protected :
+
+  /**
+   * Register a booked histogram, which is then owned by the module
+   * @param histogram booked histogram
+   * @return histogram
+   */
+  template < typename Histogram >
+  Histogram *Register(Histogram *histogram) {
+    histograms_.push_back(histogram);
+    return histogram;
+  }
+
+private :
+
+  std::vector<TH1*> histograms_;
+
+};
+
+/**
+ * Analysis module and its output file
+ */
+struct NTBMAnalysisTask {
+  std::unique_ptr<NTBMAnalysisModule> module;
+  std::string output_path;
+};
+
+/**
+ * Weight of an MC event
+ * @param detector detector id of the interaction
+ * @param material material of the interaction (used for NINJA)
+ * @param norm normalization
+ * @param xsec total cross section
+ * @return event weight
+ */
+double weightcalculator(int detector, int material, double norm, double xsec);
+
+/**
+ * Selection of the 2d matched clusters
+ * @param ntbm NTBMSummary object
+ * @param icluster cluster id
+ * @return true if the cluster has hits in both views
+ */
+bool Is2dCluster(const NTBMSummary &ntbm, int icluster);
+
+/**
+ * @return names of the available analysis modules
+ */
+std::vector<std::string> GetAnalysisModuleNames();
+
+/**
+ * Create an analysis module
+ * @param name module name (GetAnalysisModuleNames)
+ * @param datatype 0 (MC) or 1 (Physics data)
+ * @return analysis module
+ */
+std::unique_ptr<NTBMAnalysisModule> CreateAnalysisModule(const std::string &name, int datatype);
+
+/**
+ * @param value number of threads given on the command line
+ * @return number of threads
+ * @throw std::invalid_argument if the value is not a positive integer
+ */
+unsigned int ParseNumberOfThreads(const std::string &value);
+
+/**
+ * Run the analysis modules in one pass over NTBM files. Only the members used
+ * by the modules are read. When all the modules need a skim, only the entries
+ * of the skim are read (all the entries for files without skim).
+ * Each module writes its histograms in its own output file.
+ * The entries are processed in chunks by the threads, each filling clones of the modules.
+ * With one thread the entries are filled in order.
+ * @param input_paths input NTBM file paths (TTree or RNTuple), e.g. a run period
+ * @param tasks analysis modules and their output file paths
+ * @param number_of_threads number of threads
+ */
+void RunAnalysis(const std::vector<std::string> &input_paths, std::vector<NTBMAnalysisTask> &tasks,
+		 unsigned int number_of_threads = 1);
+
+#endif
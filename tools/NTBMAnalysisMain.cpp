@@ -0,0 +1,101 @@
+// system includes
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+
+// boost includes
+#include <boost/program_options.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+
+#include "NTBMAnalysis.hpp"
+
+namespace logging = boost::log;
+namespace po = boost::program_options;
+
+/*
+ * Run the studies of the test tools (TestPosition, TestTangent, ...) in one pass over
+ * NTBM files (e.g. a run period). Each selected module writes the same output file as
+ * its standalone tool. The entries are shared by several threads.
+ */
+
+/**
+ * Parse a module argument
+ * @param argument <module name>=<output file path>
+ * @param datatype 0 (MC) or 1 (Physics data)
+ * @return analysis module and its output file
+ */
+NTBMAnalysisTask ParseTask(const std::string &argument, int datatype) {
+  const std::size_t separator = argument.find('=');
+  if ( separator == std::string::npos || separator == 0 || separator == argument.size() - 1 )
+    throw std::invalid_argument("Module should be given as <module>=<output file path> : " + argument);
+  NTBMAnalysisTask task;
+  task.module = CreateAnalysisModule(argument.substr(0, separator), datatype);
+  task.output_path = argument.substr(separator + 1);
+  return task;
+}
+
+int main (int argc, char *argv[]) {
+
+  logging::core::get()->set_filter
+    (
+     logging::trivial::severity >= logging::trivial::info
+     );
+
+  BOOST_LOG_TRIVIAL(info) << "==========NINJA Analysis Start==========";
+
+  po::options_description options("Options");
+  options.add_options()
+    ("datatype", po::value<int>()->required(), "0 (MC) or 1 (Physics data)")
+    ("module", po::value<std::vector<std::string> >()->required(), "<module>=<output file path>")
+    ("input", po::value<std::vector<std::string> >()->multitoken()->required(), "input NTBM file paths")
+    ("threads", po::value<std::string>()->default_value
+     (std::to_string(std::max(1u, std::thread::hardware_concurrency()))), "number of threads");
+  po::positional_options_description positional;
+  positional.add("datatype", 1).add("module", -1);
+
+  po::variables_map vm;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(options).positional(positional)
+	      .style(po::command_line_style::unix_style ^ po::command_line_style::allow_short).run(), vm);
+    po::notify(vm);
+  } catch (const po::error &error) {
+    std::string module_names;
+    for ( const auto &name : GetAnalysisModuleNames() )
+      module_names += " " + name;
+    BOOST_LOG_TRIVIAL(error) << error.what();
+    BOOST_LOG_TRIVIAL(error) << "Usage : " << argv[0]
+			     << " <0 (MC)/1(Physics data)> <module>=<output file path> [<module>=<output file path> ...]"
+			     << " --input <input NTBM file path> [...] [--threads <number of threads>]";
+    BOOST_LOG_TRIVIAL(error) << "Modules :" << module_names;
+    std::exit(1);
+  }
+
+  try {
+
+    const int datatype = vm["datatype"].as<int>();
+    std::vector<NTBMAnalysisTask> tasks;
+    for ( const auto &argument : vm["module"].as<std::vector<std::string> >() )
+      tasks.push_back(ParseTask(argument, datatype));
+    RunAnalysis(vm["input"].as<std::vector<std::string> >(), tasks,
+		ParseNumberOfThreads(vm["threads"].as<std::string>()));
+    for ( const auto &task : tasks )
+      BOOST_LOG_TRIVIAL(info) << "Output : " << task.output_path;
+
+  } catch (const std::runtime_error &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Runtime error : " << error.what();
+    std::exit(1);
+  } catch (const std::invalid_argument &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Invalid argument error : " << error.what();
+    std::exit(1);
+  } catch (const std::out_of_range &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Out of range error : " << error.what();
+    std::exit(1);
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "==========NINJA Analysis Finish==========";
+  std::exit(0);
+
+}
@@ -0,0 +1,148 @@
+// system includes
+#include <string>
+#include <vector>
+#include <chrono>
+
+// boost include
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+
+// root includes
+#include <TFile.h>
+#include <TTree.h>
+
+#include "NTBMSummary.hh"
+#include "NTBMNTuple.hh"
+#include "NTBMReader.hh"
+
+namespace logging = boost::log;
+
+/*
+ * Benchmark of the NTBM output formats. The spills of an NTBM file are written as a TTree
+ * (TrackMatch default) and as an RNTuple (TrackMatch --rntuple), then the file size, the write
+ * time, the read time of all the members and of a few members (TestPosition) are reported.
+ */
+
+///> Members read by TestPosition (partial read)
+const std::vector<std::string> PARTIAL_MEMBERS = {"number_of_ninja_clusters_", "number_of_hits_",
+						  "ninja_position_", "normalization_",
+						  "total_cross_section_"};
+
+/**
+ * @param start start time
+ * @return time since start [s]
+ */
+double GetElapsedTime(const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Read all the entries of an NTBM file
+ * @param path NTBM file path
+ * @param members members to be read (empty : all the members)
+ * @return read time [s]
+ */
+double BenchmarkRead(const std::string &path, const std::vector<std::string> &members) {
+  const auto start = std::chrono::steady_clock::now();
+  NTBMReader reader(path, members);
+  long checksum = 0;
+  for ( Long64_t ientry = 0; ientry < reader.GetEntries(); ientry++ ) {
+    reader.GetEntry(ientry);
+    checksum += reader.GetNTBMSummary()->GetNumberOfNinjaClusters();
+  }
+  const double time = GetElapsedTime(start);
+  BOOST_LOG_TRIVIAL(debug) << path << " checksum : " << checksum;
+  return time;
+}
+
+/**
+ * Get file size
+ * @param path file path
+ * @return file size [MB]
+ */
+double GetFileSize(const std::string &path) {
+  TFile file(path.c_str(), "read");
+  return file.GetSize() / 1024. / 1024.;
+}
+
+int main (int argc, char *argv[]) {
+
+  logging::core::get()->set_filter
+    (
+     logging::trivial::severity >= logging::trivial::info
+     );
+
+  if ( argc != 4 ) {
+    BOOST_LOG_TRIVIAL(error) << "Usage : " << argv[0]
+			     << " <input NTBM file path> <output TTree file path> <output RNTuple file path>";
+    std::exit(1);
+  }
+
+  try {
+
+    if ( !NTBMNTupleWriter::IsAvailable() )
+      throw std::runtime_error("RNTuple is not available (build with NINJA_RECON_WITH_RNTUPLE=ON)");
+
+    // Spills are kept in memory so that only the output is timed
+    std::vector<NTBMSummary> ntbms;
+    {
+      NTBMReader reader(argv[1]);
+      for ( Long64_t ientry = 0; ientry < reader.GetEntries(); ientry++ ) {
+	reader.GetEntry(ientry);
+	ntbms.push_back(*reader.GetNTBMSummary());
+      }
+    }
+    BOOST_LOG_TRIVIAL(info) << "Input : " << argv[1] << " (" << ntbms.size() << " spills)";
+
+    auto start = std::chrono::steady_clock::now();
+    {
+      TFile file(argv[2], "recreate");
+      TTree *tree = new TTree("tree", "NINJA BabyMIND Original Summary");
+      NTBMSummary *ntbm = nullptr;
+      NTBMSummary::CreateBranch(tree, &ntbm);
+      for ( auto &spill : ntbms ) {
+	ntbm = &spill;
+	tree->Fill();
+      }
+      file.cd();
+      tree->Write();
+      file.Close();
+    }
+    const double tree_write_time = GetElapsedTime(start);
+
+    start = std::chrono::steady_clock::now();
+    {
+      TFile file(argv[3], "recreate");
+      NTBMNTupleWriter writer(file, "tree");
+      for ( const auto &spill : ntbms )
+	writer.Fill(spill);
+      writer.Close();
+      file.Close();
+    }
+    const double ntuple_write_time = GetElapsedTime(start);
+
+    const std::string paths[2] = {argv[2], argv[3]};
+    const std::string labels[2] = {"TTree  ", "RNTuple"};
+    const double write_times[2] = {tree_write_time, ntuple_write_time};
+    for ( int iformat = 0; iformat < 2; iformat++ ) {
+      const double full_read_time = BenchmarkRead(paths[iformat], std::vector<std::string>());
+      const double partial_read_time = BenchmarkRead(paths[iformat], PARTIAL_MEMBERS);
+      BOOST_LOG_TRIVIAL(info) << labels[iformat] << " : size " << GetFileSize(paths[iformat]) << " MB, "
+			      << "write " << ntbms.size() / write_times[iformat] << " spills/s, "
+			      << "read all " << ntbms.size() / full_read_time << " spills/s, "
+			      << "read " << PARTIAL_MEMBERS.size() << " members "
+			      << ntbms.size() / partial_read_time << " spills/s";
+    }
+
+  } catch (const std::runtime_error &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Runtime error : " << error.what();
+    std::exit(1);
+  } catch (const std::invalid_argument &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Invalide argument error : " << error.what();
+    std::exit(1);
+  }
+
+  std::exit(0);
+
+}
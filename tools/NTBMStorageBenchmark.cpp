@@ -0,0 +1,179 @@
+// system includes
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+// boost include
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+
+// root includes
+#include <TFile.h>
+#include <TTree.h>
+#include <TBranch.h>
+#include <TBasket.h>
+#include <TLeaf.h>
+
+#include "NTBMSummary.hh"
+
+namespace logging = boost::log;
+
+/*
+ * Benchmark of the NTBMSummary on-disk encoding. An NTBM file written with an older schema
+ * (e.g. version 12) is converted to the current compact schema and the file size and the read
+ * throughput of both files are reported. Drop the page cache between runs for cold numbers.
+ *
+ * Two reads are timed for each file :
+ * - baskets : all the baskets of all the branches are read and decompressed. This does not
+ *   depend on the class in memory, so it compares the two encodings as they are on disk.
+ * - objects : all the entries are read into NTBMSummary. An older file goes through the read
+ *   rules converting it to the current schema, so this is the cost of reading it with the
+ *   current library, not the native read of the older version.
+ */
+
+/**
+ * Read and decompress all the baskets of the tree
+ * @param tree NTBM tree
+ * @param bytes uncompressed bytes read (filled)
+ * @return read time [s]
+ */
+double ReadBaskets(TTree *tree, Long64_t &bytes) {
+  std::vector<TBranch*> branches;
+  TIter next(tree->GetListOfLeaves());
+  while ( TLeaf *leaf = (TLeaf*)next() )
+    if ( std::find(branches.begin(), branches.end(), leaf->GetBranch()) == branches.end() )
+      branches.push_back(leaf->GetBranch());
+
+  bytes = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for ( TBranch *branch : branches ) {
+    for ( Int_t ibasket = 0; ibasket < branch->GetWriteBasket(); ibasket++ ) {
+      TBasket *basket = branch->GetBasket(ibasket);
+      if ( basket == nullptr )
+	throw std::runtime_error(std::string("Cannot read basket of branch ") + branch->GetName());
+      bytes += basket->GetObjlen();
+    }
+    // the baskets are not kept in memory
+    branch->DropBaskets("all");
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Read all the entries of the NTBM tree and report the size and the throughput
+ * @param path NTBM file path
+ * @param label label in the log
+ * @param basket_time basket read time [s] (filled)
+ * @return object read time [s]
+ */
+double BenchmarkRead(const std::string &path, const std::string &label, double &basket_time) {
+  TFile *file = new TFile(path.c_str(), "read");
+  if ( file->IsZombie() )
+    throw std::runtime_error("Cannot open NTBM file : " + path);
+  TTree *tree = (TTree*)file->Get("tree");
+  if ( tree == nullptr )
+    throw std::runtime_error("NTBM tree not found in " + path);
+
+  Long64_t basket_bytes = 0;
+  basket_time = ReadBaskets(tree, basket_bytes);
+
+  NTBMSummary *ntbm = nullptr;
+  tree->SetBranchAddress("NTBMSummary", &ntbm);
+
+  const Long64_t number_of_entries = tree->GetEntries();
+  long checksum = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for ( Long64_t ientry = 0; ientry < number_of_entries; ientry++ ) {
+    tree->GetEntry(ientry);
+    checksum += ntbm->GetNumberOfNinjaClusters();
+  }
+  const double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  BOOST_LOG_TRIVIAL(info) << label << " : " << path;
+  BOOST_LOG_TRIVIAL(info) << "  File size : " << file->GetSize() / 1024. / 1024. << " MB, "
+			  << "tree zip bytes : " << tree->GetZipBytes() / 1024. / 1024. << " MB, "
+			  << "tree total bytes : " << tree->GetTotBytes() / 1024. / 1024. << " MB";
+  BOOST_LOG_TRIVIAL(info) << "  Baskets : " << basket_bytes / 1024. / 1024. << " MB (uncompressed) in "
+			  << basket_time << " s, " << tree->GetZipBytes() / 1024. / 1024. / basket_time
+			  << " MB/s (compressed)";
+  BOOST_LOG_TRIVIAL(info) << "  Objects : " << number_of_entries << " entries in " << time << " s, "
+			  << number_of_entries / time << " entries/s, "
+			  << tree->GetZipBytes() / 1024. / 1024. / time << " MB/s (compressed), "
+			  << tree->GetTotBytes() / 1024. / 1024. / time << " MB/s (uncompressed) "
+			  << "(checksum " << checksum << ")";
+
+  tree->ResetBranchAddresses();
+  delete ntbm;
+  file->Close();
+  delete file;
+  return time;
+}
+
+int main (int argc, char *argv[]) {
+
+  logging::core::get()->set_filter
+    (
+     logging::trivial::severity >= logging::trivial::info
+     );
+
+  if ( argc != 3 ) {
+    BOOST_LOG_TRIVIAL(error) << "Usage : " << argv[0]
+			     << " <input NTBM file path (old schema)> <output NTBM file path (current schema)>";
+    std::exit(1);
+  }
+
+  try {
+
+    // Convert the input file to the current schema with the same tree layout as TrackMatch
+    {
+      TFile *input_file = new TFile(argv[1], "read");
+      if ( input_file->IsZombie() )
+	throw std::runtime_error(std::string("Cannot open NTBM file : ") + argv[1]);
+      TTree *input_tree = (TTree*)input_file->Get("tree");
+      if ( input_tree == nullptr )
+	throw std::runtime_error(std::string("NTBM tree not found in ") + argv[1]);
+      NTBMSummary *ntbm = nullptr;
+      input_tree->SetBranchAddress("NTBMSummary", &ntbm);
+
+      TFile *output_file = new TFile(argv[2], "recreate");
+      TTree *output_tree = new TTree("tree", "NINJA BabyMIND Original Summary");
+      NTBMSummary::CreateBranch(output_tree, &ntbm);
+      for ( Long64_t ientry = 0; ientry < input_tree->GetEntries(); ientry++ ) {
+	input_tree->GetEntry(ientry);
+	output_tree->Fill();
+      }
+      output_file->cd();
+      output_tree->Write();
+      output_file->Close();
+      input_file->Close();
+      delete ntbm;
+    }
+
+    double input_basket_time = 0.;
+    double output_basket_time = 0.;
+    const double input_time = BenchmarkRead(argv[1], "Input (old schema, objects through the read rules)",
+					    input_basket_time);
+    const double output_time = BenchmarkRead(argv[2], "Output (schema version "
+					     + std::to_string(NTBMSummary::Class_Version()) + ")",
+					     output_basket_time);
+
+    TFile input_file(argv[1], "read");
+    TFile output_file(argv[2], "read");
+    BOOST_LOG_TRIVIAL(info) << "File size ratio (output/input) : "
+			    << (double)output_file.GetSize() / input_file.GetSize()
+			    << ", basket read speed up : x" << input_basket_time / output_basket_time
+			    << ", object read speed up (old schema converted) : x" << input_time / output_time;
+
+  } catch (const std::runtime_error &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Runtime error : " << error.what();
+    std::exit(1);
+  } catch (const std::invalid_argument &error) {
+    BOOST_LOG_TRIVIAL(fatal) << "Invalide argument error : " << error.what();
+    std::exit(1);
+  }
+
+  std::exit(0);
+
+}
@@ -12,6 +12,8 @@
 #include <TTree.h>
 
 #include "NTBMSummary.hh"
+#include "NTBMReader.hh"
+#include "NTBMStartupMarker.hh"
 
 namespace logging = boost::log;
 
@@ -46,22 +48,21 @@ int main (int argc, char *argv[]) {
 
   try {
 
-    TFile *file = new TFile(argv[1], "read");
-    TTree *tree = (TTree*)file->Get("tree");
+    // TTree or RNTuple NTBM file
+    NTBMReader reader(argv[1]);
+    NTBMSummary *ntbm = reader.GetNTBMSummary();
 
-    NTBMSummary *ntbm = new NTBMSummary();
-    tree->SetBranchAddress("NTBMSummary", &ntbm);
-
-    if (end >= tree->GetEntries()) {
+    if (end >= reader.GetEntries()) {
       BOOST_LOG_TRIVIAL(error) << "End entry shold be less than # of entries in the file " << argv[1] << " : "
-			       << tree->GetEntries() << " : " <<argv[3];
+			       << reader.GetEntries() << " : " <<argv[3];
       std::exit(1);
     }
 
     for (int ientry = start; ientry < end; ientry++) {
-      tree->GetEntry(ientry);
+      reader.GetEntry(ientry);
       BOOST_LOG_TRIVIAL(info) << "Timestamp : " << (int)ntbm->GetTimestamp();
       BOOST_LOG_TRIVIAL(info) << *ntbm;
+      MarkFirstSpill();
     }
 
   } catch (const std::runtime_error &error) {